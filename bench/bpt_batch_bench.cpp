@@ -0,0 +1,44 @@
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <fmt/format.h>
+#include "store/bptree.h"
+
+namespace
+{
+constexpr int kKeyCount = 20000;
+constexpr size_t kNodeSize = 64;
+
+double InsertPerSecond(const char* file, bool batched)
+{
+    std::filesystem::remove(file);
+    BPTree tree(file, kNodeSize);
+    const auto start = std::chrono::steady_clock::now();
+    if (batched)
+    {
+        tree.BeginBatch();
+    }
+    for (int i = 0; i < kKeyCount; ++i)
+    {
+        const std::string key = fmt::format("key{:08}", (i * 7919) % kKeyCount);
+        tree.Insert(key, key.data(), key.size());
+    }
+    if (batched)
+    {
+        tree.Commit();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return kKeyCount / elapsed.count();
+}
+}  // namespace
+
+int main()
+{
+    const double unbatched = InsertPerSecond("bench-batch.db", false);
+    const double batched = InsertPerSecond("bench-batch.db", true);
+    fmt::println("inserts: {}", kKeyCount);
+    fmt::println("flush per insert: {:.0f} inserts/sec", unbatched);
+    fmt::println("single batch:     {:.0f} inserts/sec ({:.1f}x)", batched, batched / unbatched);
+    std::filesystem::remove("bench-batch.db");
+    return 0;
+}
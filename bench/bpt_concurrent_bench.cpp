@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+#include "store/bptree.h"
+
+namespace
+{
+constexpr size_t kKeyCount = 200000;
+constexpr int kOpsPerThread = 50000;
+//! one operation in this many is an overwrite in the mixed workload
+constexpr int kWriteEvery = 20;
+
+std::string MakeKey(size_t i)
+{
+    return fmt::format("key-{:08}", i);
+}
+
+//! @brief operations per second of threads running op(thread, i) kOpsPerThread times each
+template <typename Fn>
+double OpsPerSecond(int threads, Fn&& op)
+{
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&op, t] {
+            for (int i = 0; i < kOpsPerThread; ++i)
+            {
+                op(t, i);
+            }
+        });
+    }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(threads) * kOpsPerThread / elapsed.count();
+}
+}  // namespace
+
+int main()
+{
+    // every page stays cached, so this measures latching and not the disk
+    std::filesystem::remove("bench-concurrent.db");
+    BPTreeOptions options;
+    options.m_frame_budget = 1 << 16;
+    BPTree tree("bench-concurrent.db", 64, options);
+    std::vector<BPTree::Record> records;
+    for (size_t i = 0; i < kKeyCount; ++i)
+    {
+        records.emplace_back(MakeKey(i), "value");
+    }
+    tree.BulkLoad(std::move(records));
+    std::vector<std::string> probes;
+    std::mt19937 rng(7);
+    for (int i = 0; i < 4096; ++i)
+    {
+        probes.push_back(MakeKey(rng() % kKeyCount));
+    }
+    tree.BeginBatch();
+
+    // the global mutex column is how callers serialized the tree before it latched itself
+    std::mutex global;
+    fmt::println("{:>8} {:>16} {:>16} {:>16}", "threads", "mutex reads/s", "reads/s", "95% reads/s");
+    const unsigned hardware = std::max(1U, std::thread::hardware_concurrency());
+    for (int threads : { 1, 2, 4, 8, 16 })
+    {
+        const double serialized = OpsPerSecond(threads, [&](int t, int i) {
+            std::lock_guard<std::mutex> lock(global);
+            tree.Search(probes[static_cast<size_t>(t * 131 + i) & 4095]);
+        });
+        const double reads = OpsPerSecond(threads, [&](int t, int i) { tree.Search(probes[static_cast<size_t>(t * 131 + i) & 4095]); });
+        const double mixed = OpsPerSecond(threads, [&](int t, int i) {
+            const std::string& key = probes[static_cast<size_t>(t * 131 + i) & 4095];
+            if (i % kWriteEvery == 0)
+            {
+                tree.Insert(key, "fresh", 5);
+            }
+            else
+            {
+                tree.Search(key);
+            }
+        });
+        fmt::println("{:>8} {:>16.0f} {:>16.0f} {:>16.0f}{}", threads, serialized, reads, mixed, static_cast<unsigned>(threads) > hardware ? "  (oversubscribed)" : "");
+    }
+    tree.Commit();
+
+    std::filesystem::remove("bench-concurrent.db");
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include <chrono>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+#include <fmt/format.h>
+#include "store/bptree.h"
+
+namespace
+{
+constexpr size_t kKeyCount = 300000;
+constexpr int kLookups = 200000;
+constexpr int kInserts = 5000;
+//! every page size gets the same cache, so larger pages mean fewer frames
+constexpr size_t kCacheBytes = 8 << 20;
+
+std::string MakeKey(size_t i)
+{
+    return fmt::format("tenant-0042/item-{:07}", i * 2);
+}
+
+template <typename Fn>
+double OpsPerSecond(size_t ops, Fn&& fn)
+{
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(ops) / elapsed.count();
+}
+}  // namespace
+
+int main()
+{
+    // 24-byte keys with 8-byte values, with fan-out derived from each page size; the index is
+    // larger than the cache, so lookups fault pages in from the file
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < kKeyCount; ++i)
+    {
+        keys.push_back(MakeKey(i));
+    }
+    std::mt19937 rng(7);
+    std::vector<size_t> probes;
+    for (int i = 0; i < kLookups; ++i)
+    {
+        probes.push_back(rng() % kKeyCount);
+    }
+
+    fmt::println("{:>8} {:>8} {:>10} {:>14} {:>14} {:>14}", "page", "fan-out", "file MB", "lookups/s", "scan rows/s", "inserts/s");
+    for (const uint32_t page_size : { 4096U, 8192U, 16384U, 32768U, 65536U })
+    {
+        std::filesystem::remove("bench-pages.db");
+        BPTreeOptions options;
+        options.m_page_size = page_size;
+        options.m_frame_budget = kCacheBytes / page_size;
+        options.m_key_width = keys.front().size();
+        options.m_value_width = sizeof(uint64_t);
+        BPTree tree("bench-pages.db", 0, options);
+
+        std::vector<BPTree::Record> records;
+        for (size_t i = 0; i < kKeyCount; ++i)
+        {
+            records.emplace_back(keys[i], std::string(reinterpret_cast<const char*>(&i), sizeof(i)));
+        }
+        tree.BulkLoad(std::move(records));
+        const double file_mb = static_cast<double>(std::filesystem::file_size("bench-pages.db")) / (1 << 20);
+
+        const double lookups = OpsPerSecond(kLookups, [&] {
+            for (size_t probe : probes)
+            {
+                tree.Search(keys[probe]);
+            }
+        });
+        size_t scanned = 0;
+        const double scan = OpsPerSecond(kKeyCount, [&] {
+            for (auto cursor = tree.Begin(); cursor.Valid(); cursor.Next())
+            {
+                ++scanned;
+            }
+        });
+        // every insert writes its leaf back in place, so larger pages write more bytes per insert
+        const double inserts = OpsPerSecond(kInserts, [&] {
+            for (int i = 0; i < kInserts; ++i)
+            {
+                const std::string key = fmt::format("tenant-0042/item-{:07}", probes[static_cast<size_t>(i)] * 2 + 1);
+                tree.Insert(key, "12345678", 8);
+            }
+        });
+        fmt::println("{:>8} {:>8} {:>10.1f} {:>14.0f} {:>14.0f} {:>14.0f}", page_size, tree.NodeSize(), file_mb, lookups, scan, inserts);
+    }
+
+    std::filesystem::remove("bench-pages.db");
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fmt/format.h>
+#include "store/bptree.h"
+
+namespace
+{
+constexpr size_t kTenants = 64;
+constexpr size_t kKeysPerTenant = 3000;
+constexpr int kLookups = 200000;
+constexpr size_t kColdLookups = 20000;
+constexpr size_t kBatchSize = 1000;
+//! a 1 MB cache holds a small part of the index, so lookups pay for every page they miss
+constexpr size_t kLookupFrames = 256;
+
+//! tenant id followed by a random version 4 uuid, 50 bytes
+std::string MakeKey(size_t tenant, std::mt19937_64& rng)
+{
+    const uint64_t high = rng();
+    const uint64_t low = rng();
+    return fmt::format("tenant-{:06}/{:08x}-{:04x}-4{:03x}-{:04x}-{:012x}", tenant, high >> 32, (high >> 16) & 0xffff, high & 0xfff,
+                       ((low >> 48) & 0x3fff) | 0x8000, low & 0xffffffffffff);
+}
+
+//! @brief drop the file from the OS page cache, so the next reads go to the disk
+void DropFromPageCache(const char* file)
+{
+    const int fd = open(file, O_RDONLY);
+    if (fd >= 0)
+    {
+        fsync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+double NanosPerLookup(const char* file, const std::vector<std::string>& probes, size_t count)
+{
+    BPTreeOptions options;
+    options.m_frame_budget = kLookupFrames;
+    BPTree tree(file, 0, options);
+    size_t found = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i)
+    {
+        found += tree.Search(probes[i]).has_value();
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return found == count ? elapsed.count() / static_cast<double>(count) : -1.0;
+}
+
+void Report(const char* build, const char* file, const std::vector<std::string>& probes)
+{
+    const uintmax_t pages = std::filesystem::file_size(file) / 4096;
+    // the first lookups after a cold start read most pages from the disk, later ones from the OS page cache
+    DropFromPageCache(file);
+    const double cold = NanosPerLookup(file, probes, kColdLookups);
+    const double warm = NanosPerLookup(file, probes, probes.size());
+    fmt::println("{:>12} {:>10} {:>10.1f} {:>14.0f} {:>14.0f}", build, pages, static_cast<double>(pages) / 256, cold, warm);
+}
+}  // namespace
+
+int main()
+{
+    std::mt19937_64 rng(7);
+    std::vector<std::string> keys;
+    for (size_t tenant = 0; tenant < kTenants; ++tenant)
+    {
+        for (size_t i = 0; i < kKeysPerTenant; ++i)
+        {
+            keys.push_back(MakeKey(tenant, rng));
+        }
+    }
+    std::vector<std::string> probes;
+    for (int i = 0; i < kLookups; ++i)
+    {
+        probes.push_back(keys[rng() % keys.size()]);
+    }
+
+    // the default 4 KB page with a node size derived from the default 16-byte key width,
+    // as a table index would get it; the real keys are longer, so pages fill by bytes
+    fmt::println("{} keys like {}", keys.size(), keys.front());
+    fmt::println("{:>12} {:>10} {:>10} {:>14} {:>14}", "build", "pages", "MB", "cold ns/get", "ns/get");
+
+    std::filesystem::remove("bench-prefix.db");
+    {
+        // inserted in random order, so every leaf and internal node is shaped by splits
+        std::vector<std::string> shuffled = keys;
+        std::shuffle(shuffled.begin(), shuffled.end(), rng);
+        BPTree tree("bench-prefix.db", 0);
+        for (size_t i = 0; i < shuffled.size(); ++i)
+        {
+            if (i % kBatchSize == 0)
+            {
+                tree.BeginBatch();
+            }
+            tree.Insert(shuffled[i], &i, sizeof(i));
+            if (i % kBatchSize == kBatchSize - 1 || i + 1 == shuffled.size())
+            {
+                tree.Commit();
+            }
+        }
+    }
+    Report("inserts", "bench-prefix.db", probes);
+
+    std::filesystem::remove("bench-prefix.db");
+    {
+        std::vector<std::string> sorted = keys;
+        std::sort(sorted.begin(), sorted.end());
+        std::vector<BPTree::Record> records;
+        for (size_t i = 0; i < sorted.size(); ++i)
+        {
+            records.emplace_back(sorted[i], std::string(reinterpret_cast<const char*>(&i), sizeof(i)));
+        }
+        BPTree tree("bench-prefix.db", 0);
+        tree.BulkLoad(std::move(records));
+    }
+    Report("bulk load", "bench-prefix.db", probes);
+
+    std::filesystem::remove("bench-prefix.db");
+    return 0;
+}
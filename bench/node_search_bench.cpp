@@ -0,0 +1,131 @@
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+#include <fmt/format.h>
+#include "store/bptree.h"
+#include "store/key_array.h"
+
+namespace
+{
+// 24-byte keys with 1-byte values: 112 entries still fit a 4 KB leaf or internal page
+constexpr size_t kKeysPerNode = 112;
+constexpr int kLookups = 2000000;
+
+std::string MakeKey(size_t i)
+{
+    return fmt::format("tenant-0042/item-{:07}", i * 2);
+}
+
+//! @brief the node layout before KeyArray: one heap string per key and a linear strcmp scan
+size_t LinearFindPos(const std::vector<std::string>& keys, const char* key)
+{
+    size_t pos = 0;
+    for (; pos < keys.size() && std::strcmp(keys[pos].c_str(), key) < 0; ++pos)
+        ;
+    return pos;
+}
+
+template <typename Fn>
+double NanosPerOp(int ops, Fn&& fn)
+{
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / ops;
+}
+
+void BenchNode()
+{
+    std::vector<std::string> strings;
+    KeyArray packed;
+    for (size_t i = 0; i < kKeysPerNode; ++i)
+    {
+        strings.push_back(MakeKey(i));
+        packed.PushBack(strings.back());
+    }
+
+    std::mt19937 rng(7);
+    std::vector<std::string> probes;
+    for (int i = 0; i < 1024; ++i)
+    {
+        probes.push_back(MakeKey(rng() % (kKeysPerNode * 2)));
+    }
+
+    size_t sink = 0;
+    const double linear = NanosPerOp(kLookups, [&] {
+        for (int i = 0; i < kLookups; ++i)
+        {
+            sink += LinearFindPos(strings, probes[i & 1023].c_str());
+        }
+    });
+    const double binary = NanosPerOp(kLookups, [&] {
+        for (int i = 0; i < kLookups; ++i)
+        {
+            sink += packed.LowerBound(probes[i & 1023]);
+        }
+    });
+    fmt::println("node of {} keys: linear strcmp {:.1f} ns, packed binary search {:.1f} ns ({:.1f}x) [{}]", kKeysPerNode, linear, binary, linear / binary, sink % 10);
+}
+
+void BenchTree(size_t node_size)
+{
+    constexpr int kKeyCount = 100000;
+    constexpr int kTreeLookups = 200000;
+    std::filesystem::remove("bench-search.db");
+    BPTree tree("bench-search.db", node_size);
+    std::vector<BPTree::Record> records;
+    for (int i = 0; i < kKeyCount; ++i)
+    {
+        records.emplace_back(MakeKey(static_cast<size_t>(i)), "v");
+    }
+    tree.BulkLoad(std::move(records), 1.0);
+
+    std::mt19937 rng(11);
+    std::vector<std::string> probes;
+    for (int i = 0; i < 1024; ++i)
+    {
+        probes.push_back(MakeKey(rng() % kKeyCount));
+    }
+
+    size_t found = 0;
+    const double latency = NanosPerOp(kTreeLookups, [&] {
+        for (int i = 0; i < kTreeLookups; ++i)
+        {
+            found += tree.Search(probes[i & 1023]).has_value() ? 1 : 0;
+        }
+    });
+    fmt::println("tree of {} keys, node_size {}: {:.0f} ns per Search ({} hits)", kKeyCount, node_size, latency, found);
+
+    // one MultiGet of 1024 keys, scattered or consecutive; consecutive keys share leaves and descents
+    std::vector<std::string> dense;
+    for (size_t i = 0; i < probes.size(); ++i)
+    {
+        dense.push_back(MakeKey(kKeyCount / 2 + i));
+    }
+    for (const auto& [name, keys] : { std::make_pair("scattered", &probes), std::make_pair("consecutive", &dense) })
+    {
+        size_t hits = 0;
+        const double per_key = NanosPerOp(kTreeLookups, [&, keys = keys] {
+            for (int i = 0; i < kTreeLookups; i += static_cast<int>(keys->size()))
+            {
+                const BPTree::Handle values = tree.MultiGet(*keys);
+                hits += values.Has(0) ? 1 : 0;
+            }
+        });
+        fmt::println("  MultiGet of {} {} keys: {:.0f} ns per key", keys->size(), name, per_key);
+        found += hits;
+    }
+    std::filesystem::remove("bench-search.db");
+}
+}  // namespace
+
+int main()
+{
+    BenchNode();
+    BenchTree(8);
+    BenchTree(kKeysPerNode);
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fmt/format.h>
+#include "catalog/row.h"
+
+namespace
+{
+constexpr int kRows = 200000;
+
+Schema MakeSchema(int extra_columns)
+{
+    std::vector<Column> columns = { { "id", ColumnType::kString, 0, false, true }, { "age", ColumnType::kInt64, 0, true, false }, { "name", ColumnType::kString, 0, true, false } };
+    for (int i = 0; i < extra_columns; ++i)
+    {
+        columns.push_back({ fmt::format("attribute_{}", i), i % 2 == 0 ? ColumnType::kInt64 : ColumnType::kString, 0, true, false });
+    }
+    return Schema(std::move(columns));
+}
+
+double DecodeNanos(const std::vector<uint8_t>& payload, const std::shared_ptr<const Schema>& schema)
+{
+    size_t checksum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRows; ++i)
+    {
+        checksum += Row::Deserialize(payload, schema)->Has(0);
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return checksum == 0 ? 0.0 : elapsed.count() / kRows;
+}
+//! @brief validate the payload in place and read one string column through a view
+double ViewNanos(const std::vector<uint8_t>& payload, const Schema& schema)
+{
+    size_t checksum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRows; ++i)
+    {
+        if (RowView::Validate(schema, payload.data(), payload.size()))
+        {
+            checksum += RowView(&schema, payload.data(), payload.size()).GetString(2)->size();
+        }
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return checksum == 0 ? 0.0 : elapsed.count() / kRows;
+}
+}  // namespace
+
+int main()
+{
+    fmt::println("{:>8} {:>10} {:>10} {:>12} {:>12} {:>12}", "columns", "v1 bytes", "v2 bytes", "v1 ns/row", "v2 ns/row", "view ns/row");
+    for (int extra_columns : { 0, 9, 29 })
+    {
+        const auto schema = std::make_shared<const Schema>(MakeSchema(extra_columns));
+        Row row(schema);
+        row.SetString("id", "user-00001234");
+        row.SetInt64("age", 31);
+        row.SetString("name", "a reasonably sized display name");
+        for (int i = 0; i < extra_columns; ++i)
+        {
+            const std::string column = fmt::format("attribute_{}", i);
+            if (i % 2 == 0)
+            {
+                row.SetInt64(column, i);
+            }
+            else
+            {
+                row.SetString(column, "value");
+            }
+        }
+
+        const std::vector<uint8_t> legacy = row.SerializeLegacy();
+        const std::vector<uint8_t> compact = row.Serialize();
+        fmt::println("{:>8} {:>10} {:>10} {:>12.0f} {:>12.0f} {:>12.0f}", schema->Size(), legacy.size(), compact.size(), DecodeNanos(legacy, schema),
+                     DecodeNanos(compact, schema), ViewNanos(compact, *schema));
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <fmt/format.h>
+#include "catalog/table.h"
+#include "sql/executor.h"
+
+namespace
+{
+constexpr int kRows = 100000;
+constexpr int kRounds = 3;
+
+void RemoveFiles()
+{
+    std::filesystem::remove("bench-aggregate.tbl");
+    std::filesystem::remove("bench-aggregate.idx");
+    std::filesystem::remove("bench-aggregate.wal");
+}
+
+//! @brief rows/sec of the fastest of kRounds runs of aggregate, which returns the groups it found
+template <typename Aggregate>
+double BestRate(Aggregate aggregate, size_t expected_groups)
+{
+    double best = 0;
+    for (int round = 0; round < kRounds; ++round)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const size_t groups = aggregate();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (groups != expected_groups)
+        {
+            fmt::println("found {} groups instead of {}", groups, expected_groups);
+            return 0;
+        }
+        best = std::max(best, kRows / elapsed.count());
+    }
+    return best;
+}
+
+//! @brief what a caller without GROUP BY keeps per group
+struct Totals
+{
+    int64_t m_count { 0 };
+    int64_t m_sum { 0 };
+    int64_t m_min { 0 };
+    std::string m_max;
+};
+}  // namespace
+
+int main()
+{
+    RemoveFiles();
+    const Schema schema({ { "id", ColumnType::kInt64, 0, false, true },
+                          { "small", ColumnType::kInt64, 0, false, false },
+                          { "medium", ColumnType::kInt64, 0, false, false },
+                          { "large", ColumnType::kInt64, 0, false, false },
+                          { "amount", ColumnType::kInt64, 0, false, false },
+                          { "note", ColumnType::kString, 0, true, false } });
+    Table table("bench-aggregate", schema);
+    for (int64_t i = 0; i < kRows; ++i)
+    {
+        Row row(schema);
+        row.SetInt64("id", i);
+        row.SetInt64("small", i % 10);
+        row.SetInt64("medium", (i * 7919) % 1000);
+        row.SetInt64("large", (i * 104729) % kRows);
+        row.SetInt64("amount", (i * 31) % 1000);
+        row.SetString("note", fmt::format("note {:05}", i % 4096));
+        table.Insert(std::move(row));
+    }
+
+    fmt::println("{} rows, {} hardware threads; Mrows/s", kRows, std::thread::hardware_concurrency());
+    fmt::println("{:>8} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10}", "groups", "app code", "1 thread", "2 threads", "4 threads", "8 threads", "spilling");
+    // 1 to 8 threads, then 4 threads sharing a 1 MB budget
+    std::vector<AggregateOptions> runs;
+    for (size_t threads : { 1, 2, 4, 8 })
+    {
+        AggregateOptions options;
+        options.m_threads = threads;
+        runs.push_back(options);
+    }
+    AggregateOptions spilling;
+    spilling.m_threads = 4;
+    spilling.m_memory_budget = 1 << 20;
+    runs.push_back(spilling);
+
+    const std::vector<std::pair<const char*, size_t>> columns = { { "small", 10 }, { "medium", 1000 }, { "large", kRows } };
+    for (const auto& [column, groups] : columns)
+    {
+        // the rows pulled out of the table and aggregated by the caller, as before GROUP BY
+        const size_t ordinal = *schema.Ordinal(column);
+        const double app = BestRate(
+            [&, ordinal = ordinal] {
+                std::unordered_map<int64_t, Totals> totals;
+                table.ScanRange("", "", [&](const Row& row) {
+                    const int64_t amount = row.GetInt64(size_t { 4 }).value_or(0);
+                    const std::string note = row.GetString(size_t { 5 }).value_or("");
+                    Totals& group = totals[row.GetInt64(ordinal).value_or(0)];
+                    group.m_min = group.m_count == 0 ? amount : std::min(group.m_min, amount);
+                    group.m_max = std::max(group.m_max, note);
+                    group.m_sum += amount;
+                    ++group.m_count;
+                    return true;
+                });
+                return totals.size();
+            },
+            groups);
+
+        const std::string sql = fmt::format("SELECT {0}, COUNT(*), SUM(amount), MIN(amount), MAX(note) FROM bench GROUP BY {0}", column);
+        std::vector<double> rates;
+        for (const AggregateOptions& options : runs)
+        {
+            Executor executor(options);
+            executor.AddTable("bench", table);
+            rates.push_back(BestRate(
+                [&] {
+                    std::string error;
+                    const std::optional<ResultSet> result = executor.Execute(sql, error);
+                    return result ? result->m_rows.size() : 0;
+                },
+                groups));
+        }
+        fmt::println("{:>8} {:>10.2f} {:>10.2f} {:>10.2f} {:>10.2f} {:>10.2f} {:>10.2f}", groups, app / 1e6, rates[0] / 1e6, rates[1] / 1e6, rates[2] / 1e6, rates[3] / 1e6,
+                     rates[4] / 1e6);
+    }
+
+    RemoveFiles();
+    return 0;
+}
@@ -0,0 +1,216 @@
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fmt/format.h>
+#include "catalog/table.h"
+#include "sql/batch.h"
+#include "sql/operators.h"
+
+namespace
+{
+constexpr int64_t kRows = 50000;
+constexpr int kRounds = 20;
+
+enum Ordinal : size_t
+{
+    kId,
+    kPrice,
+    kQuantity,
+    kRegion,
+};
+
+std::unique_ptr<BoundCondition> Compare(size_t ordinal, CompareOp op, Value value)
+{
+    auto condition = std::make_unique<BoundCondition>();
+    condition->m_column = ColumnRef { 0, ordinal, ordinal == kRegion ? ColumnType::kString : ColumnType::kInt64 };
+    condition->m_op = op;
+    condition->m_value = std::move(value);
+    return condition;
+}
+
+std::unique_ptr<BoundCondition> Combine(Condition::Kind kind, std::unique_ptr<BoundCondition> left, std::unique_ptr<BoundCondition> right = nullptr)
+{
+    auto condition = std::make_unique<BoundCondition>();
+    condition->m_kind = kind;
+    condition->m_left = std::move(left);
+    condition->m_right = std::move(right);
+    return condition;
+}
+
+double MillionRowsPerSecond(size_t rows, std::chrono::steady_clock::time_point start)
+{
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(rows) / elapsed.count() / 1e6;
+}
+
+//! @brief one call of Evaluate per row, the way a filter without batches reads its input
+size_t RowAtATime(const std::vector<Row>& rows, const BoundCondition& condition)
+{
+    size_t selected = 0;
+    Tuple tuple(1);
+    for (const Row& row : rows)
+    {
+        tuple[0] = row.View();
+        selected += Evaluate(condition, tuple) == true;
+    }
+    return selected;
+}
+
+//! @brief the kernels over batches that already hold the rows and their decoded columns
+size_t Resident(std::vector<ColumnBatch>& batches, const BoundCondition& condition)
+{
+    TruthMask mask;
+    std::vector<uint16_t> selection;
+    size_t selected = 0;
+    for (ColumnBatch& batch : batches)
+    {
+        EvaluateBatch(condition, batch, mask);
+        Select(mask, selection);
+        selected += selection.size();
+    }
+    return selected;
+}
+
+//! @brief rows copied into batches, decoded per column and filtered by the kernels, as Filter does
+size_t Batched(const std::vector<Row>& rows, const BoundCondition& condition)
+{
+    ColumnBatch batch;
+    TruthMask mask;
+    std::vector<uint16_t> selection;
+    size_t selected = 0;
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        batch.Append(rows[i].View());
+        if (batch.Full() || i + 1 == rows.size())
+        {
+            EvaluateBatch(condition, batch, mask);
+            Select(mask, selection);
+            selected += selection.size();
+            batch.Clear();
+        }
+    }
+    return selected;
+}
+}  // namespace
+
+int main()
+{
+    std::filesystem::remove("bench-filter.tbl");
+    std::filesystem::remove("bench-filter.idx");
+    std::filesystem::remove("bench-filter.wal");
+
+    const Schema schema({ { "id", ColumnType::kInt64, 0, false, true },
+                          { "price", ColumnType::kInt64, 0, true, false },
+                          { "quantity", ColumnType::kInt64, 0, true, false },
+                          { "region", ColumnType::kString, 0, true, false } });
+    Table table("bench-filter", schema);
+    const char* regions[] = { "eu", "us", "apac", "latam" };
+    for (int64_t id = 0; id < kRows; ++id)
+    {
+        Row row(schema);
+        row.SetInt64(kId, id);
+        row.SetInt64(kPrice, (id * 7919) % 1000);
+        // one row in sixteen has no quantity
+        if (id % 16 != 0)
+        {
+            row.SetInt64(kQuantity, id % 5);
+        }
+        row.SetString(kRegion, regions[id % 4]);
+        table.Insert(std::move(row));
+    }
+    std::vector<Row> rows;
+    std::vector<ColumnBatch> batches;
+    table.ScanRange("", "", [&](const Row& row) {
+        rows.push_back(row);
+        if (batches.empty() || batches.back().Full())
+        {
+            batches.emplace_back();
+        }
+        batches.back().Append(row.View());
+        return true;
+    });
+
+    struct Case
+    {
+        std::string m_text;
+        std::function<std::unique_ptr<BoundCondition>()> m_make;
+    };
+    const std::vector<Case> cases = {
+        { "price < 500", [] { return Compare(kPrice, CompareOp::kLess, int64_t { 500 }); } },
+        { "price >= 100 AND quantity != 3",
+          [] {
+              return Combine(Condition::Kind::kAnd, Compare(kPrice, CompareOp::kGreaterEqual, int64_t { 100 }), Compare(kQuantity, CompareOp::kNotEqual, int64_t { 3 }));
+          } },
+        { "NOT region = 'eu' OR price < 50",
+          [] {
+              return Combine(Condition::Kind::kOr, Combine(Condition::Kind::kNot, Compare(kRegion, CompareOp::kEqual, std::string("eu"))),
+                             Compare(kPrice, CompareOp::kLess, int64_t { 50 }));
+          } },
+    };
+
+    // the filter alone over rows in memory: per row, over resident column batches, and batching
+    // the rows first; then a full table scan with the filter on top, per row and batched
+    fmt::println("{} rows, Mrows/s", rows.size());
+    fmt::println("{:<34} {:>8} {:>10} {:>12} {:>10} {:>12}", "condition", "row", "columns", "copy+batch", "scan+row", "scan+batch");
+    for (const Case& test : cases)
+    {
+        const std::unique_ptr<BoundCondition> condition = test.m_make();
+        size_t row_selected = 0;
+        size_t resident_selected = Resident(batches, *condition);
+        size_t batch_selected = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < kRounds; ++round)
+        {
+            row_selected = RowAtATime(rows, *condition);
+        }
+        const double row_rate = MillionRowsPerSecond(rows.size() * kRounds, start);
+
+        start = std::chrono::steady_clock::now();
+        for (int round = 0; round < kRounds; ++round)
+        {
+            resident_selected = Resident(batches, *condition);
+        }
+        const double resident_rate = MillionRowsPerSecond(rows.size() * kRounds, start);
+
+        start = std::chrono::steady_clock::now();
+        for (int round = 0; round < kRounds; ++round)
+        {
+            batch_selected = Batched(rows, *condition);
+        }
+        const double batch_rate = MillionRowsPerSecond(rows.size() * kRounds, start);
+
+        size_t scan_row_selected = 0;
+        const KeyRangeScan scan(table, 0, 1, "", "", "full scan items");
+        start = std::chrono::steady_clock::now();
+        scan.Run([&](const Tuple& tuple) {
+            scan_row_selected += Evaluate(*condition, tuple) == true;
+            return true;
+        });
+        const double scan_row_rate = MillionRowsPerSecond(rows.size(), start);
+
+        // the plan the executor runs for SELECT ... FROM items WHERE <condition>
+        size_t scan_batch_selected = 0;
+        const Filter filter(std::make_unique<KeyRangeScan>(table, 0, 1, "", "", "full scan items"), test.m_make());
+        start = std::chrono::steady_clock::now();
+        filter.Run([&](const Tuple&) {
+            ++scan_batch_selected;
+            return true;
+        });
+        const double scan_batch_rate = MillionRowsPerSecond(rows.size(), start);
+
+        if (row_selected != resident_selected || row_selected != batch_selected || row_selected != scan_row_selected || row_selected != scan_batch_selected)
+        {
+            fmt::println("{}: results differ", test.m_text);
+            return 1;
+        }
+        fmt::println("{:<34} {:>8.1f} {:>10.1f} {:>12.1f} {:>10.2f} {:>12.2f}", test.m_text, row_rate, resident_rate, batch_rate, scan_row_rate, scan_batch_rate);
+    }
+
+    std::filesystem::remove("bench-filter.tbl");
+    std::filesystem::remove("bench-filter.idx");
+    std::filesystem::remove("bench-filter.wal");
+    return 0;
+}
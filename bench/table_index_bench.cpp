@@ -0,0 +1,113 @@
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <fmt/format.h>
+#include "catalog/table.h"
+#include "sql/executor.h"
+
+namespace
+{
+constexpr int kRows = 20000;
+constexpr int kMoreRows = 2000;
+constexpr int kAges = 100;
+
+void RemoveFiles()
+{
+    for (const char* suffix : { ".tbl", ".idx", ".wal", ".age.idx", ".email.idx" })
+    {
+        std::filesystem::remove(std::string("bench-index") + suffix);
+    }
+}
+
+Row MakeUser(const Schema& schema, int i)
+{
+    Row row(schema);
+    row.SetString("id", fmt::format("user-{:08}", i));
+    row.SetInt64("age", (i * 7919) % kAges);
+    row.SetString("email", fmt::format("{:08}@example.com", (i * 104729) % 1000003));
+    return row;
+}
+
+double MicrosSince(std::chrono::steady_clock::time_point start)
+{
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+//! @brief microseconds per query over queries, and the rows they returned
+std::pair<double, size_t> RunQueries(const Executor& executor, const std::vector<std::string>& queries)
+{
+    size_t rows = 0;
+    std::string error;
+    const auto start = std::chrono::steady_clock::now();
+    for (const std::string& sql : queries)
+    {
+        const std::optional<ResultSet> result = executor.Execute(sql, error);
+        rows += result ? result->m_rows.size() : 0;
+    }
+    return { MicrosSince(start) / static_cast<double>(queries.size()), rows };
+}
+}  // namespace
+
+int main()
+{
+    RemoveFiles();
+    const Schema schema({ { "id", ColumnType::kString, 0, false, true }, { "age", ColumnType::kInt64, 0, false, false }, { "email", ColumnType::kString, 0, false, false } });
+    Table table("bench-index", schema);
+    Executor executor;
+    executor.AddTable("users", table);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRows; ++i)
+    {
+        table.Insert(MakeUser(schema, i));
+    }
+    const double insert_plain = MicrosSince(start) / kRows;
+
+    std::vector<std::string> point_queries;
+    for (int i = 0; i < 200; ++i)
+    {
+        point_queries.push_back(fmt::format("SELECT id FROM users WHERE email = '{:08}@example.com'", (i * 97 * 104729) % 1000003));
+    }
+    std::vector<std::string> range_queries;
+    for (int age = 0; age < 20; ++age)
+    {
+        range_queries.push_back(fmt::format("SELECT id FROM users WHERE age >= {} AND age < {}", age * 5, age * 5 + 2));
+    }
+    const auto [point_scan, point_scan_rows] = RunQueries(executor, point_queries);
+    const auto [range_scan, range_scan_rows] = RunQueries(executor, range_queries);
+
+    start = std::chrono::steady_clock::now();
+    if (!table.CreateIndex("age") || !table.CreateIndex("email"))
+    {
+        fmt::println("failed to create the indexes");
+        return 1;
+    }
+    const double create = MicrosSince(start) / 1000;
+
+    const auto [point_index, point_index_rows] = RunQueries(executor, point_queries);
+    const auto [range_index, range_index_rows] = RunQueries(executor, range_queries);
+    if (point_scan_rows != point_index_rows || range_scan_rows != range_index_rows)
+    {
+        fmt::println("results differ");
+        return 1;
+    }
+
+    start = std::chrono::steady_clock::now();
+    for (int i = kRows; i < kRows + kMoreRows; ++i)
+    {
+        table.Insert(MakeUser(schema, i));
+    }
+    const double insert_indexed = MicrosSince(start) / kMoreRows;
+
+    // queries run through the executor, so both columns include parsing and planning
+    fmt::println("{} rows, {:.1f} ms to index age and email", kRows, create);
+    fmt::println("{:<36} {:>12} {:>12} {:>8}", "query", "scan us", "index us", "rows");
+    fmt::println("{:<36} {:>12.1f} {:>12.1f} {:>8}", "email = <value>", point_scan, point_index, point_index_rows / point_queries.size());
+    fmt::println("{:<36} {:>12.1f} {:>12.1f} {:>8}", "age >= <n> AND age < <n + 2>", range_scan, range_index, range_index_rows / range_queries.size());
+    fmt::println("us per insert: {:.1f} without indexes, {:.1f} with two", insert_plain, insert_indexed);
+
+    RemoveFiles();
+    return 0;
+}
@@ -0,0 +1,40 @@
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <fmt/format.h>
+#include "catalog/table.h"
+
+namespace
+{
+constexpr int kRounds = 8;
+constexpr int kRowsPerRound = 2500;
+}  // namespace
+
+int main()
+{
+    std::filesystem::remove("bench-insert.tbl");
+    std::filesystem::remove("bench-insert.idx");
+    std::filesystem::remove("bench-insert.wal");
+
+    const Schema schema({ { "id", ColumnType::kString, 0, false, true }, { "name", ColumnType::kString, 0, true, false } });
+    Table table("bench-insert", schema);
+    fmt::println("{:>10} {:>16}", "rows", "us per insert");
+    for (int round = 0; round < kRounds; ++round)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kRowsPerRound; ++i)
+        {
+            Row row(schema);
+            row.SetString("id", fmt::format("user-{:08}", round * kRowsPerRound + i));
+            row.SetString("name", "a reasonably sized display name");
+            table.Insert(std::move(row));
+        }
+        const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        fmt::println("{:>10} {:>16.1f}", table.Size(), elapsed.count() / kRowsPerRound);
+    }
+
+    std::filesystem::remove("bench-insert.tbl");
+    std::filesystem::remove("bench-insert.idx");
+    std::filesystem::remove("bench-insert.wal");
+    return 0;
+}
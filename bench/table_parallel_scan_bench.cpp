@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+#include "catalog/table.h"
+
+namespace
+{
+constexpr int kRows = 100000;
+constexpr int kRounds = 3;
+
+void RemoveFiles()
+{
+    std::filesystem::remove("bench-parallel.tbl");
+    std::filesystem::remove("bench-parallel.idx");
+    std::filesystem::remove("bench-parallel.wal");
+}
+
+//! @brief rows/sec of the fastest of kRounds runs of scan
+template <typename Scan>
+double BestRate(Scan scan)
+{
+    double best = 0;
+    for (int round = 0; round < kRounds; ++round)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        scan();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::max(best, kRows / elapsed.count());
+    }
+    return best;
+}
+
+//! @brief a per-worker partial result, padded so workers do not share a cache line
+struct alignas(64) Partial
+{
+    int64_t m_value { 0 };
+};
+}  // namespace
+
+int main()
+{
+    RemoveFiles();
+    const Schema schema({ { "id", ColumnType::kString, 0, false, true }, { "amount", ColumnType::kInt64, 0, false, false }, { "note", ColumnType::kString, 0, true, false } });
+    Table table("bench-parallel", schema);
+    for (int i = 0; i < kRows; ++i)
+    {
+        Row row(schema);
+        row.SetString("id", fmt::format("order-{:08}", (i * 7919) % kRows));
+        row.SetInt64("amount", (i * 31) % 1000);
+        row.SetString("note", "a note of moderate length, like most rows carry");
+        table.Insert(std::move(row));
+    }
+
+    // one thread through ScanRange as the baseline, then ParallelScan as a filter that counts
+    // matches and as a SUM with per-worker partial sums
+    int64_t baseline_count = 0;
+    const double baseline = BestRate([&] {
+        baseline_count = 0;
+        table.ScanRange("", "", [&](const Row& row) {
+            baseline_count += row.GetInt64(1).value_or(0) < 100;
+            return true;
+        });
+    });
+    fmt::println("{} rows, {} hardware threads; ScanRange {:.2f} Mrows/s", kRows, std::thread::hardware_concurrency(), baseline / 1e6);
+    fmt::println("{:>8} {:>14} {:>10} {:>14} {:>10}", "threads", "filter Mrows/s", "speedup", "sum Mrows/s", "speedup");
+
+    double filter_single = 0;
+    double sum_single = 0;
+    for (size_t threads : { 1, 2, 4, 8, 16 })
+    {
+        std::vector<Partial> counts(threads);
+        const double filter = BestRate([&] {
+            std::fill(counts.begin(), counts.end(), Partial());
+            table.ParallelScan([](const RowView& row) { return row.GetInt64(1).value_or(0) < 100; },
+                               [&](size_t worker, const std::vector<RowView>& rows) {
+                                   counts[worker].m_value += static_cast<int64_t>(rows.size());
+                                   return true;
+                               },
+                               threads);
+        });
+        std::vector<Partial> sums(threads);
+        const double sum = BestRate([&] {
+            std::fill(sums.begin(), sums.end(), Partial());
+            table.ParallelScan(nullptr,
+                               [&](size_t worker, const std::vector<RowView>& rows) {
+                                   for (const RowView& row : rows)
+                                   {
+                                       sums[worker].m_value += row.GetInt64(1).value_or(0);
+                                   }
+                                   return true;
+                               },
+                               threads);
+        });
+
+        int64_t count = 0;
+        for (const Partial& partial : counts)
+        {
+            count += partial.m_value;
+        }
+        if (count != baseline_count)
+        {
+            fmt::println("{} threads: {} rows match instead of {}", threads, count, baseline_count);
+            return 1;
+        }
+        if (threads == 1)
+        {
+            filter_single = filter;
+            sum_single = sum;
+        }
+        fmt::println("{:>8} {:>14.2f} {:>10.2f} {:>14.2f} {:>10.2f}", threads, filter / 1e6, filter / filter_single, sum / 1e6, sum / sum_single);
+    }
+
+    RemoveFiles();
+    return 0;
+}
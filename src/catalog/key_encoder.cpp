@@ -0,0 +1,63 @@
+#include "catalog/key_encoder.h"
+
+#include <utility>
+
+namespace
+{
+constexpr char kEscape = '\x00';
+constexpr char kEscapedZero = '\xFF';
+constexpr char kTerminator = '\x01';
+}  // namespace
+
+KeyEncoder& KeyEncoder::AddInt64(int64_t value)
+{
+    CloseVariable();
+    // flipping the sign bit puts negative values below positive ones as unsigned integers
+    const uint64_t bits = static_cast<uint64_t>(value) ^ (uint64_t { 1 } << 63);
+    for (int shift = 56; shift >= 0; shift -= 8)
+    {
+        m_key.push_back(static_cast<char>((bits >> shift) & 0xFF));
+    }
+    return *this;
+}
+
+KeyEncoder& KeyEncoder::AddString(std::string_view value)
+{
+    CloseVariable();
+    m_open = m_key.size();
+    m_key.append(value);
+    return *this;
+}
+
+KeyEncoder& KeyEncoder::AddBytes(const uint8_t* data, size_t size)
+{
+    return AddString(std::string_view(reinterpret_cast<const char*>(data), size));
+}
+
+std::string KeyEncoder::Finish()
+{
+    m_open.reset();
+    return std::exchange(m_key, std::string());
+}
+
+void KeyEncoder::CloseVariable()
+{
+    if (!m_open)
+    {
+        return;
+    }
+
+    const std::string value = m_key.substr(*m_open);
+    m_key.resize(*m_open);
+    for (char byte : value)
+    {
+        m_key.push_back(byte);
+        if (byte == kEscape)
+        {
+            m_key.push_back(kEscapedZero);
+        }
+    }
+    m_key.push_back(kEscape);
+    m_key.push_back(kTerminator);
+    m_open.reset();
+}
@@ -0,0 +1,35 @@
+#ifndef FOODB_KEY_ENCODER_H_
+#define FOODB_KEY_ENCODER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+//! @brief builds index keys whose bytes, compared with memcmp, sort like the values they encode
+//!
+//! Values are added in key column order. An int64 is written big-endian with its sign bit
+//! flipped. A string or bytes value that ends the key is written as is; one followed by more
+//! values has every 0x00 escaped as 0x00 0xFF and ends with 0x00 0x01, so it sorts before any
+//! longer value it is a prefix of and the next value starts at a comparable position. A key
+//! of a single string column is therefore the string itself.
+class KeyEncoder
+{
+public:
+    KeyEncoder& AddInt64(int64_t value);
+    KeyEncoder& AddString(std::string_view value);
+    KeyEncoder& AddBytes(const uint8_t* data, size_t size);
+    //! @brief the encoded key, leaving the encoder empty
+    std::string Finish();
+
+private:
+    //! @brief escape and terminate the trailing string or bytes value, now that another value follows
+    void CloseVariable();
+
+    std::string m_key;
+    //! where a trailing string or bytes value starts while it is still written as is
+    std::optional<size_t> m_open;
+};
+
+#endif
@@ -1,12 +1,21 @@
 #include "catalog/row.h"
 
+#include <cassert>
 #include <cstring>
 #include <utility>
 
 namespace
 {
+constexpr uint8_t kRowVersion = 2;
+//! version 1 rows start with this magic, whose first byte can never be a version 2 tag
 constexpr uint32_t kRowMagic = 0x524F5731;  // ROW1
-constexpr uint32_t kRowVersion = 1;
+constexpr uint32_t kLegacyRowVersion = 1;
+
+const Schema& EmptySchema()
+{
+    static const Schema kEmpty;
+    return kEmpty;
+}
 
 void WriteUint32(std::vector<uint8_t>& buffer, uint32_t value)
 {
@@ -66,108 +75,347 @@ std::optional<std::string> ReadString(const std::vector<uint8_t>& buffer, size_t
 }
 }  // namespace
 
-Row::Row(Schema schema)
-    : m_schema(std::move(schema))
+const uint8_t* ByteSpan::begin() const
 {
+    return m_data;
 }
 
-const Schema& Row::GetSchema() const
+const uint8_t* ByteSpan::end() const
 {
-    return m_schema;
+    return m_data + m_size;
 }
 
-bool Row::Has(const std::string& column) const
+bool ByteSpan::operator==(const ByteSpan& other) const
 {
-    return m_values.find(column) != m_values.end();
+    return m_size == other.m_size && (m_size == 0 || std::memcmp(m_data, other.m_data, m_size) == 0);
 }
 
-bool Row::MatchesSchema(const Schema& schema) const
+bool ByteSpan::operator!=(const ByteSpan& other) const
 {
-    return m_schema.Matches(schema);
+    return !(*this == other);
 }
 
-bool Row::SetInt64(const std::string& column, int64_t value)
+RowView::RowView(const Schema* schema, const uint8_t* data, size_t size)
+    : m_schema(schema)
+    , m_data(data)
+    , m_size(size)
+{
+}
+
+bool RowView::Validate(const Schema& schema, const uint8_t* data, size_t size)
 {
-    const Column* meta = m_schema.FindColumn(column);
-    if (!meta || meta->m_type != ColumnType::kInt64)
+    const size_t data_offset = DataOffset(schema);
+    if (size < data_offset || data[0] != kRowVersion)
     {
         return false;
     }
 
-    std::vector<uint8_t> bytes(sizeof(value));
-    std::memcpy(bytes.data(), &value, sizeof(value));
-    m_values[column] = std::move(bytes);
-    return true;
+    uint32_t begin = 0;
+    for (size_t ordinal = 0; ordinal < schema.Size(); ++ordinal)
+    {
+        const Column& column = schema.Columns()[ordinal];
+        if (column.m_type == ColumnType::kInt64)
+        {
+            continue;
+        }
+
+        const uint32_t end = VariableEnd(schema, data, schema.Slot(ordinal));
+        if (end < begin || (column.m_size != 0 && end - begin > column.m_size))
+        {
+            return false;
+        }
+        begin = end;
+    }
+    return data_offset + begin == size;
 }
 
-bool Row::SetString(const std::string& column, std::string value)
+void RowView::GatherInt64(const Schema& schema, size_t ordinal, const uint8_t* rows, const size_t* offsets, size_t count, int64_t* values, uint8_t* valid)
 {
-    const Column* meta = m_schema.FindColumn(column);
-    if (!meta || meta->m_type != ColumnType::kString)
+    assert(schema.Columns()[ordinal].m_type == ColumnType::kInt64 && "GatherInt64: not an int64 column.");
+    const size_t null_byte = sizeof(kRowVersion) + ordinal / 8;
+    const size_t shift = ordinal % 8;
+    const size_t offset = FixedOffset(schema) + schema.Slot(ordinal);
+    for (size_t i = 0; i < count; ++i)
     {
-        return false;
+        const uint8_t* data = rows + offsets[i];
+        const uint8_t present = ((data[null_byte] >> shift) & 1) ^ 1;
+        int64_t value = 0;
+        std::memcpy(&value, data + offset, sizeof(value));
+        values[i] = value & -static_cast<int64_t>(present);
+        valid[i] = present;
     }
+}
 
-    std::vector<uint8_t> bytes(value.begin(), value.end());
-    m_values[column] = std::move(bytes);
-    return true;
+void RowView::GatherVariable(const Schema& schema, size_t ordinal, const uint8_t* rows, const size_t* offsets, size_t count, std::string_view* values,
+                             uint8_t* valid)
+{
+    assert(schema.Columns()[ordinal].m_type != ColumnType::kInt64 && "GatherVariable: not a string or bytes column.");
+    const size_t null_byte = sizeof(kRowVersion) + ordinal / 8;
+    const size_t shift = ordinal % 8;
+    const size_t index = schema.Slot(ordinal);
+    const size_t data_offset = DataOffset(schema);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint8_t* data = rows + offsets[i];
+        valid[i] = ((data[null_byte] >> shift) & 1) ^ 1;
+        if (!valid[i])
+        {
+            values[i] = std::string_view();
+            continue;
+        }
+        const uint32_t begin = index == 0 ? 0 : VariableEnd(schema, data, index - 1);
+        const uint32_t end = VariableEnd(schema, data, index);
+        values[i] = std::string_view(reinterpret_cast<const char*>(data + data_offset + begin), end - begin);
+    }
 }
 
-bool Row::SetBytes(const std::string& column, std::vector<uint8_t> value)
+bool RowView::Valid() const
 {
-    const Column* meta = m_schema.FindColumn(column);
-    if (!meta || meta->m_type != ColumnType::kBytes)
+    return m_schema != nullptr;
+}
+
+const Schema& RowView::GetSchema() const
+{
+    return m_schema ? *m_schema : EmptySchema();
+}
+
+const uint8_t* RowView::Data() const
+{
+    return m_data;
+}
+
+size_t RowView::Size() const
+{
+    return m_size;
+}
+
+bool RowView::Has(const std::string& column) const
+{
+    const std::optional<size_t> ordinal = GetSchema().Ordinal(column);
+    return ordinal && Has(*ordinal);
+}
+
+bool RowView::Has(size_t ordinal) const
+{
+    if (ordinal >= GetSchema().Size())
     {
         return false;
     }
+    return ((m_data[sizeof(kRowVersion) + ordinal / 8] >> (ordinal % 8)) & 1) == 0;
+}
 
-    m_values[column] = std::move(value);
-    return true;
+std::optional<int64_t> RowView::GetInt64(const std::string& column) const
+{
+    const std::optional<size_t> ordinal = GetSchema().Ordinal(column);
+    return ordinal ? GetInt64(*ordinal) : std::nullopt;
 }
 
-std::optional<int64_t> Row::GetInt64(const std::string& column) const
+std::optional<std::string_view> RowView::GetString(const std::string& column) const
 {
-    const auto it = m_values.find(column);
-    if (it == m_values.end() || it->second.size() != sizeof(int64_t))
+    const std::optional<size_t> ordinal = GetSchema().Ordinal(column);
+    return ordinal ? GetString(*ordinal) : std::nullopt;
+}
+
+std::optional<ByteSpan> RowView::GetBytes(const std::string& column) const
+{
+    const std::optional<size_t> ordinal = GetSchema().Ordinal(column);
+    return ordinal ? GetBytes(*ordinal) : std::nullopt;
+}
+
+std::optional<int64_t> RowView::GetInt64(size_t ordinal) const
+{
+    if (!Has(ordinal) || m_schema->Columns()[ordinal].m_type != ColumnType::kInt64)
     {
         return std::nullopt;
     }
 
     int64_t value = 0;
-    std::memcpy(&value, it->second.data(), sizeof(value));
+    std::memcpy(&value, m_data + FixedOffset(*m_schema) + m_schema->Slot(ordinal), sizeof(value));
     return value;
 }
 
-std::optional<std::string> Row::GetString(const std::string& column) const
+std::optional<std::string_view> RowView::GetString(size_t ordinal) const
 {
-    const auto it = m_values.find(column);
-    if (it == m_values.end())
+    const std::optional<ByteSpan> value = GetVariable(ordinal, ColumnType::kString);
+    if (!value)
     {
         return std::nullopt;
     }
-    return std::string(it->second.begin(), it->second.end());
+    return std::string_view(reinterpret_cast<const char*>(value->m_data), value->m_size);
 }
 
-std::optional<std::vector<uint8_t>> Row::GetBytes(const std::string& column) const
+std::optional<ByteSpan> RowView::GetBytes(size_t ordinal) const
+{
+    return GetVariable(ordinal, ColumnType::kBytes);
+}
+
+std::optional<ByteSpan> RowView::GetVariable(size_t ordinal, ColumnType type) const
 {
-    const auto it = m_values.find(column);
-    if (it == m_values.end())
+    if (!Has(ordinal) || m_schema->Columns()[ordinal].m_type != type)
     {
         return std::nullopt;
     }
-    return it->second;
+
+    const size_t index = m_schema->Slot(ordinal);
+    const uint32_t begin = index == 0 ? 0 : VariableEnd(*m_schema, m_data, index - 1);
+    const uint32_t end = VariableEnd(*m_schema, m_data, index);
+    return ByteSpan { m_data + DataOffset(*m_schema) + begin, end - begin };
+}
+
+uint32_t RowView::VariableEnd(const Schema& schema, const uint8_t* data, size_t index)
+{
+    uint32_t end = 0;
+    std::memcpy(&end, data + TableOffset(schema) + index * sizeof(end), sizeof(end));
+    return end;
+}
+
+size_t RowView::FixedOffset(const Schema& schema)
+{
+    return sizeof(kRowVersion) + (schema.Size() + 7) / 8;
+}
+
+size_t RowView::TableOffset(const Schema& schema)
+{
+    return FixedOffset(schema) + schema.FixedSize();
+}
+
+size_t RowView::DataOffset(const Schema& schema)
+{
+    return TableOffset(schema) + schema.VariableCount() * sizeof(uint32_t);
+}
+
+Row::Row(Schema schema)
+    : Row(std::make_shared<const Schema>(std::move(schema)))
+{
+}
+
+Row::Row(std::shared_ptr<const Schema> schema)
+    : m_schema(std::move(schema))
+{
+    // every column starts out null
+    m_data.assign(RowView::DataOffset(*m_schema), 0);
+    m_data[0] = kRowVersion;
+    for (size_t ordinal = 0; ordinal < m_schema->Size(); ++ordinal)
+    {
+        SetNull(ordinal, true);
+    }
+}
+
+const Schema& Row::GetSchema() const
+{
+    return m_schema ? *m_schema : EmptySchema();
+}
+
+RowView Row::View() const
+{
+    return RowView(&GetSchema(), m_data.data(), m_data.size());
+}
+
+bool Row::Has(const std::string& column) const
+{
+    return View().Has(column);
+}
+
+bool Row::Has(size_t ordinal) const
+{
+    return View().Has(ordinal);
+}
+
+bool Row::MatchesSchema(const Schema& schema) const
+{
+    return m_schema.get() == &schema || GetSchema().Matches(schema);
+}
+
+bool Row::SetInt64(const std::string& column, int64_t value)
+{
+    const std::optional<size_t> ordinal = GetSchema().Ordinal(column);
+    return ordinal && SetInt64(*ordinal, value);
+}
+
+bool Row::SetString(const std::string& column, std::string value)
+{
+    const std::optional<size_t> ordinal = GetSchema().Ordinal(column);
+    return ordinal && SetString(*ordinal, value);
+}
+
+bool Row::SetBytes(const std::string& column, std::vector<uint8_t> value)
+{
+    const std::optional<size_t> ordinal = GetSchema().Ordinal(column);
+    return ordinal && SetBytes(*ordinal, value);
+}
+
+bool Row::SetInt64(size_t ordinal, int64_t value)
+{
+    if (ordinal >= GetSchema().Size() || m_schema->Columns()[ordinal].m_type != ColumnType::kInt64)
+    {
+        return false;
+    }
+
+    std::memcpy(m_data.data() + RowView::FixedOffset(*m_schema) + m_schema->Slot(ordinal), &value, sizeof(value));
+    SetNull(ordinal, false);
+    return true;
+}
+
+bool Row::SetString(size_t ordinal, const std::string& value)
+{
+    return SetVariable(ordinal, ColumnType::kString, reinterpret_cast<const uint8_t*>(value.data()), value.size());
+}
+
+bool Row::SetBytes(size_t ordinal, const std::vector<uint8_t>& value)
+{
+    return SetVariable(ordinal, ColumnType::kBytes, value.data(), value.size());
+}
+
+std::optional<int64_t> Row::GetInt64(const std::string& column) const
+{
+    return View().GetInt64(column);
+}
+
+std::optional<std::string> Row::GetString(const std::string& column) const
+{
+    const std::optional<std::string_view> value = View().GetString(column);
+    return value ? std::optional<std::string>(*value) : std::nullopt;
+}
+
+std::optional<std::vector<uint8_t>> Row::GetBytes(const std::string& column) const
+{
+    const std::optional<ByteSpan> value = View().GetBytes(column);
+    return value ? std::optional<std::vector<uint8_t>>(std::in_place, value->begin(), value->end()) : std::nullopt;
+}
+
+std::optional<int64_t> Row::GetInt64(size_t ordinal) const
+{
+    return View().GetInt64(ordinal);
+}
+
+std::optional<std::string> Row::GetString(size_t ordinal) const
+{
+    const std::optional<std::string_view> value = View().GetString(ordinal);
+    return value ? std::optional<std::string>(*value) : std::nullopt;
+}
+
+std::optional<std::vector<uint8_t>> Row::GetBytes(size_t ordinal) const
+{
+    const std::optional<ByteSpan> value = View().GetBytes(ordinal);
+    return value ? std::optional<std::vector<uint8_t>>(std::in_place, value->begin(), value->end()) : std::nullopt;
+}
+
+const std::vector<uint8_t>& Row::Serialize() const
+{
+    return m_data;
 }
 
-std::vector<uint8_t> Row::Serialize() const
+std::vector<uint8_t> Row::SerializeLegacy() const
 {
+    const Schema& schema = GetSchema();
     std::vector<uint8_t> buffer;
     buffer.reserve(64);
 
     WriteUint32(buffer, kRowMagic);
-    WriteUint32(buffer, kRowVersion);
-    WriteUint32(buffer, static_cast<uint32_t>(m_schema.Size()));
+    WriteUint32(buffer, kLegacyRowVersion);
+    WriteUint32(buffer, static_cast<uint32_t>(schema.Size()));
 
-    for (const Column& column : m_schema.Columns())
+    for (const Column& column : schema.Columns())
     {
         WriteString(buffer, column.m_name);
         WriteUint32(buffer, static_cast<uint32_t>(column.m_type));
@@ -176,26 +424,53 @@ std::vector<uint8_t> Row::Serialize() const
         WriteUint32(buffer, column.m_primary_key ? 1U : 0U);
     }
 
-    for (const Column& column : m_schema.Columns())
+    for (size_t ordinal = 0; ordinal < schema.Size(); ++ordinal)
     {
-        const auto it = m_values.find(column.m_name);
-        const bool has_value = it != m_values.end();
-        WriteUint32(buffer, has_value ? 1U : 0U);
-        if (!has_value)
+        WriteUint32(buffer, Has(ordinal) ? 1U : 0U);
+        if (!Has(ordinal))
         {
             continue;
         }
 
-        WriteUint32(buffer, static_cast<uint32_t>(it->second.size()));
-        const size_t offset = buffer.size();
-        buffer.resize(offset + it->second.size());
-        std::memcpy(buffer.data() + offset, it->second.data(), it->second.size());
+        ByteSpan value { m_data.data() + RowView::FixedOffset(schema) + schema.Slot(ordinal), sizeof(int64_t) };
+        if (schema.Columns()[ordinal].m_type != ColumnType::kInt64)
+        {
+            value = *View().GetVariable(ordinal, schema.Columns()[ordinal].m_type);
+        }
+        WriteUint32(buffer, static_cast<uint32_t>(value.m_size));
+        buffer.insert(buffer.end(), value.begin(), value.end());
     }
 
     return buffer;
 }
 
-std::optional<Row> Row::Deserialize(const std::vector<uint8_t>& payload)
+std::optional<Row> Row::Deserialize(const std::vector<uint8_t>& payload, const Schema& schema)
+{
+    return Deserialize(payload, std::make_shared<const Schema>(schema));
+}
+
+std::optional<Row> Row::Deserialize(const std::vector<uint8_t>& payload, std::shared_ptr<const Schema> schema)
+{
+    if (payload.empty())
+    {
+        return std::nullopt;
+    }
+    if (payload[0] != kRowVersion)
+    {
+        return DeserializeLegacy(payload, std::move(schema));
+    }
+    if (!RowView::Validate(*schema, payload.data(), payload.size()))
+    {
+        return std::nullopt;
+    }
+
+    Row row;
+    row.m_schema = std::move(schema);
+    row.m_data = payload;
+    return row;
+}
+
+std::optional<Row> Row::DeserializeLegacy(const std::vector<uint8_t>& payload, std::shared_ptr<const Schema> schema)
 {
     if (payload.size() < sizeof(uint32_t) * 3)
     {
@@ -206,11 +481,10 @@ std::optional<Row> Row::Deserialize(const std::vector<uint8_t>& payload)
     const uint32_t magic = ReadUint32(payload, offset);
     const uint32_t version = ReadUint32(payload, offset);
     const uint32_t column_count = ReadUint32(payload, offset);
-    if (magic != kRowMagic || version != kRowVersion)
+    if (magic != kRowMagic || version != kLegacyRowVersion)
     {
         return std::nullopt;
     }
-
     std::vector<Column> columns;
     columns.reserve(column_count);
     for (uint32_t i = 0; i < column_count; ++i)
@@ -230,9 +504,15 @@ std::optional<Row> Row::Deserialize(const std::vector<uint8_t>& payload)
         columns.push_back(std::move(column));
     }
 
-    Row row(Schema(std::move(columns)));
-    for (const Column& column : row.GetSchema().Columns())
+    if (!Schema(std::move(columns)).Matches(*schema))
     {
+        return std::nullopt;
+    }
+
+    Row row(std::move(schema));
+    for (size_t ordinal = 0; ordinal < row.GetSchema().Size(); ++ordinal)
+    {
+        const Column& column = row.GetSchema().Columns()[ordinal];
         if (offset + sizeof(uint32_t) > payload.size())
         {
             return std::nullopt;
@@ -255,30 +535,74 @@ std::optional<Row> Row::Deserialize(const std::vector<uint8_t>& payload)
             return std::nullopt;
         }
 
-        std::vector<uint8_t> value(value_size);
-        std::memcpy(value.data(), payload.data() + offset, value_size);
+        const uint8_t* value = payload.data() + offset;
         offset += value_size;
-
-        if (column.m_type == ColumnType::kInt64 && value_size != sizeof(int64_t))
+        if (column.m_type == ColumnType::kInt64)
         {
-            return std::nullopt;
+            int64_t number = 0;
+            if (value_size != sizeof(number))
+            {
+                return std::nullopt;
+            }
+            std::memcpy(&number, value, sizeof(number));
+            row.SetInt64(ordinal, number);
         }
-        if (column.m_type == ColumnType::kString && column.m_size != 0 && value_size > column.m_size)
+        else if ((column.m_size != 0 && value_size > column.m_size) || !row.SetVariable(ordinal, column.m_type, value, value_size))
         {
             return std::nullopt;
         }
-        if (column.m_type == ColumnType::kBytes && column.m_size != 0 && value_size > column.m_size)
-        {
-            return std::nullopt;
-        }
-
-        row.m_values[column.m_name] = std::move(value);
     }
 
     return row;
 }
 
-const std::unordered_map<std::string, std::vector<uint8_t>>& Row::Values() const
+bool Row::SetVariable(size_t ordinal, ColumnType type, const uint8_t* data, size_t size)
 {
-    return m_values;
+    if (ordinal >= GetSchema().Size() || m_schema->Columns()[ordinal].m_type != type)
+    {
+        return false;
+    }
+
+    const size_t index = m_schema->Slot(ordinal);
+    const size_t table_offset = RowView::TableOffset(*m_schema);
+    const size_t data_offset = RowView::DataOffset(*m_schema);
+    const size_t begin = data_offset + (index == 0 ? 0 : RowView::VariableEnd(*m_schema, m_data.data(), index - 1));
+    const size_t old_size = data_offset + RowView::VariableEnd(*m_schema, m_data.data(), index) - begin;
+    const auto first = m_data.begin() + static_cast<std::ptrdiff_t>(begin);
+    if (size > old_size)
+    {
+        m_data.insert(first + static_cast<std::ptrdiff_t>(old_size), size - old_size, 0);
+    }
+    else
+    {
+        m_data.erase(first + static_cast<std::ptrdiff_t>(size), first + static_cast<std::ptrdiff_t>(old_size));
+    }
+    if (size > 0)
+    {
+        std::memcpy(m_data.data() + begin, data, size);
+    }
+
+    // shift the end offsets of this and every later variable-length column
+    const int64_t delta = static_cast<int64_t>(size) - static_cast<int64_t>(old_size);
+    for (size_t i = index; i < m_schema->VariableCount(); ++i)
+    {
+        const uint32_t end = static_cast<uint32_t>(RowView::VariableEnd(*m_schema, m_data.data(), i) + delta);
+        std::memcpy(m_data.data() + table_offset + i * sizeof(uint32_t), &end, sizeof(end));
+    }
+    SetNull(ordinal, false);
+    return true;
+}
+
+void Row::SetNull(size_t ordinal, bool is_null)
+{
+    uint8_t& bits = m_data[sizeof(kRowVersion) + ordinal / 8];
+    const uint8_t mask = static_cast<uint8_t>(1U << (ordinal % 8));
+    if (is_null)
+    {
+        bits |= mask;
+    }
+    else
+    {
+        bits &= static_cast<uint8_t>(~mask);
+    }
 }
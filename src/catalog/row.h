@@ -3,39 +3,125 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include "catalog/schema.h"
 
+//! @brief bytes of a column value inside someone else's buffer, std::span<const uint8_t> before C++20
+struct ByteSpan
+{
+    const uint8_t* begin() const;
+    const uint8_t* end() const;
+    bool operator==(const ByteSpan& other) const;
+    bool operator!=(const ByteSpan& other) const;
+
+    const uint8_t* m_data { nullptr };
+    size_t m_size { 0 };
+};
+
+//! @brief read-only accessors over an encoded version 2 row that never copy or allocate
+//!
+//! The view points into a buffer it does not own (a Row, a cached row, a page) and is
+//! only valid as long as that buffer and the schema are.
+class RowView
+{
+public:
+    RowView() = default;
+    RowView(const Schema* schema, const uint8_t* data, size_t size);
+
+    //! @brief whether data holds a well-formed version 2 row of schema
+    static bool Validate(const Schema& schema, const uint8_t* data, size_t size);
+    //! @brief one int64 column of count rows of schema into arrays, with valid 0 and value 0 for NULL
+    //!
+    //! The rows share one buffer and row i starts at rows + offsets[i]. The column's position is
+    //! computed once for all of them, so this is a tight loop of loads.
+    static void GatherInt64(const Schema& schema, size_t ordinal, const uint8_t* rows, const size_t* offsets, size_t count, int64_t* values, uint8_t* valid);
+    //! @brief one string or bytes column of count rows of schema as views into the rows
+    static void GatherVariable(const Schema& schema, size_t ordinal, const uint8_t* rows, const size_t* offsets, size_t count, std::string_view* values,
+                               uint8_t* valid);
+
+    bool Valid() const;
+    const Schema& GetSchema() const;
+    const uint8_t* Data() const;
+    size_t Size() const;
+    bool Has(const std::string& column) const;
+    bool Has(size_t ordinal) const;
+
+    std::optional<int64_t> GetInt64(const std::string& column) const;
+    std::optional<std::string_view> GetString(const std::string& column) const;
+    std::optional<ByteSpan> GetBytes(const std::string& column) const;
+    std::optional<int64_t> GetInt64(size_t ordinal) const;
+    std::optional<std::string_view> GetString(size_t ordinal) const;
+    std::optional<ByteSpan> GetBytes(size_t ordinal) const;
+
+private:
+    friend class Row;
+
+    std::optional<ByteSpan> GetVariable(size_t ordinal, ColumnType type) const;
+    static uint32_t VariableEnd(const Schema& schema, const uint8_t* data, size_t index);
+    static size_t FixedOffset(const Schema& schema);
+    static size_t TableOffset(const Schema& schema);
+    static size_t DataOffset(const Schema& schema);
+
+    const Schema* m_schema { nullptr };
+    const uint8_t* m_data { nullptr };
+    size_t m_size { 0 };
+};
+
+//! @brief a row of one schema, kept in its encoded form
+//!
+//! Values live in a single buffer laid out as [u8 version 2][null bitmap][int64 columns]
+//! [u32 end offset per variable-length column][variable data], so reading a column is an
+//! offset lookup, serializing is free, and a row decoded from storage is one allocation.
+//! The schema is shared by every row built from the same pointer.
 class Row
 {
 public:
     Row() = default;
     explicit Row(Schema schema);
+    explicit Row(std::shared_ptr<const Schema> schema);
 
     const Schema& GetSchema() const;
+    //! @brief zero-copy accessors, valid until the row is modified or destroyed
+    RowView View() const;
     bool Has(const std::string& column) const;
+    bool Has(size_t ordinal) const;
     bool MatchesSchema(const Schema& schema) const;
 
     bool SetInt64(const std::string& column, int64_t value);
     bool SetString(const std::string& column, std::string value);
     bool SetBytes(const std::string& column, std::vector<uint8_t> value);
+    bool SetInt64(size_t ordinal, int64_t value);
+    bool SetString(size_t ordinal, const std::string& value);
+    bool SetBytes(size_t ordinal, const std::vector<uint8_t>& value);
 
     std::optional<int64_t> GetInt64(const std::string& column) const;
     std::optional<std::string> GetString(const std::string& column) const;
     std::optional<std::vector<uint8_t>> GetBytes(const std::string& column) const;
+    std::optional<int64_t> GetInt64(size_t ordinal) const;
+    std::optional<std::string> GetString(size_t ordinal) const;
+    std::optional<std::vector<uint8_t>> GetBytes(size_t ordinal) const;
 
-    std::vector<uint8_t> Serialize() const;
-    static std::optional<Row> Deserialize(const std::vector<uint8_t>& payload);
-
-    const std::unordered_map<std::string, std::vector<uint8_t>>& Values() const;
+    //! @brief the encoded row; the schema is not part of it, whoever stores rows keeps it once
+    const std::vector<uint8_t>& Serialize() const;
+    //! @brief encode in the version 1 layout that embeds the full schema in every row
+    std::vector<uint8_t> SerializeLegacy() const;
+    //! @brief decode a row of schema, version 1 payloads must embed an identical schema
+    static std::optional<Row> Deserialize(const std::vector<uint8_t>& payload, std::shared_ptr<const Schema> schema);
+    static std::optional<Row> Deserialize(const std::vector<uint8_t>& payload, const Schema& schema);
 
 private:
-    Schema m_schema;
-    std::unordered_map<std::string, std::vector<uint8_t>> m_values;
+    static std::optional<Row> DeserializeLegacy(const std::vector<uint8_t>& payload, std::shared_ptr<const Schema> schema);
+    bool SetVariable(size_t ordinal, ColumnType type, const uint8_t* data, size_t size);
+    void SetNull(size_t ordinal, bool is_null);
+
+    std::shared_ptr<const Schema> m_schema;
+    std::vector<uint8_t> m_data;
 };
 
 #endif
@@ -0,0 +1,75 @@
+#include "catalog/row_cache.h"
+
+RowCache::RowCache(size_t capacity)
+    : m_capacity(capacity)
+{
+}
+
+std::optional<Row> RowCache::Get(const std::string& primary_key)
+{
+    const Row* row = Find(primary_key);
+    return row ? std::optional<Row>(*row) : std::nullopt;
+}
+
+const Row* RowCache::Find(const std::string& primary_key)
+{
+    const auto it = m_index.find(primary_key);
+    if (it == m_index.end())
+    {
+        return nullptr;
+    }
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return &it->second->second;
+}
+
+const Row* RowCache::Put(const std::string& primary_key, Row row)
+{
+    if (m_capacity == 0)
+    {
+        return nullptr;
+    }
+
+    const auto it = m_index.find(primary_key);
+    if (it != m_index.end())
+    {
+        it->second->second = std::move(row);
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return &it->second->second;
+    }
+
+    if (m_entries.size() >= m_capacity)
+    {
+        m_index.erase(m_entries.back().first);
+        m_entries.pop_back();
+    }
+    m_entries.emplace_front(primary_key, std::move(row));
+    m_index[primary_key] = m_entries.begin();
+    return &m_entries.front().second;
+}
+
+void RowCache::Erase(const std::string& primary_key)
+{
+    const auto it = m_index.find(primary_key);
+    if (it == m_index.end())
+    {
+        return;
+    }
+    m_entries.erase(it->second);
+    m_index.erase(it);
+}
+
+void RowCache::Clear()
+{
+    m_entries.clear();
+    m_index.clear();
+}
+
+size_t RowCache::Size() const
+{
+    return m_entries.size();
+}
+
+size_t RowCache::Capacity() const
+{
+    return m_capacity;
+}
@@ -0,0 +1,38 @@
+#ifndef FOODB_ROW_CACHE_H_
+#define FOODB_ROW_CACHE_H_
+
+#include <cstddef>
+#include <list>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "catalog/row.h"
+
+//! @brief LRU cache of decoded rows keyed by primary key
+class RowCache
+{
+public:
+    explicit RowCache(size_t capacity);
+
+    std::optional<Row> Get(const std::string& primary_key);
+    //! @brief the cached row without copying it, valid until the next Put, Erase or Clear
+    const Row* Find(const std::string& primary_key);
+    //! @brief cache row and return the cached copy, nullptr when caching is disabled
+    const Row* Put(const std::string& primary_key, Row row);
+    void Erase(const std::string& primary_key);
+    void Clear();
+    size_t Size() const;
+    size_t Capacity() const;
+
+private:
+    using Entry = std::pair<std::string, Row>;
+
+    size_t m_capacity;
+    //! most recently used at the front
+    std::list<Entry> m_entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+};
+
+#endif
@@ -4,58 +4,115 @@
 #include <string>
 #include <utility>
 
-Schema::Schema(std::vector<Column> columns)
-    : m_columns(std::move(columns))
+namespace
+{
+constexpr uint64_t kFnvOffsetBasis = 0xCBF29CE484222325ULL;
+constexpr uint64_t kFnvPrime = 0x100000001B3ULL;
+
+void HashBytes(uint64_t& hash, const void* data, size_t size)
 {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * kFnvPrime;
+    }
 }
 
-const std::vector<Column>& Schema::Columns() const
+template <typename T>
+void HashValue(uint64_t& hash, T value)
 {
-    return m_columns;
+    HashBytes(hash, &value, sizeof(value));
 }
+}  // namespace
 
-const Column* Schema::PrimaryKey() const
+Schema::Schema()
+    : Schema(std::vector<Column>())
 {
-    for (const Column& column : m_columns)
+}
+
+Schema::Schema(std::vector<Column> columns)
+    : m_columns(std::move(columns))
+    , m_fingerprint(kFnvOffsetBasis)
+{
+    m_ordinals.reserve(m_columns.size());
+    m_slots.reserve(m_columns.size());
+    for (size_t ordinal = 0; ordinal < m_columns.size(); ++ordinal)
     {
+        const Column& column = m_columns[ordinal];
+        m_ordinals.emplace(column.m_name, ordinal);
         if (column.m_primary_key)
         {
-            return &column;
+            if (!m_primary_key)
+            {
+                m_primary_key = ordinal;
+            }
+            m_primary_keys.push_back(ordinal);
+        }
+
+        // the name length keeps ("ab", "c") and ("a", "bc") apart
+        HashValue(m_fingerprint, static_cast<uint64_t>(column.m_name.size()));
+        HashBytes(m_fingerprint, column.m_name.data(), column.m_name.size());
+        HashValue(m_fingerprint, column.m_type);
+        HashValue(m_fingerprint, static_cast<uint64_t>(column.m_size));
+        HashValue(m_fingerprint, column.m_nullable);
+        HashValue(m_fingerprint, column.m_primary_key);
+
+        if (column.m_type == ColumnType::kInt64)
+        {
+            m_slots.push_back(m_fixed_size);
+            m_fixed_size += sizeof(int64_t);
+        }
+        else
+        {
+            m_slots.push_back(m_variable_count++);
         }
     }
-    return nullptr;
+}
+
+const std::vector<Column>& Schema::Columns() const
+{
+    return m_columns;
+}
+
+const Column* Schema::PrimaryKey() const
+{
+    return m_primary_key ? &m_columns[*m_primary_key] : nullptr;
+}
+
+std::optional<size_t> Schema::PrimaryKeyOrdinal() const
+{
+    return m_primary_key;
+}
+
+const std::vector<size_t>& Schema::PrimaryKeyOrdinals() const
+{
+    return m_primary_keys;
 }
 
 const Column* Schema::FindColumn(const std::string& name) const
 {
-    for (const Column& column : m_columns)
+    const std::optional<size_t> ordinal = Ordinal(name);
+    return ordinal ? &m_columns[*ordinal] : nullptr;
+}
+
+std::optional<size_t> Schema::Ordinal(const std::string& name) const
+{
+    const auto it = m_ordinals.find(name);
+    if (it == m_ordinals.end())
     {
-        if (column.m_name == name)
-        {
-            return &column;
-        }
+        return std::nullopt;
     }
-    return nullptr;
+    return it->second;
 }
 
 bool Schema::Matches(const Schema& other) const
 {
-    if (m_columns.size() != other.m_columns.size())
-    {
-        return false;
-    }
+    return m_fingerprint == other.m_fingerprint && m_columns.size() == other.m_columns.size();
+}
 
-    for (size_t i = 0; i < m_columns.size(); ++i)
-    {
-        const Column& lhs = m_columns[i];
-        const Column& rhs = other.m_columns[i];
-        if (lhs.m_name != rhs.m_name || lhs.m_type != rhs.m_type || lhs.m_size != rhs.m_size ||
-            lhs.m_nullable != rhs.m_nullable || lhs.m_primary_key != rhs.m_primary_key)
-        {
-            return false;
-        }
-    }
-    return true;
+uint64_t Schema::Fingerprint() const
+{
+    return m_fingerprint;
 }
 
 size_t Schema::Size() const
@@ -67,3 +124,19 @@ bool Schema::Empty() const
 {
     return m_columns.empty();
 }
+
+size_t Schema::Slot(size_t ordinal) const
+{
+    assert(ordinal < m_slots.size() && "Slot: ordinal out of range.");
+    return m_slots[ordinal];
+}
+
+size_t Schema::FixedSize() const
+{
+    return m_fixed_size;
+}
+
+size_t Schema::VariableCount() const
+{
+    return m_variable_count;
+}
@@ -3,7 +3,9 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 enum class ColumnType : uint8_t
@@ -25,18 +27,41 @@ struct Column
 class Schema
 {
 public:
-    Schema() = default;
+    Schema();
     explicit Schema(std::vector<Column> columns);
 
     const std::vector<Column>& Columns() const;
+    //! @brief the first primary key column
     const Column* PrimaryKey() const;
+    std::optional<size_t> PrimaryKeyOrdinal() const;
+    //! @brief every primary key column in column order, the columns of a composite key
+    const std::vector<size_t>& PrimaryKeyOrdinals() const;
     const Column* FindColumn(const std::string& name) const;
+    //! @brief hashed lookup; with duplicate names the first column wins
+    std::optional<size_t> Ordinal(const std::string& name) const;
+    //! @brief compares fingerprints, so it costs the same for 2 columns as for 200
     bool Matches(const Schema& other) const;
+    //! @brief hash of every column definition in order, equal for identical schemas
+    uint64_t Fingerprint() const;
     size_t Size() const;
     bool Empty() const;
 
+    //! @brief where a column lives in an encoded row: the byte offset of an int64 column
+    //! inside the fixed-width section, or the index of a variable-length column in the offset table
+    size_t Slot(size_t ordinal) const;
+    //! @brief bytes taken by the fixed-width section of an encoded row
+    size_t FixedSize() const;
+    size_t VariableCount() const;
+
 private:
     std::vector<Column> m_columns;
+    std::unordered_map<std::string, size_t> m_ordinals;
+    std::optional<size_t> m_primary_key;
+    std::vector<size_t> m_primary_keys;
+    uint64_t m_fingerprint;
+    std::vector<size_t> m_slots;
+    size_t m_fixed_size { 0 };
+    size_t m_variable_count { 0 };
 };
 
 #endif
@@ -1,58 +1,263 @@
 #include "catalog/table.h"
 
-#include <array>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <cstring>
-#include <fstream>
-#include <vector>
+#include <deque>
+#include <filesystem>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
 #include <utility>
 
 namespace
 {
 constexpr uint32_t kTableMagic = 0x54424C31;  // TBL1
-constexpr uint32_t kTableVersion = 1;
+constexpr uint32_t kTableVersion = 2;
+//! compaction waits until at least this much of the data file is dead
+constexpr uint64_t kCompactionMinDeadBytes = 1 << 20;
+//! the log is checkpointed once it grows past this
+constexpr uint64_t kCheckpointLogBytes = 16 << 20;
+constexpr uint32_t kHeapFileId = 1;
+constexpr uint32_t kPrimaryIndexFileId = 2;
+//! the secondary index on the column of ordinal i logs as this plus i
+constexpr uint32_t kFirstSecondaryIndexFileId = 3;
+//! memory for cached index pages, whatever their size
+constexpr size_t kIndexCacheBytes = 4 << 20;
+//! a parallel scan splits the primary index into at least this many morsels per worker, so
+//! workers that finish early find some to steal
+constexpr size_t kMorselsPerWorker = 16;
+//! rows a parallel scan worker keeps before handing them to the consumer
+constexpr size_t kScanBufferRows = 1024;
+
+void WriteUint32(std::vector<uint8_t>& buffer, uint32_t value)
+{
+    const size_t offset = buffer.size();
+    buffer.resize(offset + sizeof(value));
+    std::memcpy(buffer.data() + offset, &value, sizeof(value));
+}
+
+void WriteUint64(std::vector<uint8_t>& buffer, uint64_t value)
+{
+    const size_t offset = buffer.size();
+    buffer.resize(offset + sizeof(value));
+    std::memcpy(buffer.data() + offset, &value, sizeof(value));
+}
 
-void WriteUint32(std::ostream& out, uint32_t value)
+std::string EncodeLocator(uint64_t locator)
 {
-    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    return std::string(reinterpret_cast<const char*>(&locator), sizeof(locator));
 }
 
-void WriteUint64(std::ostream& out, uint64_t value)
+uint64_t DecodeLocator(std::string_view value)
 {
-    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    uint64_t locator = 0;
+    std::memcpy(&locator, value.data(), std::min(value.size(), sizeof(locator)));
+    return locator;
+}
+
+BPTreeOptions MakeIndexOptions(Wal* wal, uint32_t file_id, const Schema& schema, const std::vector<size_t>& key_columns, size_t value_width, const TableOptions& options)
+{
+    BPTreeOptions index_options;
+    index_options.m_frame_budget = std::max<size_t>(16, kIndexCacheBytes / options.m_index_page_size);
+    index_options.m_wal = wal;
+    index_options.m_wal_file_id = file_id;
+    index_options.m_page_size = options.m_index_page_size;
+    // index keys are key_columns encoded by KeyEncoder; the key width is only known when every
+    // key column has a size
+    std::optional<size_t> key_width = 0;
+    for (size_t i = 0; i < key_columns.size() && key_width; ++i)
+    {
+        const Column& column = schema.Columns()[key_columns[i]];
+        if (column.m_type == ColumnType::kInt64)
+        {
+            *key_width += sizeof(int64_t);
+        }
+        else if (column.m_size == 0)
+        {
+            key_width.reset();
+        }
+        else
+        {
+            // a string or bytes value followed by another one is terminated
+            *key_width += column.m_size + (i + 1 < key_columns.size() ? 2 : 0);
+        }
+    }
+    if (key_width && *key_width != 0)
+    {
+        index_options.m_key_width = *key_width;
+    }
+    index_options.m_value_width = value_width;
+    return index_options;
 }
 
-uint32_t ReadUint32(std::istream& in)
+//! @brief add the value of ordinal in row to key, false if it is NULL
+bool AddKeyValue(KeyEncoder& key, const RowView& row, ColumnType type, size_t ordinal)
 {
-    uint32_t value = 0;
-    in.read(reinterpret_cast<char*>(&value), sizeof(value));
-    return value;
+    if (type == ColumnType::kInt64)
+    {
+        const std::optional<int64_t> value = row.GetInt64(ordinal);
+        if (value)
+        {
+            key.AddInt64(*value);
+        }
+        return value.has_value();
+    }
+    else if (type == ColumnType::kString)
+    {
+        const std::optional<std::string_view> value = row.GetString(ordinal);
+        if (value)
+        {
+            key.AddString(*value);
+        }
+        return value.has_value();
+    }
+    const std::optional<ByteSpan> value = row.GetBytes(ordinal);
+    if (value)
+    {
+        key.AddBytes(value->m_data, value->m_size);
+    }
+    return value.has_value();
 }
 
-uint64_t ReadUint64(std::istream& in)
+//! @brief the primary key that ends a secondary index key over a column of type
+std::string_view IndexedPrimaryKey(ColumnType type, std::string_view key)
 {
-    uint64_t value = 0;
-    in.read(reinterpret_cast<char*>(&value), sizeof(value));
-    return value;
+    if (type == ColumnType::kInt64)
+    {
+        return key.substr(sizeof(int64_t));
+    }
+    // skip the escaped value up to its 0x00 0x01 terminator
+    size_t pos = 0;
+    while (pos + 1 < key.size() && !(key[pos] == '\0' && key[pos + 1] == '\x01'))
+    {
+        pos += key[pos] == '\0' ? 2 : 1;
+    }
+    return key.substr(std::min(pos + 2, key.size()));
 }
+
+//! @brief the smallest secondary index key whose value sorts at or after bound, a single-column
+//! key of the indexed column; nullopt if every value sorts before bound
+std::optional<std::string> IndexBound(ColumnType type, const std::string& bound)
+{
+    if (bound.empty())
+    {
+        return std::string();
+    }
+    if (type != ColumnType::kInt64)
+    {
+        // the value is followed by the primary key, so it is escaped and terminated; a trailing
+        // empty value is what closes it
+        KeyEncoder key;
+        key.AddString(bound).AddString(std::string_view());
+        return key.Finish();
+    }
+
+    // values are 8 bytes: a shorter bound is reached by padding it with zeros, and a longer one,
+    // such as a key with '\0' appended to step past it, by the next value after its first 8 bytes
+    std::string value = bound.substr(0, sizeof(int64_t));
+    value.resize(sizeof(int64_t), '\0');
+    if (bound.size() <= sizeof(int64_t))
+    {
+        return value;
+    }
+    for (size_t i = value.size(); i-- > 0;)
+    {
+        value[i] = static_cast<char>(static_cast<uint8_t>(value[i]) + 1);
+        if (value[i] != '\0')
+        {
+            return value;
+        }
+    }
+    return std::nullopt;
+}
+
+//! @brief morsel numbers queued per worker
+//!
+//! Each worker starts with a contiguous block, so it scans neighbouring leaves, takes from the
+//! front of its own queue and, once that is empty, steals from the back of another's.
+class MorselQueues
+{
+public:
+    MorselQueues(size_t workers, size_t morsels)
+        : m_queues(workers)
+    {
+        for (size_t morsel = 0; morsel < morsels; ++morsel)
+        {
+            m_queues[morsel * workers / morsels].m_morsels.push_back(morsel);
+        }
+    }
+
+    std::optional<size_t> Next(size_t worker)
+    {
+        for (size_t i = 0; i < m_queues.size(); ++i)
+        {
+            Queue& queue = m_queues[(worker + i) % m_queues.size()];
+            std::lock_guard<std::mutex> lock(queue.m_mutex);
+            if (queue.m_morsels.empty())
+            {
+                continue;
+            }
+            size_t morsel = 0;
+            if (i == 0)
+            {
+                morsel = queue.m_morsels.front();
+                queue.m_morsels.pop_front();
+            }
+            else
+            {
+                morsel = queue.m_morsels.back();
+                queue.m_morsels.pop_back();
+            }
+            return morsel;
+        }
+        return std::nullopt;
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex m_mutex;
+        std::deque<size_t> m_morsels;
+    };
+
+    std::vector<Queue> m_queues;
+};
+
+//! @brief rows one worker kept, copied back to back until the consumer takes them
+struct ScanBuffer
+{
+    std::vector<uint8_t> m_arena;
+    std::vector<size_t> m_offsets;
+    std::vector<RowView> m_views;
+};
 }  // namespace
 
-Table::Table(std::string name, Schema schema)
+Table::Table(std::string name, Schema schema, TableOptions options)
     : m_name(std::move(name))
-    , m_data_file(MakeDataFileName(m_name))
-    , m_schema(std::move(schema))
-    , m_primary_index(MakeIndexFileName(m_name), 64)
+    , m_schema(std::make_shared<const Schema>(std::move(schema)))
+    , m_options(options)
+    , m_wal(MakeLogFileName(m_name))
+    , m_heap(MakeDataFileName(m_name), &m_wal, kHeapFileId)
+    , m_primary_index(MakeIndexFileName(m_name), 0, MakeIndexOptions(&m_wal, kPrimaryIndexFileId, *m_schema, m_schema->PrimaryKeyOrdinals(), sizeof(uint64_t), options))
+    , m_row_cache(options.m_row_cache_size)
 {
-    if (!m_schema.PrimaryKey())
+    if (!m_schema->PrimaryKey())
     {
         throw std::invalid_argument("table schema requires a primary key");
     }
-    if (!LoadRows())
+    if (!Open())
     {
         throw std::runtime_error("failed to load table data");
     }
 }
 
+Table::~Table()
+{
+    Checkpoint();
+}
+
 const std::string& Table::Name() const
 {
     return m_name;
@@ -60,169 +265,577 @@ const std::string& Table::Name() const
 
 const Schema& Table::GetSchema() const
 {
-    return m_schema;
+    return *m_schema;
 }
 
 bool Table::Insert(Row row)
 {
-    if (!row.MatchesSchema(m_schema))
+    if (!row.MatchesSchema(*m_schema))
     {
         return false;
     }
 
+    // a key an index would refuse must be caught before the row reaches the data file and the
+    // entries of the row it replaces are erased
     const std::optional<std::string> primary_key = GetPrimaryKeyValue(row);
-    if (!primary_key)
+    if (!primary_key || primary_key->size() > m_primary_index.MaxKeySize() || !IndexKeysFit(*primary_key, row))
     {
         return false;
     }
 
-    const char* empty_value = "";
-    if (!m_primary_index.Insert(*primary_key, empty_value, 0))
+    const std::optional<uint64_t> previous = FindLocator(*primary_key);
+    // the secondary index entries of the row being replaced have to go
+    const std::optional<Row> replaced = previous && !m_indexes.empty() ? ReadRow(*previous) : std::nullopt;
+    if (previous && !m_indexes.empty() && !replaced)
+    {
+        return false;
+    }
+    const std::optional<uint64_t> locator = m_heap.Append(HeapFile::RecordKind::kRow, row.Serialize());
+    if (!locator || (previous && !m_heap.MarkDead(*previous)) || !UpdateIndexes(*primary_key, replaced ? &*replaced : nullptr, &row))
     {
         return false;
     }
 
-    m_rows[*primary_key] = std::move(row);
-    return FlushRows();
+    // the index update commits the log, covering the data file records and secondary index
+    // pages written before it
+    const std::string value = EncodeLocator(*locator);
+    if (!m_primary_index.Insert(*primary_key, value.data(), value.size()))
+    {
+        return false;
+    }
+
+    m_row_cache.Put(*primary_key, std::move(row));
+    return MaybeCheckpoint() && MaybeCompact();
+}
+
+bool Table::Delete(const std::string& primary_key)
+{
+    const std::optional<uint64_t> previous = FindLocator(primary_key);
+    if (!previous)
+    {
+        return false;
+    }
+    const std::optional<Row> deleted = !m_indexes.empty() ? ReadRow(*previous) : std::nullopt;
+    if (!m_indexes.empty() && !deleted)
+    {
+        return false;
+    }
+
+    // the tombstone only matters to a rebuild from the data file, so it is dead on arrival
+    const std::optional<uint64_t> tombstone = m_heap.Append(HeapFile::RecordKind::kTombstone, std::vector<uint8_t>(primary_key.begin(), primary_key.end()));
+    if (!tombstone || !m_heap.MarkDead(*previous) || !m_heap.MarkDead(*tombstone) || !UpdateIndexes(primary_key, deleted ? &*deleted : nullptr, nullptr) ||
+        !m_primary_index.Erase(primary_key))
+    {
+        return false;
+    }
+
+    m_row_cache.Erase(primary_key);
+    return MaybeCheckpoint() && MaybeCompact();
 }
 
 std::optional<Row> Table::GetRow(const std::string& primary_key) const
 {
-    const std::optional<Data> indexed = m_primary_index.Search(primary_key);
-    if (!indexed)
+    if (std::optional<Row> cached = m_row_cache.Get(primary_key))
     {
-        return std::nullopt;
+        return cached;
     }
 
-    const auto it = m_rows.find(primary_key);
-    if (it == m_rows.end())
+    const std::optional<uint64_t> locator = FindLocator(primary_key);
+    if (!locator)
     {
         return std::nullopt;
     }
-    return it->second;
+
+    std::optional<Row> row = ReadRow(*locator);
+    if (row)
+    {
+        m_row_cache.Put(primary_key, *row);
+    }
+    return row;
 }
 
-size_t Table::Size() const
+RowView Table::GetRowView(const std::string& primary_key) const
+{
+    if (const Row* cached = m_row_cache.Find(primary_key))
+    {
+        return cached->View();
+    }
+
+    const std::optional<uint64_t> locator = FindLocator(primary_key);
+    std::optional<Row> row = locator ? ReadRow(*locator) : std::nullopt;
+    if (!row)
+    {
+        return RowView();
+    }
+    if (m_row_cache.Capacity() > 0)
+    {
+        return m_row_cache.Put(primary_key, std::move(*row))->View();
+    }
+    m_view_row = std::move(*row);
+    return m_view_row.View();
+}
+
+void Table::ScanRange(const std::string& start, const std::string& end, const std::function<bool(const Row&)>& visitor) const
 {
-    return m_rows.size();
+    m_primary_index.Scan(start, end, [&](std::string_view key, std::string_view value) {
+        (void) key;
+        // scans read around the row cache so they do not flush out the hot set
+        const std::optional<Row> row = ReadRow(DecodeLocator(value));
+        return !row || visitor(*row);
+    });
 }
 
-bool Table::LoadRows()
+bool Table::ParallelScan(const std::function<bool(const RowView&)>& predicate, const RowBatchConsumer& consumer, size_t threads) const
 {
-    std::ifstream in(m_data_file, std::ios::binary);
-    if (!in.good())
+    const size_t workers = std::max<size_t>(1, threads != 0 ? threads : std::thread::hardware_concurrency());
+    // morsel i is the key range [bounds[i], bounds[i + 1]), where the last empty bound is unbounded
+    std::vector<std::string> bounds = m_primary_index.SplitKeys(workers * kMorselsPerWorker);
+    bounds.insert(bounds.begin(), std::string());
+    bounds.emplace_back();
+    MorselQueues queues(workers, bounds.size() - 1);
+    std::atomic<bool> stop { false };
+    std::atomic<bool> failed { false };
+
+    const auto work = [&](size_t worker) {
+        ScanBuffer buffer;
+        const auto flush = [&]() {
+            buffer.m_views.clear();
+            for (size_t i = 0; i < buffer.m_offsets.size(); ++i)
+            {
+                const size_t end = i + 1 < buffer.m_offsets.size() ? buffer.m_offsets[i + 1] : buffer.m_arena.size();
+                buffer.m_views.emplace_back(m_schema.get(), buffer.m_arena.data() + buffer.m_offsets[i], end - buffer.m_offsets[i]);
+            }
+            if (!consumer(worker, buffer.m_views))
+            {
+                stop = true;
+            }
+            buffer.m_arena.clear();
+            buffer.m_offsets.clear();
+        };
+
+        std::vector<uint8_t> payload;
+        std::optional<size_t> morsel;
+        while (!stop && (morsel = queues.Next(worker)))
+        {
+            m_primary_index.Scan(bounds[*morsel], bounds[*morsel + 1], [&](std::string_view key, std::string_view value) {
+                (void) key;
+                if (!m_heap.Read(DecodeLocator(value), payload))
+                {
+                    failed = true;
+                    stop = true;
+                    return false;
+                }
+                // current rows are viewed where they were read, older formats are converted
+                std::optional<Row> converted;
+                RowView row(m_schema.get(), payload.data(), payload.size());
+                if (!RowView::Validate(*m_schema, payload.data(), payload.size()))
+                {
+                    converted = Row::Deserialize(payload, m_schema);
+                    if (!converted)
+                    {
+                        failed = true;
+                        stop = true;
+                        return false;
+                    }
+                    row = converted->View();
+                }
+                if (!predicate || predicate(row))
+                {
+                    buffer.m_offsets.push_back(buffer.m_arena.size());
+                    buffer.m_arena.insert(buffer.m_arena.end(), row.Data(), row.Data() + row.Size());
+                    if (buffer.m_offsets.size() == kScanBufferRows)
+                    {
+                        flush();
+                    }
+                }
+                return !stop;
+            });
+        }
+        if (!stop && !buffer.m_offsets.empty())
+        {
+            flush();
+        }
+    };
+
+    // the calling thread is worker 0
+    std::vector<std::thread> pool;
+    for (size_t worker = 1; worker < workers; ++worker)
     {
-        return true;
+        pool.emplace_back(work, worker);
+    }
+    work(0);
+    for (std::thread& thread : pool)
+    {
+        thread.join();
     }
+    return !failed;
+}
+
+size_t Table::Size() const
+{
+    return static_cast<size_t>(m_heap.LiveRecords());
+}
 
-    const uint32_t magic = ReadUint32(in);
-    const uint32_t version = ReadUint32(in);
-    const uint32_t column_count = ReadUint32(in);
-    if (!in.good() || magic != kTableMagic || version != kTableVersion || column_count != m_schema.Size())
+bool Table::Compact()
+{
+    // the rebuilt index bypasses the log, so nothing may be left in it to replay over the new pages
+    if (!Checkpoint())
     {
         return false;
     }
 
-    for (uint32_t i = 0; i < column_count; ++i)
+    const std::string compact_file = m_heap.FileName() + ".compact";
+    std::filesystem::remove(compact_file);
+
+    std::vector<BPTree::Record> index_records;
+    index_records.reserve(Size());
     {
-        const uint32_t name_size = ReadUint32(in);
-        std::string name(name_size, '\0');
-        in.read(name.data(), static_cast<std::streamsize>(name_size));
-        const uint32_t type = ReadUint32(in);
-        const uint64_t size = ReadUint64(in);
-        const uint32_t nullable = ReadUint32(in);
-        const uint32_t primary_key = ReadUint32(in);
-        (void) type;
-        (void) size;
-        (void) nullable;
-        (void) primary_key;
-        if (!in.good())
+        HeapFile compacted(compact_file);
+        if (!compacted.Open(m_heap.Header()))
+        {
+            return false;
+        }
+
+        // copy live rows in primary-key order so the rebuilt index is a sequential bulk load
+        std::vector<uint8_t> payload;
+        for (BPTree::Cursor cursor = m_primary_index.Begin(); cursor.Valid(); cursor.Next())
+        {
+            if (!m_heap.Read(DecodeLocator(cursor.Value()), payload))
+            {
+                return false;
+            }
+            const std::optional<uint64_t> locator = compacted.Append(HeapFile::RecordKind::kRow, payload);
+            if (!locator)
+            {
+                return false;
+            }
+            index_records.emplace_back(std::string(cursor.Key()), EncodeLocator(*locator));
+        }
+        if (!compacted.Sync())
         {
             return false;
         }
     }
 
-    const uint64_t row_count = ReadUint64(in);
-    for (uint64_t i = 0; i < row_count; ++i)
+    // from the rename until the bulk load is synced the index does not match the data file;
+    // the marker makes the next open rebuild it if we crash in between
+    File marker;
+    if (!marker.Open(MakeRebuildMarkerName(m_name), true) || !marker.Sync())
     {
-        const uint64_t payload_size = ReadUint64(in);
-        std::vector<uint8_t> payload(static_cast<size_t>(payload_size));
-        in.read(reinterpret_cast<char*>(payload.data()), static_cast<std::streamsize>(payload_size));
-        if (!in.good())
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(compact_file, m_heap.FileName(), error);
+    if (error || !m_heap.Open(EncodeHeader()) || !m_primary_index.BulkLoad(std::move(index_records)))
+    {
+        return false;
+    }
+    return std::filesystem::remove(MakeRebuildMarkerName(m_name), error);
+}
+
+bool Table::Checkpoint()
+{
+    for (const auto& [ordinal, index] : m_indexes)
+    {
+        (void) ordinal;
+        if (!index->Checkpoint())
         {
             return false;
         }
+    }
+    return m_primary_index.Checkpoint() && m_heap.Sync() && m_wal.Truncate();
+}
+
+bool Table::CreateIndex(const std::string& column)
+{
+    const std::optional<size_t> ordinal = m_schema->Ordinal(column);
+    if (!ordinal)
+    {
+        return false;
+    }
+    if (HasIndex(*ordinal))
+    {
+        return true;
+    }
+
+    // the bulk load bypasses the log, so nothing may be left in it to replay over the new pages;
+    // the marker makes the next open finish the build if we crash before it is synced
+    File marker;
+    if (!Checkpoint() || !marker.Open(MakeRebuildMarkerName(m_name, *ordinal), true) || !marker.Sync())
+    {
+        return false;
+    }
+    const std::vector<size_t> key_columns = { *ordinal };
+    m_indexes.emplace(*ordinal, std::make_unique<BPTree>(MakeIndexFileName(m_name, *ordinal), 0,
+                                                         MakeIndexOptions(&m_wal, kFirstSecondaryIndexFileId + static_cast<uint32_t>(*ordinal), *m_schema, key_columns, 0, m_options)));
+    if (!BuildIndex(*ordinal))
+    {
+        // queries must not use a partial index. A build that fails without crashing, such as on a
+        // value too long to index, would fail the same way on every open, so the marker and the
+        // index file go too; only a crash leaves the marker for the next open to finish the build
+        m_indexes.erase(*ordinal);
+        std::error_code error;
+        std::filesystem::remove(MakeIndexFileName(m_name, *ordinal), error);
+        std::filesystem::remove(MakeRebuildMarkerName(m_name, *ordinal), error);
+        return false;
+    }
+    return true;
+}
+
+bool Table::HasIndex(size_t ordinal) const
+{
+    return m_indexes.count(ordinal) != 0;
+}
+
+void Table::ScanIndex(size_t ordinal, const std::string& start, const std::string& end, const std::function<bool(const Row&)>& visitor) const
+{
+    const auto index = m_indexes.find(ordinal);
+    assert(index != m_indexes.end() && "ScanIndex: the column is not indexed.");
+    const ColumnType type = m_schema->Columns()[ordinal].m_type;
+    const std::optional<std::string> index_start = IndexBound(type, start);
+    const std::optional<std::string> index_end = IndexBound(type, end);
+    if (!index_start)
+    {
+        return;
+    }
+
+    // an end past every value is unbounded, which the empty key already means
+    index->second->Scan(*index_start, index_end.value_or(std::string()), [&](std::string_view key, std::string_view value) {
+        (void) value;
+        const std::optional<uint64_t> locator = FindLocator(std::string(IndexedPrimaryKey(type, key)));
+        const std::optional<Row> row = locator ? ReadRow(*locator) : std::nullopt;
+        return !row || visitor(*row);
+    });
+}
+
+bool Table::Open()
+{
+    // replaying the log already happened as the data file and the indexes were opened
+    if (!m_wal.IsOpen() || !m_heap.Open(EncodeHeader()) || !HeaderMatches(m_heap.Header()) || !OpenIndexes() || !Checkpoint())
+    {
+        return false;
+    }
 
-        const std::optional<Row> row = Row::Deserialize(payload);
-        if (!row || !row->MatchesSchema(m_schema))
+    // rows are read on demand; only a missing or interrupted index forces a pass over the data file
+    const bool interrupted = std::filesystem::exists(MakeRebuildMarkerName(m_name));
+    if ((interrupted || (m_heap.LiveRecords() > 0 && !m_primary_index.Begin().Valid())) && !RebuildIndex())
+    {
+        return false;
+    }
+    // secondary indexes are built from the primary index, so they come after it
+    for (const auto& [ordinal, index] : m_indexes)
+    {
+        (void) index;
+        if (std::filesystem::exists(MakeRebuildMarkerName(m_name, ordinal)) && !BuildIndex(ordinal))
         {
             return false;
         }
+    }
+    return true;
+}
 
-        const std::optional<std::string> primary_key = GetPrimaryKeyValue(*row);
-        if (!primary_key)
+bool Table::OpenIndexes()
+{
+    for (size_t ordinal = 0; ordinal < m_schema->Size(); ++ordinal)
+    {
+        if (!std::filesystem::exists(MakeIndexFileName(m_name, ordinal)) && !std::filesystem::exists(MakeRebuildMarkerName(m_name, ordinal)))
+        {
+            continue;
+        }
+        const std::vector<size_t> key_columns = { ordinal };
+        m_indexes.emplace(ordinal, std::make_unique<BPTree>(MakeIndexFileName(m_name, ordinal), 0,
+                                                            MakeIndexOptions(&m_wal, kFirstSecondaryIndexFileId + static_cast<uint32_t>(ordinal), *m_schema, key_columns, 0, m_options)));
+    }
+    return true;
+}
+
+bool Table::BuildIndex(size_t ordinal)
+{
+    std::vector<BPTree::Record> index_records;
+    index_records.reserve(Size());
+    for (BPTree::Cursor cursor = m_primary_index.Begin(); cursor.Valid(); cursor.Next())
+    {
+        const std::optional<Row> row = ReadRow(DecodeLocator(cursor.Value()));
+        if (!row)
         {
             return false;
         }
+        std::optional<std::string> key = MakeIndexKey(ordinal, row->View(), std::string(cursor.Key()));
+        if (key)
+        {
+            index_records.emplace_back(std::move(*key), std::string());
+        }
+    }
+
+    std::error_code error;
+    return m_indexes.at(ordinal)->BulkLoad(std::move(index_records)) && std::filesystem::remove(MakeRebuildMarkerName(m_name, ordinal), error);
+}
 
-        m_rows[*primary_key] = *row;
-        const char* empty_value = "";
-        if (!m_primary_index.Insert(*primary_key, empty_value, 0))
+bool Table::UpdateIndexes(const std::string& primary_key, const Row* before, const Row* after)
+{
+    for (const auto& [ordinal, index] : m_indexes)
+    {
+        const std::optional<std::string> old_key = before ? MakeIndexKey(ordinal, before->View(), primary_key) : std::nullopt;
+        const std::optional<std::string> new_key = after ? MakeIndexKey(ordinal, after->View(), primary_key) : std::nullopt;
+        if (old_key == new_key)
+        {
+            continue;
+        }
+        index->BeginBatch();
+        const bool updated = (!old_key || index->Erase(*old_key)) && (!new_key || index->Insert(*new_key, "", 0));
+        if (!index->LogBatch() || !updated)
         {
             return false;
         }
     }
+    return true;
+}
 
+bool Table::IndexKeysFit(const std::string& primary_key, const Row& row) const
+{
+    for (const auto& [ordinal, index] : m_indexes)
+    {
+        const std::optional<std::string> key = MakeIndexKey(ordinal, row.View(), primary_key);
+        if (key && key->size() > index->MaxKeySize())
+        {
+            return false;
+        }
+    }
     return true;
 }
 
-bool Table::FlushRows() const
+std::optional<std::string> Table::MakeIndexKey(size_t ordinal, const RowView& row, const std::string& primary_key) const
 {
-    std::ofstream out(m_data_file, std::ios::binary | std::ios::trunc);
-    if (!out.good())
+    KeyEncoder key;
+    if (!AddKeyValue(key, row, m_schema->Columns()[ordinal].m_type, ordinal))
+    {
+        return std::nullopt;
+    }
+    key.AddBytes(reinterpret_cast<const uint8_t*>(primary_key.data()), primary_key.size());
+    return key.Finish();
+}
+
+bool Table::RebuildIndex()
+{
+    File marker;
+    if (!marker.Open(MakeRebuildMarkerName(m_name), true) || !marker.Sync())
     {
         return false;
     }
 
-    WriteUint32(out, kTableMagic);
-    WriteUint32(out, kTableVersion);
-    WriteUint32(out, static_cast<uint32_t>(m_schema.Size()));
-    for (const Column& column : m_schema.Columns())
+    bool valid = true;
+    std::unordered_map<std::string, uint64_t> locators;
+    const bool scanned = m_heap.Scan([&](uint64_t locator, HeapFile::RecordKind kind, const std::vector<uint8_t>& payload) {
+        if (kind == HeapFile::RecordKind::kTombstone)
+        {
+            locators.erase(std::string(payload.begin(), payload.end()));
+            return true;
+        }
+
+        const std::optional<Row> row = Row::Deserialize(payload, m_schema);
+        const std::optional<std::string> primary_key = row ? GetPrimaryKeyValue(*row) : std::nullopt;
+        if (!primary_key)
+        {
+            valid = false;
+            return false;
+        }
+        locators[*primary_key] = locator;
+        return true;
+    });
+    if (!scanned || !valid)
     {
-        WriteUint32(out, static_cast<uint32_t>(column.m_name.size()));
-        out.write(column.m_name.data(), static_cast<std::streamsize>(column.m_name.size()));
-        WriteUint32(out, static_cast<uint32_t>(column.m_type));
-        WriteUint64(out, static_cast<uint64_t>(column.m_size));
-        WriteUint32(out, column.m_nullable ? 1U : 0U);
-        WriteUint32(out, column.m_primary_key ? 1U : 0U);
+        return false;
     }
 
-    WriteUint64(out, static_cast<uint64_t>(m_rows.size()));
-    for (const auto& [key, row] : m_rows)
+    std::vector<BPTree::Record> index_records;
+    index_records.reserve(locators.size());
+    for (const auto& [primary_key, locator] : locators)
     {
-        (void) key;
-        const std::vector<uint8_t> payload = row.Serialize();
-        WriteUint64(out, static_cast<uint64_t>(payload.size()));
-        out.write(reinterpret_cast<const char*>(payload.data()), static_cast<std::streamsize>(payload.size()));
+        index_records.emplace_back(primary_key, EncodeLocator(locator));
     }
 
-    return out.good();
+    std::error_code error;
+    return m_primary_index.BulkLoad(std::move(index_records)) && std::filesystem::remove(MakeRebuildMarkerName(m_name), error);
 }
 
-std::optional<std::string> Table::GetPrimaryKeyValue(const Row& row) const
+bool Table::MaybeCheckpoint()
+{
+    return m_wal.Size() < kCheckpointLogBytes || Checkpoint();
+}
+
+bool Table::MaybeCompact()
+{
+    const uint64_t dead_bytes = m_heap.DeadBytes();
+    if (dead_bytes < kCompactionMinDeadBytes || dead_bytes * 2 < m_heap.RecordBytes())
+    {
+        return true;
+    }
+    return Compact();
+}
+
+std::optional<Row> Table::ReadRow(uint64_t locator) const
+{
+    std::vector<uint8_t> payload;
+    if (!m_heap.Read(locator, payload))
+    {
+        return std::nullopt;
+    }
+
+    return Row::Deserialize(payload, m_schema);
+}
+
+std::optional<uint64_t> Table::FindLocator(const std::string& primary_key) const
 {
-    const Column* pk = m_schema.PrimaryKey();
-    if (!pk)
+    const BPTree::Handle indexed = m_primary_index.Get(primary_key);
+    if (!indexed)
     {
         return std::nullopt;
     }
+    return DecodeLocator(indexed.Value());
+}
 
-    const std::optional<std::string> value = row.GetString(pk->m_name);
-    if (!value || value->empty())
+std::vector<uint8_t> Table::EncodeHeader() const
+{
+    std::vector<uint8_t> header;
+    WriteUint32(header, kTableMagic);
+    WriteUint32(header, kTableVersion);
+    WriteUint32(header, static_cast<uint32_t>(m_schema->Size()));
+    for (const Column& column : m_schema->Columns())
+    {
+        WriteUint32(header, static_cast<uint32_t>(column.m_name.size()));
+        header.insert(header.end(), column.m_name.begin(), column.m_name.end());
+        WriteUint32(header, static_cast<uint32_t>(column.m_type));
+        WriteUint64(header, static_cast<uint64_t>(column.m_size));
+        WriteUint32(header, column.m_nullable ? 1U : 0U);
+        WriteUint32(header, column.m_primary_key ? 1U : 0U);
+    }
+    return header;
+}
+
+bool Table::HeaderMatches(const std::vector<uint8_t>& header) const
+{
+    return header == EncodeHeader();
+}
+
+std::optional<std::string> Table::GetPrimaryKeyValue(const Row& row) const
+{
+    const RowView view = row.View();
+    KeyEncoder key;
+    for (size_t ordinal : m_schema->PrimaryKeyOrdinals())
+    {
+        if (!AddKeyValue(key, view, m_schema->Columns()[ordinal].m_type, ordinal))
+        {
+            return std::nullopt;
+        }
+    }
+
+    std::string encoded = key.Finish();
+    if (encoded.empty())
     {
         return std::nullopt;
     }
-    return value;
+    return encoded;
 }
 
 std::string Table::MakeIndexFileName(const std::string& name) const
@@ -234,3 +847,23 @@ std::string Table::MakeDataFileName(const std::string& name) const
 {
     return name + ".tbl";
 }
+
+std::string Table::MakeLogFileName(const std::string& name) const
+{
+    return name + ".wal";
+}
+
+std::string Table::MakeRebuildMarkerName(const std::string& name) const
+{
+    return name + ".rebuild";
+}
+
+std::string Table::MakeIndexFileName(const std::string& name, size_t ordinal) const
+{
+    return name + "." + m_schema->Columns()[ordinal].m_name + ".idx";
+}
+
+std::string Table::MakeRebuildMarkerName(const std::string& name, size_t ordinal) const
+{
+    return name + "." + m_schema->Columns()[ordinal].m_name + ".rebuild";
+}
@@ -1,38 +1,138 @@
 #ifndef FOODB_TABLE_H_
 #define FOODB_TABLE_H_
 
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
 #include <optional>
-#include <fstream>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "catalog/key_encoder.h"
 #include "catalog/row.h"
+#include "catalog/row_cache.h"
 #include "store/bptree.h"
+#include "store/heap_file.h"
+#include "store/wal.h"
 
+struct TableOptions
+{
+    //! decoded rows kept in memory, rows are otherwise read from .tbl on demand
+    size_t m_row_cache_size { 4096 };
+    //! page size of a new .idx file, 4 KB to 64 KB; its fan-out follows from the page size and
+    //! the sizes of the key columns
+    uint32_t m_index_page_size { 4096 };
+};
+
+//! @brief receives the rows a parallel scan kept, one worker's buffer at a time
+//!
+//! worker is below the scan's thread count and calls for one worker never overlap, so state
+//! kept per worker needs no lock. The views are valid during the call; false stops the scan.
+using RowBatchConsumer = std::function<bool(size_t worker, const std::vector<RowView>& rows)>;
+
+//! @brief rows of one schema in a heap file, indexed by primary key
+//!
+//! Primary keys are passed around as index keys: the primary key columns of a row encoded
+//! with KeyEncoder, which for a single string column is the string itself.
+//!
+//! A secondary index on a column lives in <name>.<column>.idx; its keys are the column value
+//! followed by the primary key, so equal values do not collide, and it has no values. Rows
+//! are found through the primary index, so compaction leaves secondary indexes alone.
 class Table
 {
 public:
-    Table(std::string name, Schema schema);
+    Table(std::string name, Schema schema, TableOptions options = TableOptions());
+    ~Table();
 
     const std::string& Name() const;
     const Schema& GetSchema() const;
 
+    //! @brief insert row or replace the row with its primary key; false, leaving the table as it
+    //! was, if row does not match the schema or its primary or a secondary index key is too long
+    //! to index
     bool Insert(Row row);
+    bool Delete(const std::string& primary_key);
     std::optional<Row> GetRow(const std::string& primary_key) const;
+    //! @brief zero-copy access to a row, invalid if the key is missing
+    //!
+    //! A cached row is viewed in place without allocating. The view is valid until the next
+    //! call into the table.
+    RowView GetRowView(const std::string& primary_key) const;
+    //! @brief visit rows whose primary key is in [start, end) in key order, an empty end is unbounded
+    void ScanRange(const std::string& start, const std::string& end, const std::function<bool(const Row&)>& visitor) const;
+    //! @brief visit the rows for which predicate is true on threads threads, in no particular order
+    //!
+    //! The primary index is split into key ranges, morsels, queued per worker; a worker whose
+    //! queue runs dry steals from the others. Workers read rows around the row cache and buffer
+    //! the ones they keep for consumer. An empty predicate keeps every row, and threads 0 means
+    //! std::thread::hardware_concurrency(). Neither may modify the table. False if a row could
+    //! not be read.
+    bool ParallelScan(const std::function<bool(const RowView&)>& predicate, const RowBatchConsumer& consumer, size_t threads = 0) const;
     size_t Size() const;
+    //! @brief the index key of a row, nullopt if a primary key column is missing or the key is empty
+    std::optional<std::string> GetPrimaryKeyValue(const Row& row) const;
+    //! @brief rewrite the data file with live rows only and rebuild the index over it
+    bool Compact();
+    //! @brief write committed changes into .tbl and .idx and empty the log
+    bool Checkpoint();
+
+    //! @brief index column, bulk-built from the rows stored so far and reopened with the table
+    //!
+    //! Every later Insert and Delete updates the index in its own log commit. NULL values are not
+    //! indexed. True if the column was indexed already; false, leaving no index behind, if it does
+    //! not exist or the index could not be built, for example because a value is too long to index.
+    bool CreateIndex(const std::string& column);
+    bool HasIndex(size_t ordinal) const;
+    //! @brief visit rows whose value of an indexed column is in [start, end) in value order, then by
+    //! primary key; an empty end is unbounded
+    //!
+    //! Bounds are encoded like the index key of a table whose only key column is that column.
+    void ScanIndex(size_t ordinal, const std::string& start, const std::string& end, const std::function<bool(const Row&)>& visitor) const;
 
 private:
-    bool LoadRows();
-    bool FlushRows() const;
-    std::optional<std::string> GetPrimaryKeyValue(const Row& row) const;
+    bool Open();
+    bool RebuildIndex();
+    //! @brief open the secondary indexes that have a file or an interrupted build, before the log is truncated
+    bool OpenIndexes();
+    //! @brief bulk-load the secondary index on ordinal from the primary index, then drop its build marker
+    bool BuildIndex(size_t ordinal);
+    //! @brief move the secondary index entries of primary_key from before to after, either may be nullptr
+    //!
+    //! The index pages are only appended to the log; the primary index update that follows commits
+    //! them along with it.
+    bool UpdateIndexes(const std::string& primary_key, const Row* before, const Row* after);
+    //! @brief every secondary index key of row is short enough for its index
+    bool IndexKeysFit(const std::string& primary_key, const Row& row) const;
+    //! @brief the secondary index key of row, nullopt if its value of ordinal is NULL
+    std::optional<std::string> MakeIndexKey(size_t ordinal, const RowView& row, const std::string& primary_key) const;
+    bool MaybeCheckpoint();
+    bool MaybeCompact();
+    std::optional<Row> ReadRow(uint64_t locator) const;
+    std::optional<uint64_t> FindLocator(const std::string& primary_key) const;
+    std::vector<uint8_t> EncodeHeader() const;
+    bool HeaderMatches(const std::vector<uint8_t>& header) const;
     std::string MakeIndexFileName(const std::string& name) const;
     std::string MakeDataFileName(const std::string& name) const;
+    std::string MakeLogFileName(const std::string& name) const;
+    std::string MakeRebuildMarkerName(const std::string& name) const;
+    std::string MakeIndexFileName(const std::string& name, size_t ordinal) const;
+    std::string MakeRebuildMarkerName(const std::string& name, size_t ordinal) const;
 
     std::string m_name;
-    std::string m_data_file;
-    Schema m_schema;
+    //! shared with every row decoded from the data file
+    std::shared_ptr<const Schema> m_schema;
+    TableOptions m_options;
+    //! shared by the data file and the index, so a row change costs one log sync
+    Wal m_wal;
+    HeapFile m_heap;
     BPTree m_primary_index;
-    std::unordered_map<std::string, Row> m_rows;
+    //! secondary indexes by column ordinal, sharing m_wal
+    std::map<size_t, std::unique_ptr<BPTree>> m_indexes;
+    mutable RowCache m_row_cache;
+    //! backs the last view handed out while the row cache is disabled
+    mutable Row m_view_row;
 };
 
 #endif
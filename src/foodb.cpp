@@ -1,10 +1,59 @@
+#include <iostream>
+#include <string>
+
+#include <fmt/format.h>
+
 #include "catalog/table.h"
-#include "store/bptree.h"
+#include "sql/executor.h"
 
+namespace
+{
+std::string FormatValue(const std::optional<Value>& value)
+{
+    if (!value)
+    {
+        return "NULL";
+    }
+    if (const int64_t* integer = std::get_if<int64_t>(&*value))
+    {
+        return std::to_string(*integer);
+    }
+    return std::get<std::string>(*value);
+}
+}  // namespace
+
+//! reads one SELECT statement per line from stdin and prints its rows tab-separated
 int main()
 {
     Schema schema({ { "id", ColumnType::kString, 0, false, true }, { "name", ColumnType::kString, 0, true, false } });
     Table table("users", schema);
-    (void) table;
+    table.CreateIndex("name");
+    Executor executor;
+    executor.AddTable("users", table);
+
+    std::string line;
+    while (std::getline(std::cin, line))
+    {
+        if (line.find_first_not_of(" \t") == std::string::npos)
+        {
+            continue;
+        }
+        std::string error;
+        const std::optional<ResultSet> result = executor.Execute(line, error);
+        if (!result)
+        {
+            fmt::println("error: {}", error);
+            continue;
+        }
+        for (const std::vector<std::optional<Value>>& row : result->m_rows)
+        {
+            std::string text;
+            for (size_t i = 0; i < row.size(); ++i)
+            {
+                text += (i == 0 ? "" : "\t") + FormatValue(row[i]);
+            }
+            fmt::println("{}", text);
+        }
+    }
     return 0;
 }
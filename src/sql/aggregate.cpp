@@ -0,0 +1,438 @@
+#include "sql/aggregate.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <system_error>
+#include <tuple>
+#include <utility>
+
+#include <fmt/format.h>
+
+namespace
+{
+constexpr size_t kPartitionBits = 4;
+constexpr size_t kPartitions = size_t(1) << kPartitionBits;
+//! a table at this depth has used up every bit of the hash and keeps its groups in memory
+constexpr size_t kMaxSpillDepth = 64 / kPartitionBits;
+constexpr size_t kSpillBufferSize = 64 * 1024;
+constexpr size_t kReadChunkSize = 1024 * 1024;
+
+//! names spill files apart within a process
+std::atomic<uint64_t> g_spill_counter { 0 };
+
+//! @brief the order of MIN and MAX; an int64 column leaves m_text empty and any other column
+//! leaves m_integer 0, so comparing both fields orders either kind
+bool Less(const AggregateState& left, const AggregateState& right)
+{
+    return std::tie(left.m_integer, left.m_text) < std::tie(right.m_integer, right.m_text);
+}
+
+int64_t WrappingAdd(int64_t left, int64_t right)
+{
+    return static_cast<int64_t>(static_cast<uint64_t>(left) + static_cast<uint64_t>(right));
+}
+
+template <typename T>
+void Put(std::string& out, T value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool Get(std::string_view data, size_t& position, T& value)
+{
+    if (data.size() - position < sizeof(value))
+    {
+        return false;
+    }
+    std::memcpy(&value, data.data() + position, sizeof(value));
+    position += sizeof(value);
+    return true;
+}
+
+bool GetText(std::string_view data, size_t& position, std::string_view& text)
+{
+    uint32_t size = 0;
+    if (!Get(data, position, size) || data.size() - position < size)
+    {
+        return false;
+    }
+    text = data.substr(position, size);
+    position += size;
+    return true;
+}
+
+//! @brief append a group as [u32 key size][key] and per state [i64 count][i64 integer][u32 text size][text]
+void EncodeGroup(std::string& out, std::string_view key, const AggregateState* states, size_t width)
+{
+    Put(out, static_cast<uint32_t>(key.size()));
+    out.append(key);
+    for (size_t i = 0; i < width; ++i)
+    {
+        Put(out, states[i].m_count);
+        Put(out, states[i].m_integer);
+        Put(out, static_cast<uint32_t>(states[i].m_text.size()));
+        out.append(states[i].m_text);
+    }
+}
+
+//! @brief the group at position in data, false without advancing position if it is cut off
+bool DecodeGroup(std::string_view data, size_t& position, std::string_view& key, std::vector<AggregateState>& states)
+{
+    size_t end = position;
+    if (!GetText(data, end, key))
+    {
+        return false;
+    }
+    for (AggregateState& state : states)
+    {
+        std::string_view text;
+        if (!Get(data, end, state.m_count) || !Get(data, end, state.m_integer) || !GetText(data, end, text))
+        {
+            return false;
+        }
+        state.m_text.assign(text);
+    }
+    position = end;
+    return true;
+}
+}  // namespace
+
+void AccumulateInt64(AggregateFunction function, AggregateState& state, int64_t value)
+{
+    if (function == AggregateFunction::kSum)
+    {
+        state.m_integer = WrappingAdd(state.m_integer, value);
+    }
+    else if (function == AggregateFunction::kMin)
+    {
+        state.m_integer = state.m_count == 0 ? value : std::min(state.m_integer, value);
+    }
+    else if (function == AggregateFunction::kMax)
+    {
+        state.m_integer = state.m_count == 0 ? value : std::max(state.m_integer, value);
+    }
+    ++state.m_count;
+}
+
+int64_t AccumulateString(AggregateFunction function, AggregateState& state, std::string_view value)
+{
+    const size_t size = state.m_text.size();
+    // std::string compares bytes as unsigned chars, like the index keys
+    if ((function == AggregateFunction::kMin && (state.m_count == 0 || value < state.m_text)) ||
+        (function == AggregateFunction::kMax && (state.m_count == 0 || state.m_text < value)))
+    {
+        state.m_text.assign(value);
+    }
+    ++state.m_count;
+    return static_cast<int64_t>(state.m_text.size()) - static_cast<int64_t>(size);
+}
+
+int64_t MergeState(AggregateFunction function, AggregateState& state, const AggregateState& other)
+{
+    if (other.m_count == 0)
+    {
+        return 0;
+    }
+    const size_t size = state.m_text.size();
+    if (function == AggregateFunction::kSum)
+    {
+        state.m_integer = WrappingAdd(state.m_integer, other.m_integer);
+    }
+    else if ((function == AggregateFunction::kMin && (state.m_count == 0 || Less(other, state))) ||
+             (function == AggregateFunction::kMax && (state.m_count == 0 || Less(state, other))))
+    {
+        state.m_integer = other.m_integer;
+        state.m_text = other.m_text;
+    }
+    state.m_count += other.m_count;
+    return static_cast<int64_t>(state.m_text.size()) - static_cast<int64_t>(size);
+}
+
+GroupTable::GroupTable(std::vector<AggregateFunction> functions, size_t memory_budget, std::string spill_directory, size_t depth)
+    : m_functions(std::move(functions))
+    , m_memory_budget(memory_budget)
+    , m_spill_directory(std::move(spill_directory))
+    , m_depth(depth)
+    , m_width(std::max<size_t>(1, m_functions.size()))
+{
+}
+
+GroupTable::~GroupTable()
+{
+    RemoveRuns();
+}
+
+AggregateState* GroupTable::Group(std::string_view key)
+{
+    if ((m_keys.size() + 1) * 2 > m_slots.size())
+    {
+        Grow();
+    }
+    const uint64_t hash = std::hash<std::string_view>()(key);
+    const size_t mask = m_slots.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        Slot& slot = m_slots[i];
+        if (slot.m_group == 0)
+        {
+            const size_t bytes = key.size() + sizeof(std::string) + 2 * sizeof(Slot) + m_width * sizeof(AggregateState);
+            if (!m_keys.empty() && m_bytes + bytes > m_memory_budget && m_depth < kMaxSpillDepth)
+            {
+                // the table is empty after spilling, so the group is added on the second try
+                return Spill() ? Group(key) : nullptr;
+            }
+            slot.m_hash = hash;
+            slot.m_group = static_cast<uint32_t>(m_keys.size() + 1);
+            m_keys.emplace_back(key);
+            m_states.resize(m_states.size() + m_width);
+            m_bytes += bytes;
+            return &m_states[m_states.size() - m_width];
+        }
+        if (slot.m_hash == hash && m_keys[slot.m_group - 1] == key)
+        {
+            return &m_states[(slot.m_group - 1) * m_width];
+        }
+    }
+}
+
+bool GroupTable::Account(int64_t bytes)
+{
+    m_bytes = static_cast<size_t>(static_cast<int64_t>(m_bytes) + bytes);
+    // a group that is alone over the budget stays, as spilling it would only read it back
+    if (m_bytes > m_memory_budget && m_keys.size() > 1 && m_depth < kMaxSpillDepth)
+    {
+        return Spill();
+    }
+    return true;
+}
+
+bool GroupTable::Merge(GroupTable& other)
+{
+    for (size_t group = 0; group < other.m_keys.size(); ++group)
+    {
+        AggregateState* states = Group(other.m_keys[group]);
+        if (!states)
+        {
+            return false;
+        }
+        int64_t bytes = 0;
+        for (size_t i = 0; i < m_functions.size(); ++i)
+        {
+            bytes += MergeState(m_functions[i], states[i], other.m_states[group * m_width + i]);
+        }
+        if (!Account(bytes))
+        {
+            return false;
+        }
+    }
+    other.Clear();
+
+    // spilled groups stay where they are until Finish reads their partition
+    if (!other.m_runs.empty())
+    {
+        m_runs.resize(kPartitions);
+        for (size_t partition = 0; partition < kPartitions; ++partition)
+        {
+            std::move(other.m_runs[partition].begin(), other.m_runs[partition].end(), std::back_inserter(m_runs[partition]));
+        }
+        other.m_runs.clear();
+    }
+    return true;
+}
+
+bool GroupTable::Finish(const GroupVisitor& visitor)
+{
+    if (m_runs.empty())
+    {
+        for (size_t group = 0; group < m_keys.size(); ++group)
+        {
+            if (!visitor(m_keys[group], &m_states[group * m_width]))
+            {
+                Clear();
+                return false;
+            }
+        }
+        Clear();
+        return true;
+    }
+
+    // every group of a partition is in its runs, so partitions are finished one at a time
+    if (!Spill())
+    {
+        return false;
+    }
+    for (std::vector<SpillRun>& runs : m_runs)
+    {
+        GroupTable partition(m_functions, m_memory_budget, m_spill_directory, m_depth + 1);
+        for (SpillRun& run : runs)
+        {
+            if (!ReadRun(run, partition))
+            {
+                return false;
+            }
+            std::error_code error;
+            std::filesystem::remove(run.m_path, error);
+        }
+        runs.clear();
+        if (!partition.Finish(visitor))
+        {
+            return false;
+        }
+    }
+    m_runs.clear();
+    return true;
+}
+
+size_t GroupTable::Size() const
+{
+    return m_keys.size();
+}
+
+bool GroupTable::Spilled() const
+{
+    return !m_runs.empty();
+}
+
+void GroupTable::Grow()
+{
+    std::vector<Slot> slots(std::max<size_t>(16, m_slots.size() * 2));
+    const size_t mask = slots.size() - 1;
+    for (const Slot& slot : m_slots)
+    {
+        if (slot.m_group == 0)
+        {
+            continue;
+        }
+        size_t i = slot.m_hash & mask;
+        while (slots[i].m_group != 0)
+        {
+            i = (i + 1) & mask;
+        }
+        slots[i] = slot;
+    }
+    m_slots = std::move(slots);
+    // the table grows again at half full, so keys and states never move in between
+    m_keys.reserve(m_slots.size() / 2);
+    m_states.reserve(m_slots.size() / 2 * m_width);
+}
+
+size_t GroupTable::Partition(uint64_t hash) const
+{
+    // bits from the top, so the groups of one partition still spread over the slots the low bits pick
+    return (hash >> (64 - kPartitionBits * (m_depth + 1))) & (kPartitions - 1);
+}
+
+bool GroupTable::Spill()
+{
+    m_runs.resize(kPartitions);
+    std::vector<std::string> buffers(kPartitions);
+    const auto flush = [&](size_t partition) {
+        std::vector<SpillRun>& runs = m_runs[partition];
+        if (runs.empty())
+        {
+            const std::filesystem::path directory = m_spill_directory.empty() ? std::filesystem::temp_directory_path() : std::filesystem::path(m_spill_directory);
+            SpillRun run;
+            run.m_path = (directory / fmt::format("foodb-{}-{}.spill", ::getpid(), g_spill_counter++)).string();
+            run.m_out.open(run.m_path, std::ios::binary | std::ios::trunc);
+            runs.push_back(std::move(run));
+        }
+        SpillRun& run = runs.back();
+        run.m_out.write(buffers[partition].data(), static_cast<std::streamsize>(buffers[partition].size()));
+        buffers[partition].clear();
+        return run.m_out.good();
+    };
+
+    for (const Slot& slot : m_slots)
+    {
+        if (slot.m_group == 0)
+        {
+            continue;
+        }
+        const size_t partition = Partition(slot.m_hash);
+        const size_t group = slot.m_group - 1;
+        EncodeGroup(buffers[partition], m_keys[group], &m_states[group * m_width], m_width);
+        if (buffers[partition].size() >= kSpillBufferSize && !flush(partition))
+        {
+            return false;
+        }
+    }
+    for (size_t partition = 0; partition < kPartitions; ++partition)
+    {
+        if (!buffers[partition].empty() && !flush(partition))
+        {
+            return false;
+        }
+    }
+    Clear();
+    return true;
+}
+
+bool GroupTable::ReadRun(SpillRun& run, GroupTable& into)
+{
+    run.m_out.close();
+    std::ifstream in(run.m_path, std::ios::binary);
+    std::string buffer;
+    size_t position = 0;
+    std::string_view key;
+    std::vector<AggregateState> states(m_width);
+    while (true)
+    {
+        while (DecodeGroup(buffer, position, key, states))
+        {
+            AggregateState* group = into.Group(key);
+            if (!group)
+            {
+                return false;
+            }
+            int64_t bytes = 0;
+            for (size_t i = 0; i < m_functions.size(); ++i)
+            {
+                bytes += MergeState(m_functions[i], group[i], states[i]);
+            }
+            if (!into.Account(bytes))
+            {
+                return false;
+            }
+        }
+        if (!in.good())
+        {
+            // a run that ends in a partial group was cut short
+            return in.eof() && position == buffer.size();
+        }
+        // keep the group that was cut off and read the next chunk behind it
+        buffer.erase(0, position);
+        position = 0;
+        const size_t used = buffer.size();
+        buffer.resize(used + kReadChunkSize);
+        in.read(&buffer[used], static_cast<std::streamsize>(kReadChunkSize));
+        buffer.resize(used + static_cast<size_t>(in.gcount()));
+    }
+}
+
+void GroupTable::Clear()
+{
+    std::fill(m_slots.begin(), m_slots.end(), Slot());
+    m_keys.clear();
+    m_states.clear();
+    m_bytes = 0;
+}
+
+void GroupTable::RemoveRuns()
+{
+    for (std::vector<SpillRun>& runs : m_runs)
+    {
+        for (SpillRun& run : runs)
+        {
+            run.m_out.close();
+            std::error_code error;
+            std::filesystem::remove(run.m_path, error);
+        }
+    }
+    m_runs.clear();
+}
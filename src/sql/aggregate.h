@@ -0,0 +1,125 @@
+#ifndef FOODB_SQL_AGGREGATE_H_
+#define FOODB_SQL_AGGREGATE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "sql/ast.h"
+
+struct AggregateOptions
+{
+    //! threads of an aggregation over a full table scan, 0 for one per hardware thread
+    size_t m_threads { 0 };
+    //! bytes of groups one aggregation keeps in memory, split between its threads; past it
+    //! groups spill to disk
+    size_t m_memory_budget { 64 << 20 };
+    //! where spilled groups go, empty for the system's temporary directory
+    std::string m_spill_directory;
+};
+
+//! @brief the running value of one aggregate over the rows of one group
+struct AggregateState
+{
+    //! rows counted: every row for COUNT(*), else the rows whose column is not NULL
+    int64_t m_count { 0 };
+    //! SUM, or MIN or MAX of an int64 column
+    int64_t m_integer { 0 };
+    //! MIN or MAX of a string or bytes column
+    std::string m_text;
+};
+
+//! @brief fold a non-NULL value into state; SUM wraps around on overflow
+void AccumulateInt64(AggregateFunction function, AggregateState& state, int64_t value);
+//! @brief fold a non-NULL value into state and return how many bytes its text grew by, which
+//! is negative if it shrank
+int64_t AccumulateString(AggregateFunction function, AggregateState& state, std::string_view value);
+//! @brief fold the state of the same group from another table into state and return how many
+//! bytes its text grew by
+int64_t MergeState(AggregateFunction function, AggregateState& state, const AggregateState& other);
+
+//! @brief receives a group's key and its states, one per function; false stops the visit
+using GroupVisitor = std::function<bool(std::string_view key, const AggregateState* states)>;
+
+//! @brief the groups of an aggregation, keyed by their encoded group-by values, with one
+//! AggregateState per aggregate function
+//!
+//! Groups live in an open-addressing hash table with linear probing that keeps the hash of
+//! each group next to its index, so probes and rehashes rarely touch the keys. Once the
+//! groups would outgrow the memory budget, every group is written to one of 16 spill files
+//! chosen by the top bits of its hash, and the table starts over. Finish then reads the
+//! files back one partition at a time; a partition that is still too big spills again on the
+//! next bits of the hash.
+class GroupTable
+{
+public:
+    GroupTable(std::vector<AggregateFunction> functions, size_t memory_budget, std::string spill_directory, size_t depth = 0);
+    //! @brief removes the spill files that are left
+    ~GroupTable();
+
+    GroupTable(const GroupTable&) = delete;
+    GroupTable& operator=(const GroupTable&) = delete;
+
+    //! @brief the states of key's group, added with empty states if new; nullptr if groups
+    //! had to spill and could not be written
+    //!
+    //! The states are valid until the next call into the table.
+    AggregateState* Group(std::string_view key);
+    //! @brief count bytes more, or fewer if negative, for the text of the states last returned
+    //! by Group, spilling if that outgrows the budget; false if the groups could not be written
+    bool Account(int64_t bytes);
+    //! @brief move the groups of other, which has the same functions, into this table
+    bool Merge(GroupTable& other);
+    //! @brief visit every group once, spilled or not, in no particular order, and empty the
+    //! table; false if spilled groups could not be read back or visitor stopped
+    bool Finish(const GroupVisitor& visitor);
+    //! @brief groups in memory
+    size_t Size() const;
+    bool Spilled() const;
+
+private:
+    struct Slot
+    {
+        uint64_t m_hash { 0 };
+        //! index of the group plus one, 0 for an empty slot
+        uint32_t m_group { 0 };
+    };
+
+    //! @brief a file of spilled groups, each written as its key and its states
+    struct SpillRun
+    {
+        std::string m_path;
+        std::ofstream m_out;
+    };
+
+    void Grow();
+    size_t Partition(uint64_t hash) const;
+    //! @brief write every group in memory to the spill run of its partition and clear the table
+    bool Spill();
+    bool ReadRun(SpillRun& run, GroupTable& into);
+    void Clear();
+    void RemoveRuns();
+
+    std::vector<AggregateFunction> m_functions;
+    size_t m_memory_budget;
+    std::string m_spill_directory;
+    //! how many times the groups were partitioned already, which picks the hash bits to use
+    size_t m_depth;
+    //! states per group: one per function, but at least one so that every group has an address
+    size_t m_width;
+
+    std::vector<Slot> m_slots;
+    std::vector<std::string> m_keys;
+    //! m_width states per group, group after group
+    std::vector<AggregateState> m_states;
+    //! approximate bytes taken by the groups in memory, the text of their states included
+    size_t m_bytes { 0 };
+    //! spill runs per partition; merged tables bring their own runs along
+    std::vector<std::vector<SpillRun>> m_runs;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef FOODB_SQL_AST_H_
+#define FOODB_SQL_AST_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <variant>
+#include <vector>
+
+//! @brief an integer or string literal, and a value in a query result
+using Value = std::variant<int64_t, std::string>;
+
+enum class CompareOp : uint8_t
+{
+    kEqual,
+    kNotEqual,
+    kLess,
+    kGreater,
+    kLessEqual,
+    kGreaterEqual,
+};
+
+//! @brief what a selected column reports: its own value, or an aggregate over a group's rows
+enum class AggregateFunction : uint8_t
+{
+    kNone,
+    kCount,
+    kSum,
+    kMin,
+    kMax,
+};
+
+//! @brief a WHERE condition: a column compared with a literal, or AND, OR and NOT over conditions
+struct Condition
+{
+    enum class Kind : uint8_t
+    {
+        kCompare,
+        kAnd,
+        kOr,
+        kNot,
+    };
+
+    Kind m_kind { Kind::kCompare };
+    std::string m_column;
+    CompareOp m_op { CompareOp::kEqual };
+    Value m_value;
+    //! operands of AND and OR; NOT has only a left operand
+    std::unique_ptr<Condition> m_left;
+    std::unique_ptr<Condition> m_right;
+};
+
+struct SelectStatement
+{
+    //! selected column names, empty for SELECT *; the column of COUNT(*) is *
+    std::vector<std::string> m_columns;
+    //! the aggregate of each selected column, kNone for a plain column
+    std::vector<AggregateFunction> m_aggregates;
+    std::vector<std::string> m_tables;
+    //! nullptr without a WHERE clause
+    std::unique_ptr<Condition> m_where;
+    //! GROUP BY column names, empty without a GROUP BY clause
+    std::vector<std::string> m_group_by;
+};
+
+#endif
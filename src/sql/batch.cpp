@@ -0,0 +1,209 @@
+#include "sql/batch.h"
+
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <string>
+
+#include "sql/operators.h"
+
+// the x86-64 baseline has no 64-bit vector compare, so the kernels are also built for AVX2 and
+// the loader picks the variant the CPU supports
+#if defined(__GNUC__) && defined(__x86_64__)
+#define FOODB_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define FOODB_KERNEL
+#endif
+
+namespace
+{
+//! @brief call kernel with the comparison of op as a function object, so each one is its own loop
+template <typename Kernel>
+void WithComparison(CompareOp op, Kernel kernel)
+{
+    if (op == CompareOp::kEqual)
+    {
+        kernel(std::equal_to<>());
+    }
+    else if (op == CompareOp::kNotEqual)
+    {
+        kernel(std::not_equal_to<>());
+    }
+    else if (op == CompareOp::kLess)
+    {
+        kernel(std::less<>());
+    }
+    else if (op == CompareOp::kGreater)
+    {
+        kernel(std::greater<>());
+    }
+    else if (op == CompareOp::kLessEqual)
+    {
+        kernel(std::less_equal<>());
+    }
+    else
+    {
+        kernel(std::greater_equal<>());
+    }
+}
+
+//! @brief compare every value with literal; the loop has no branches, so it vectorizes
+template <typename Compare>
+FOODB_KERNEL void CompareInt64s(const int64_t* values, const uint8_t* valid, size_t size, int64_t literal, uint8_t* is_true, uint8_t* is_false, Compare compare)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        const uint8_t match = static_cast<uint8_t>(compare(values[i], literal));
+        is_true[i] = match & valid[i];
+        is_false[i] = (match ^ 1) & valid[i];
+    }
+}
+
+template <typename Compare>
+void CompareStrings(const std::string_view* values, const uint8_t* valid, size_t size, std::string_view literal, uint8_t* is_true, uint8_t* is_false, Compare compare)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        const uint8_t match = static_cast<uint8_t>(compare(values[i], literal));
+        is_true[i] = match & valid[i];
+        is_false[i] = (match ^ 1) & valid[i];
+    }
+}
+
+//! @brief Kleene AND of two results, into the first
+FOODB_KERNEL void And(uint8_t* is_true, uint8_t* is_false, const uint8_t* other_true, const uint8_t* other_false, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        is_true[i] &= other_true[i];
+        is_false[i] |= other_false[i];
+    }
+}
+
+//! @brief Kleene OR of two results, into the first
+FOODB_KERNEL void Or(uint8_t* is_true, uint8_t* is_false, const uint8_t* other_true, const uint8_t* other_false, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        is_true[i] |= other_true[i];
+        is_false[i] &= other_false[i];
+    }
+}
+}  // namespace
+
+void ColumnBatch::Append(const RowView& row)
+{
+    assert((!m_schema || m_schema == &row.GetSchema()) && "ColumnBatch::Append: rows of different schemas.");
+    assert(!Full() && "ColumnBatch::Append: the batch is full.");
+    m_schema = &row.GetSchema();
+    const size_t offset = m_arena.size();
+    m_arena.resize(offset + row.Size());
+    std::memcpy(m_arena.data() + offset, row.Data(), row.Size());
+    m_offsets.push_back(offset);
+}
+
+void ColumnBatch::Clear()
+{
+    m_arena.clear();
+    m_offsets.clear();
+    m_int64s.clear();
+    m_strings.clear();
+}
+
+size_t ColumnBatch::Size() const
+{
+    return m_offsets.size();
+}
+
+bool ColumnBatch::Full() const
+{
+    return m_offsets.size() == kCapacity;
+}
+
+RowView ColumnBatch::View(size_t i) const
+{
+    const size_t end = i + 1 < Size() ? m_offsets[i + 1] : m_arena.size();
+    return RowView(m_schema, m_arena.data() + m_offsets[i], end - m_offsets[i]);
+}
+
+const Int64Column& ColumnBatch::Int64s(size_t ordinal)
+{
+    const auto [it, inserted] = m_int64s.try_emplace(ordinal);
+    Int64Column& column = it->second;
+    if (inserted)
+    {
+        column.m_values.resize(Size());
+        column.m_valid.resize(Size());
+        RowView::GatherInt64(*m_schema, ordinal, m_arena.data(), m_offsets.data(), Size(), column.m_values.data(), column.m_valid.data());
+    }
+    return column;
+}
+
+const StringColumn& ColumnBatch::Strings(size_t ordinal)
+{
+    const auto [it, inserted] = m_strings.try_emplace(ordinal);
+    StringColumn& column = it->second;
+    if (inserted)
+    {
+        column.m_values.resize(Size());
+        column.m_valid.resize(Size());
+        RowView::GatherVariable(*m_schema, ordinal, m_arena.data(), m_offsets.data(), Size(), column.m_values.data(), column.m_valid.data());
+    }
+    return column;
+}
+
+void EvaluateBatch(const BoundCondition& condition, ColumnBatch& batch, TruthMask& result)
+{
+    const size_t size = batch.Size();
+    result.m_true.resize(size);
+    result.m_false.resize(size);
+    if (condition.m_kind == Condition::Kind::kCompare)
+    {
+        if (condition.m_column.m_type == ColumnType::kInt64)
+        {
+            const Int64Column& column = batch.Int64s(condition.m_column.m_ordinal);
+            const int64_t literal = std::get<int64_t>(condition.m_value);
+            WithComparison(condition.m_op, [&](auto compare) {
+                CompareInt64s(column.m_values.data(), column.m_valid.data(), size, literal, result.m_true.data(), result.m_false.data(), compare);
+            });
+        }
+        else
+        {
+            const StringColumn& column = batch.Strings(condition.m_column.m_ordinal);
+            const std::string_view literal = std::get<std::string>(condition.m_value);
+            WithComparison(condition.m_op, [&](auto compare) {
+                CompareStrings(column.m_values.data(), column.m_valid.data(), size, literal, result.m_true.data(), result.m_false.data(), compare);
+            });
+        }
+        return;
+    }
+
+    EvaluateBatch(*condition.m_left, batch, result);
+    if (condition.m_kind == Condition::Kind::kNot)
+    {
+        result.m_true.swap(result.m_false);
+        return;
+    }
+    TruthMask right;
+    EvaluateBatch(*condition.m_right, batch, right);
+    if (condition.m_kind == Condition::Kind::kAnd)
+    {
+        And(result.m_true.data(), result.m_false.data(), right.m_true.data(), right.m_false.data(), size);
+    }
+    else
+    {
+        Or(result.m_true.data(), result.m_false.data(), right.m_true.data(), right.m_false.data(), size);
+    }
+}
+
+void Select(const TruthMask& mask, std::vector<uint16_t>& selection)
+{
+    selection.resize(mask.m_true.size());
+    size_t count = 0;
+    for (size_t i = 0; i < mask.m_true.size(); ++i)
+    {
+        selection[count] = static_cast<uint16_t>(i);
+        count += mask.m_true[i];
+    }
+    selection.resize(count);
+}
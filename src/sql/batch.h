@@ -0,0 +1,74 @@
+#ifndef FOODB_SQL_BATCH_H_
+#define FOODB_SQL_BATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "catalog/row.h"
+#include "sql/ast.h"
+
+struct BoundCondition;
+
+//! @brief the values of one int64 column across a batch; m_valid is 0 for NULL, whose value is 0
+struct Int64Column
+{
+    std::vector<int64_t> m_values;
+    std::vector<uint8_t> m_valid;
+};
+
+//! @brief the values of one string or bytes column across a batch, viewing the batch's rows
+struct StringColumn
+{
+    std::vector<std::string_view> m_values;
+    std::vector<uint8_t> m_valid;
+};
+
+//! @brief a condition's result for every row of a batch, one byte per row and outcome
+//!
+//! A row is true, false or, when neither byte is set, unknown. Keeping both outcomes lets AND,
+//! OR and NOT follow SQL's three-valued logic with branch-free byte operations.
+struct TruthMask
+{
+    std::vector<uint8_t> m_true;
+    std::vector<uint8_t> m_false;
+};
+
+//! @brief up to kCapacity rows of one table, copied side by side and decoded column by column
+//!
+//! Rows are appended by a scan; once the batch is full, a column is decoded into plain arrays
+//! the first time a condition reads it, and kernels evaluate conditions over whole columns.
+class ColumnBatch
+{
+public:
+    static constexpr size_t kCapacity = 1024;
+
+    void Append(const RowView& row);
+    void Clear();
+    size_t Size() const;
+    bool Full() const;
+    //! @brief a view of row i, valid until the batch is appended to or cleared
+    RowView View(size_t i) const;
+
+    const Int64Column& Int64s(size_t ordinal);
+    //! @brief the values of a string or bytes column
+    const StringColumn& Strings(size_t ordinal);
+
+private:
+    const Schema* m_schema { nullptr };
+    //! row encodings back to back and where each one starts
+    std::vector<uint8_t> m_arena;
+    std::vector<size_t> m_offsets;
+    std::unordered_map<size_t, Int64Column> m_int64s;
+    std::unordered_map<size_t, StringColumn> m_strings;
+};
+
+//! @brief the result of a condition that reads one table for every row of batch
+void EvaluateBatch(const BoundCondition& condition, ColumnBatch& batch, TruthMask& result);
+//! @brief the rows for which mask is true, in ascending order
+void Select(const TruthMask& mask, std::vector<uint16_t>& selection);
+
+#endif
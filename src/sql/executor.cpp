@@ -0,0 +1,66 @@
+#include "sql/executor.h"
+
+#include <utility>
+
+#include "sql/parser.h"
+
+Executor::Executor(AggregateOptions options)
+    : m_options(std::move(options))
+{
+}
+
+bool Executor::AddTable(const std::string& name, const Table& table)
+{
+    return m_tables.emplace(name, &table).second;
+}
+
+std::optional<ResultSet> Executor::Execute(std::string_view sql, std::string& error) const
+{
+    const std::optional<Plan> plan = Prepare(sql, error);
+    if (!plan)
+    {
+        return std::nullopt;
+    }
+
+    ResultSet result;
+    result.m_columns = plan->m_column_names;
+    // the consumer never stops, so a false run failed
+    const bool finished = plan->m_root->Run([&](const Tuple& tuple) {
+        std::vector<std::optional<Value>> values;
+        values.reserve(plan->m_columns.size());
+        for (const ColumnRef& column : plan->m_columns)
+        {
+            values.push_back(ReadValue(column, tuple));
+        }
+        result.m_rows.push_back(std::move(values));
+        return true;
+    });
+    if (!finished)
+    {
+        error = "rows could not be read or spilled to disk";
+        return std::nullopt;
+    }
+    return result;
+}
+
+std::optional<std::string> Executor::Explain(std::string_view sql, std::string& error) const
+{
+    const std::optional<Plan> plan = Prepare(sql, error);
+    if (!plan)
+    {
+        return std::nullopt;
+    }
+    std::string out;
+    plan->m_root->Explain(out, 0);
+    return out;
+}
+
+std::optional<Plan> Executor::Prepare(std::string_view sql, std::string& error) const
+{
+    const std::optional<SelectStatement> statement = Parser::Parse(sql, error);
+    if (!statement)
+    {
+        return std::nullopt;
+    }
+    return Planner::Build(*statement, m_tables, m_options, error);
+}
@@ -0,0 +1,42 @@
+#ifndef FOODB_SQL_EXECUTOR_H_
+#define FOODB_SQL_EXECUTOR_H_
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "catalog/table.h"
+#include "sql/ast.h"
+#include "sql/planner.h"
+
+//! @brief the rows of a query, a value or nullopt for NULL per selected column
+struct ResultSet
+{
+    std::vector<std::string> m_columns;
+    std::vector<std::vector<std::optional<Value>>> m_rows;
+};
+
+//! @brief parses, plans and runs SELECT statements over the tables added to it
+//!
+//! options apply to every GROUP BY and aggregate the executor runs.
+class Executor
+{
+public:
+    explicit Executor(AggregateOptions options = AggregateOptions());
+    //! @brief make table queryable as name; the table must outlive the executor
+    bool AddTable(const std::string& name, const Table& table);
+    //! @brief nullopt, with a message in error, if the statement does not parse or bind, or its
+    //! rows could not be read or spilled
+    std::optional<ResultSet> Execute(std::string_view sql, std::string& error) const;
+    //! @brief the operator tree Execute would run, one operator per line
+    std::optional<std::string> Explain(std::string_view sql, std::string& error) const;
+
+private:
+    std::optional<Plan> Prepare(std::string_view sql, std::string& error) const;
+
+    TableCatalog m_tables;
+    AggregateOptions m_options;
+};
+
+#endif
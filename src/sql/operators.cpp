@@ -0,0 +1,703 @@
+#include "sql/operators.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "sql/batch.h"
+
+namespace
+{
+template <typename T>
+bool Compare(const T& left, CompareOp op, const T& right)
+{
+    if (op == CompareOp::kEqual)
+    {
+        return left == right;
+    }
+    else if (op == CompareOp::kNotEqual)
+    {
+        return left != right;
+    }
+    else if (op == CompareOp::kLess)
+    {
+        return left < right;
+    }
+    else if (op == CompareOp::kGreater)
+    {
+        return left > right;
+    }
+    else if (op == CompareOp::kLessEqual)
+    {
+        return left <= right;
+    }
+    return left >= right;
+}
+
+std::optional<bool> EvaluateCompare(const BoundCondition& condition, const Tuple& tuple)
+{
+    const RowView& view = tuple[condition.m_column.m_table];
+    assert(view.Valid() && "EvaluateCompare: the tuple lacks the row of the column's table.");
+    if (condition.m_column.m_type == ColumnType::kInt64)
+    {
+        const std::optional<int64_t> value = view.GetInt64(condition.m_column.m_ordinal);
+        if (!value)
+        {
+            return std::nullopt;
+        }
+        return Compare(*value, condition.m_op, std::get<int64_t>(condition.m_value));
+    }
+
+    std::optional<std::string_view> value;
+    if (condition.m_column.m_type == ColumnType::kString)
+    {
+        value = view.GetString(condition.m_column.m_ordinal);
+    }
+    else if (const std::optional<ByteSpan> bytes = view.GetBytes(condition.m_column.m_ordinal))
+    {
+        value = std::string_view(reinterpret_cast<const char*>(bytes->m_data), bytes->m_size);
+    }
+    if (!value)
+    {
+        return std::nullopt;
+    }
+    // string_view compares bytes as unsigned chars, the order of the index keys
+    return Compare(*value, condition.m_op, std::string_view(std::get<std::string>(condition.m_value)));
+}
+
+void CollectSlots(const BoundCondition& condition, std::vector<size_t>& slots)
+{
+    if (condition.m_kind == Condition::Kind::kCompare)
+    {
+        if (std::find(slots.begin(), slots.end(), condition.m_column.m_table) == slots.end())
+        {
+            slots.push_back(condition.m_column.m_table);
+        }
+        return;
+    }
+    CollectSlots(*condition.m_left, slots);
+    if (condition.m_right)
+    {
+        CollectSlots(*condition.m_right, slots);
+    }
+}
+
+void AppendLine(std::string& out, size_t depth, const std::string& line)
+{
+    out.append(depth * 2, ' ');
+    out.append(line);
+    out.push_back('\n');
+}
+
+//! @brief append the value of column to a group key as [u8 0] for NULL, [u8 1][int64] or
+//! [u8 1][u32 size][bytes]
+//!
+//! Group keys are only compared for equality and must decode back into values, so they are
+//! length-prefixed rather than KeyEncoder keys.
+void AppendGroupValue(const ColumnRef& column, const Tuple& tuple, std::string& key)
+{
+    const RowView& view = tuple[column.m_table];
+    std::optional<std::string_view> text;
+    if (column.m_type == ColumnType::kInt64)
+    {
+        if (const std::optional<int64_t> value = view.GetInt64(column.m_ordinal))
+        {
+            key.push_back(1);
+            key.append(reinterpret_cast<const char*>(&*value), sizeof(int64_t));
+            return;
+        }
+    }
+    else if (column.m_type == ColumnType::kString)
+    {
+        text = view.GetString(column.m_ordinal);
+    }
+    else if (const std::optional<ByteSpan> bytes = view.GetBytes(column.m_ordinal))
+    {
+        text = std::string_view(reinterpret_cast<const char*>(bytes->m_data), bytes->m_size);
+    }
+    if (!text)
+    {
+        key.push_back(0);
+        return;
+    }
+    const uint32_t size = static_cast<uint32_t>(text->size());
+    key.push_back(1);
+    key.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    key.append(*text);
+}
+
+//! @brief set column ordinal of row to the group key value at position, and move past it
+void SetGroupValue(std::string_view key, size_t& position, size_t ordinal, ColumnType type, Row& row)
+{
+    if (key[position++] == 0)
+    {
+        return;
+    }
+    if (type == ColumnType::kInt64)
+    {
+        int64_t value = 0;
+        std::memcpy(&value, key.data() + position, sizeof(value));
+        position += sizeof(value);
+        row.SetInt64(ordinal, value);
+        return;
+    }
+    uint32_t size = 0;
+    std::memcpy(&size, key.data() + position, sizeof(size));
+    position += sizeof(size);
+    const std::string_view text = key.substr(position, size);
+    position += size;
+    if (type == ColumnType::kString)
+    {
+        row.SetString(ordinal, std::string(text));
+    }
+    else
+    {
+        row.SetBytes(ordinal, std::vector<uint8_t>(text.begin(), text.end()));
+    }
+}
+}  // namespace
+
+std::optional<bool> Evaluate(const BoundCondition& condition, const Tuple& tuple)
+{
+    if (condition.m_kind == Condition::Kind::kCompare)
+    {
+        return EvaluateCompare(condition, tuple);
+    }
+    const std::optional<bool> left = Evaluate(*condition.m_left, tuple);
+    if (condition.m_kind == Condition::Kind::kNot)
+    {
+        return left ? std::optional<bool>(!*left) : std::nullopt;
+    }
+    if (condition.m_kind == Condition::Kind::kAnd)
+    {
+        if (left == false)
+        {
+            return false;
+        }
+        const std::optional<bool> right = Evaluate(*condition.m_right, tuple);
+        if (right == false)
+        {
+            return false;
+        }
+        return left && right ? std::optional<bool>(true) : std::nullopt;
+    }
+    if (left == true)
+    {
+        return true;
+    }
+    const std::optional<bool> right = Evaluate(*condition.m_right, tuple);
+    if (right == true)
+    {
+        return true;
+    }
+    return left && right ? std::optional<bool>(false) : std::nullopt;
+}
+
+std::optional<Value> ReadValue(const ColumnRef& column, const Tuple& tuple)
+{
+    const RowView& view = tuple[column.m_table];
+    assert(view.Valid() && "ReadValue: the tuple lacks the row of the column's table.");
+    if (column.m_type == ColumnType::kInt64)
+    {
+        if (const std::optional<int64_t> value = view.GetInt64(column.m_ordinal))
+        {
+            return Value(*value);
+        }
+    }
+    else if (column.m_type == ColumnType::kString)
+    {
+        if (const std::optional<std::string_view> value = view.GetString(column.m_ordinal))
+        {
+            return Value(std::string(*value));
+        }
+    }
+    else if (const std::optional<ByteSpan> value = view.GetBytes(column.m_ordinal))
+    {
+        return Value(std::string(reinterpret_cast<const char*>(value->m_data), value->m_size));
+    }
+    return std::nullopt;
+}
+
+std::optional<FullTableScan> Operator::AsFullScan() const
+{
+    return std::nullopt;
+}
+
+KeyLookup::KeyLookup(const Table& table, size_t slot, size_t width, std::string key, std::string description)
+    : m_table(table)
+    , m_slot(slot)
+    , m_width(width)
+    , m_key(std::move(key))
+    , m_description(std::move(description))
+{
+}
+
+bool KeyLookup::Run(const TupleConsumer& consumer) const
+{
+    const std::optional<Row> row = m_table.GetRow(m_key);
+    if (!row)
+    {
+        return true;
+    }
+    Tuple tuple(m_width);
+    tuple[m_slot] = row->View();
+    return consumer(tuple);
+}
+
+void KeyLookup::Explain(std::string& out, size_t depth) const
+{
+    AppendLine(out, depth, m_description);
+}
+
+KeyRangeScan::KeyRangeScan(const Table& table, size_t slot, size_t width, std::string start, std::string end, std::string description)
+    : m_table(table)
+    , m_slot(slot)
+    , m_width(width)
+    , m_start(std::move(start))
+    , m_end(std::move(end))
+    , m_description(std::move(description))
+{
+}
+
+bool KeyRangeScan::Run(const TupleConsumer& consumer) const
+{
+    Tuple tuple(m_width);
+    bool finished = true;
+    m_table.ScanRange(m_start, m_end, [&](const Row& row) {
+        tuple[m_slot] = row.View();
+        finished = consumer(tuple);
+        return finished;
+    });
+    return finished;
+}
+
+void KeyRangeScan::Explain(std::string& out, size_t depth) const
+{
+    AppendLine(out, depth, m_description);
+}
+
+std::optional<FullTableScan> KeyRangeScan::AsFullScan() const
+{
+    if (!m_start.empty() || !m_end.empty())
+    {
+        return std::nullopt;
+    }
+    return FullTableScan { &m_table, m_slot, nullptr };
+}
+
+IndexScan::IndexScan(const Table& table, size_t slot, size_t width, size_t ordinal, std::string start, std::string end, std::string description)
+    : m_table(table)
+    , m_slot(slot)
+    , m_width(width)
+    , m_ordinal(ordinal)
+    , m_start(std::move(start))
+    , m_end(std::move(end))
+    , m_description(std::move(description))
+{
+}
+
+bool IndexScan::Run(const TupleConsumer& consumer) const
+{
+    Tuple tuple(m_width);
+    bool finished = true;
+    m_table.ScanIndex(m_ordinal, m_start, m_end, [&](const Row& row) {
+        tuple[m_slot] = row.View();
+        finished = consumer(tuple);
+        return finished;
+    });
+    return finished;
+}
+
+void IndexScan::Explain(std::string& out, size_t depth) const
+{
+    AppendLine(out, depth, m_description);
+}
+
+EmptyScan::EmptyScan(std::string description)
+    : m_description(std::move(description))
+{
+}
+
+bool EmptyScan::Run(const TupleConsumer&) const
+{
+    return true;
+}
+
+void EmptyScan::Explain(std::string& out, size_t depth) const
+{
+    AppendLine(out, depth, m_description);
+}
+
+Filter::Filter(std::unique_ptr<Operator> child, std::unique_ptr<BoundCondition> condition)
+    : m_child(std::move(child))
+    , m_condition(std::move(condition))
+{
+    std::vector<size_t> slots;
+    CollectSlots(*m_condition, slots);
+    if (slots.size() == 1)
+    {
+        m_slot = slots.front();
+    }
+}
+
+bool Filter::Run(const TupleConsumer& consumer) const
+{
+    if (m_slot)
+    {
+        return RunBatches(consumer);
+    }
+    return m_child->Run([&](const Tuple& tuple) {
+        return Evaluate(*m_condition, tuple) != true || consumer(tuple);
+    });
+}
+
+bool Filter::RunBatches(const TupleConsumer& consumer) const
+{
+    ColumnBatch batch;
+    TruthMask mask;
+    std::vector<uint16_t> selection;
+    Tuple output;
+    bool finished = true;
+    const auto flush = [&]() {
+        EvaluateBatch(*m_condition, batch, mask);
+        Select(mask, selection);
+        for (uint16_t i : selection)
+        {
+            output[*m_slot] = batch.View(i);
+            if (!consumer(output))
+            {
+                finished = false;
+                break;
+            }
+        }
+        batch.Clear();
+        return finished;
+    };
+
+    m_child->Run([&](const Tuple& tuple) {
+        assert(std::count_if(tuple.begin(), tuple.end(), [](const RowView& row) { return row.Valid(); }) == 1 &&
+               "Filter::RunBatches: batched rows must be the only rows of their tuple.");
+        output.resize(tuple.size());
+        batch.Append(tuple[*m_slot]);
+        return !batch.Full() || flush();
+    });
+    if (finished && batch.Size() > 0)
+    {
+        flush();
+    }
+    return finished;
+}
+
+void Filter::Explain(std::string& out, size_t depth) const
+{
+    AppendLine(out, depth, "filter " + m_condition->m_text);
+    m_child->Explain(out, depth + 1);
+}
+
+std::optional<FullTableScan> Filter::AsFullScan() const
+{
+    std::optional<FullTableScan> scan = m_slot ? m_child->AsFullScan() : std::nullopt;
+    if (!scan || scan->m_condition)
+    {
+        return std::nullopt;
+    }
+    scan->m_condition = m_condition.get();
+    return scan;
+}
+
+CrossJoin::CrossJoin(std::unique_ptr<Operator> left, std::unique_ptr<Operator> right, size_t right_slot)
+    : m_left(std::move(left))
+    , m_right(std::move(right))
+    , m_right_slot(right_slot)
+{
+}
+
+bool CrossJoin::Run(const TupleConsumer& consumer) const
+{
+    // the encodings of the right rows back to back, viewed once the arena no longer grows
+    std::vector<uint8_t> arena;
+    std::vector<size_t> ends;
+    const Schema* schema = nullptr;
+    m_right->Run([&](const Tuple& tuple) {
+        const RowView& row = tuple[m_right_slot];
+        arena.insert(arena.end(), row.Data(), row.Data() + row.Size());
+        ends.push_back(arena.size());
+        schema = &row.GetSchema();
+        return true;
+    });
+    std::vector<RowView> right_rows;
+    for (size_t i = 0; i < ends.size(); ++i)
+    {
+        const size_t begin = i == 0 ? 0 : ends[i - 1];
+        right_rows.emplace_back(schema, arena.data() + begin, ends[i] - begin);
+    }
+    if (right_rows.empty())
+    {
+        return true;
+    }
+
+    Tuple joined;
+    return m_left->Run([&](const Tuple& tuple) {
+        joined = tuple;
+        for (const RowView& row : right_rows)
+        {
+            joined[m_right_slot] = row;
+            if (!consumer(joined))
+            {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+void CrossJoin::Explain(std::string& out, size_t depth) const
+{
+    AppendLine(out, depth, "cross join");
+    m_left->Explain(out, depth + 1);
+    m_right->Explain(out, depth + 1);
+}
+
+HashAggregate::HashAggregate(std::unique_ptr<Operator> child, std::vector<ColumnRef> groups, std::vector<std::string> group_names,
+                             std::vector<BoundAggregate> aggregates, AggregateOptions options)
+    : m_child(std::move(child))
+    , m_groups(std::move(groups))
+    , m_aggregates(std::move(aggregates))
+    , m_options(std::move(options))
+{
+    assert(group_names.size() == m_groups.size() && "HashAggregate::HashAggregate: every group column needs a name.");
+    std::vector<Column> columns;
+    for (size_t i = 0; i < m_groups.size(); ++i)
+    {
+        columns.push_back(Column { group_names[i], m_groups[i].m_type, 0, true, false });
+    }
+    for (const BoundAggregate& aggregate : m_aggregates)
+    {
+        const bool integer = aggregate.m_function == AggregateFunction::kCount || aggregate.m_function == AggregateFunction::kSum;
+        assert((integer || aggregate.m_column) && "HashAggregate::HashAggregate: MIN and MAX need a column.");
+        columns.push_back(Column { aggregate.m_text, integer ? ColumnType::kInt64 : aggregate.m_column->m_type, 0, true, false });
+    }
+    m_schema = std::make_shared<const Schema>(std::move(columns));
+}
+
+bool HashAggregate::Run(const TupleConsumer& consumer) const
+{
+    GroupTable groups(Functions(), m_options.m_memory_budget, m_options.m_spill_directory);
+    if (const std::optional<FullTableScan> scan = m_child->AsFullScan())
+    {
+        if (!RunParallel(*scan, groups))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        std::string key;
+        if (!m_child->Run([&](const Tuple& tuple) { return Accumulate(tuple, groups, key); }))
+        {
+            return false;
+        }
+    }
+    // without group-by columns every tuple is in the group of the empty key, which exists even without tuples
+    if (m_groups.empty() && !groups.Group(std::string_view()))
+    {
+        return false;
+    }
+
+    Tuple output(1);
+    return groups.Finish([&](std::string_view key, const AggregateState* states) {
+        Row row(m_schema);
+        size_t position = 0;
+        for (size_t ordinal = 0; ordinal < m_groups.size(); ++ordinal)
+        {
+            SetGroupValue(key, position, ordinal, m_groups[ordinal].m_type, row);
+        }
+        for (size_t i = 0; i < m_aggregates.size(); ++i)
+        {
+            const size_t ordinal = m_groups.size() + i;
+            const ColumnType type = m_schema->Columns()[ordinal].m_type;
+            if (m_aggregates[i].m_function == AggregateFunction::kCount)
+            {
+                row.SetInt64(ordinal, states[i].m_count);
+            }
+            else if (states[i].m_count == 0)
+            {
+                // no values to sum or compare leave the column NULL
+            }
+            else if (type == ColumnType::kInt64)
+            {
+                row.SetInt64(ordinal, states[i].m_integer);
+            }
+            else if (type == ColumnType::kString)
+            {
+                row.SetString(ordinal, states[i].m_text);
+            }
+            else
+            {
+                row.SetBytes(ordinal, std::vector<uint8_t>(states[i].m_text.begin(), states[i].m_text.end()));
+            }
+        }
+        output[0] = row.View();
+        return consumer(output);
+    });
+}
+
+void HashAggregate::Explain(std::string& out, size_t depth) const
+{
+    std::string line = m_child->AsFullScan() ? "parallel hash aggregate" : "hash aggregate";
+    for (size_t i = 0; i < m_groups.size(); ++i)
+    {
+        line += (i == 0 ? " by " : ", ") + m_schema->Columns()[i].m_name;
+    }
+    for (size_t i = 0; i < m_aggregates.size(); ++i)
+    {
+        line += (i == 0 ? ": " : ", ") + m_aggregates[i].m_text;
+    }
+    AppendLine(out, depth, line);
+    m_child->Explain(out, depth + 1);
+}
+
+const Schema& HashAggregate::OutputSchema() const
+{
+    return *m_schema;
+}
+
+bool HashAggregate::RunParallel(const FullTableScan& scan, GroupTable& groups) const
+{
+    struct Worker
+    {
+        std::unique_ptr<GroupTable> m_groups;
+        ColumnBatch m_batch;
+        TruthMask m_mask;
+        std::vector<uint16_t> m_selection;
+        Tuple m_tuple;
+        std::string m_key;
+    };
+
+    // the budget is split so that the workers' tables together stay within it
+    const size_t threads = std::max<size_t>(1, m_options.m_threads != 0 ? m_options.m_threads : std::thread::hardware_concurrency());
+    std::vector<Worker> workers(threads);
+    for (Worker& worker : workers)
+    {
+        worker.m_groups = std::make_unique<GroupTable>(Functions(), m_options.m_memory_budget / threads, m_options.m_spill_directory);
+        worker.m_tuple.resize(scan.m_slot + 1);
+    }
+
+    std::atomic<bool> failed { false };
+    const auto flush = [&](Worker& worker) {
+        EvaluateBatch(*scan.m_condition, worker.m_batch, worker.m_mask);
+        Select(worker.m_mask, worker.m_selection);
+        for (uint16_t i : worker.m_selection)
+        {
+            worker.m_tuple[scan.m_slot] = worker.m_batch.View(i);
+            if (!Accumulate(worker.m_tuple, *worker.m_groups, worker.m_key))
+            {
+                return false;
+            }
+        }
+        worker.m_batch.Clear();
+        return true;
+    };
+    const bool scanned = scan.m_table->ParallelScan(
+        nullptr,
+        [&](size_t index, const std::vector<RowView>& rows) {
+            Worker& worker = workers[index];
+            bool accumulated = true;
+            for (size_t i = 0; i < rows.size() && accumulated; ++i)
+            {
+                if (!scan.m_condition)
+                {
+                    worker.m_tuple[scan.m_slot] = rows[i];
+                    accumulated = Accumulate(worker.m_tuple, *worker.m_groups, worker.m_key);
+                }
+                else
+                {
+                    worker.m_batch.Append(rows[i]);
+                    accumulated = !worker.m_batch.Full() || flush(worker);
+                }
+            }
+            if (accumulated && worker.m_batch.Size() > 0)
+            {
+                accumulated = flush(worker);
+            }
+            if (!accumulated)
+            {
+                failed = true;
+            }
+            return accumulated;
+        },
+        threads);
+    if (!scanned || failed)
+    {
+        return false;
+    }
+
+    for (Worker& worker : workers)
+    {
+        if (!groups.Merge(*worker.m_groups))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HashAggregate::Accumulate(const Tuple& tuple, GroupTable& groups, std::string& key) const
+{
+    key.clear();
+    for (const ColumnRef& column : m_groups)
+    {
+        AppendGroupValue(column, tuple, key);
+    }
+    AggregateState* states = groups.Group(key);
+    if (!states)
+    {
+        return false;
+    }
+    // MIN and MAX of string or bytes columns hold text that counts against the memory budget
+    int64_t bytes = 0;
+    for (size_t i = 0; i < m_aggregates.size(); ++i)
+    {
+        const BoundAggregate& aggregate = m_aggregates[i];
+        if (!aggregate.m_column)
+        {
+            ++states[i].m_count;
+            continue;
+        }
+        const RowView& view = tuple[aggregate.m_column->m_table];
+        const size_t ordinal = aggregate.m_column->m_ordinal;
+        if (aggregate.m_column->m_type == ColumnType::kInt64)
+        {
+            if (const std::optional<int64_t> value = view.GetInt64(ordinal))
+            {
+                AccumulateInt64(aggregate.m_function, states[i], *value);
+            }
+        }
+        else if (aggregate.m_column->m_type == ColumnType::kString)
+        {
+            if (const std::optional<std::string_view> value = view.GetString(ordinal))
+            {
+                bytes += AccumulateString(aggregate.m_function, states[i], *value);
+            }
+        }
+        else if (const std::optional<ByteSpan> value = view.GetBytes(ordinal))
+        {
+            bytes += AccumulateString(aggregate.m_function, states[i], std::string_view(reinterpret_cast<const char*>(value->m_data), value->m_size));
+        }
+    }
+    return bytes == 0 || groups.Account(bytes);
+}
+
+std::vector<AggregateFunction> HashAggregate::Functions() const
+{
+    std::vector<AggregateFunction> functions;
+    for (const BoundAggregate& aggregate : m_aggregates)
+    {
+        functions.push_back(aggregate.m_function);
+    }
+    return functions;
+}
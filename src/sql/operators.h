@@ -0,0 +1,222 @@
+#ifndef FOODB_SQL_OPERATORS_H_
+#define FOODB_SQL_OPERATORS_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "catalog/table.h"
+#include "sql/aggregate.h"
+#include "sql/ast.h"
+
+//! @brief a view of one row per FROM table, in FROM order, valid only inside the consumer it is passed to
+//!
+//! Every operator below an aggregate passes tuples as wide as the FROM list; a scan fills only
+//! the slot of its table, a join fills the slots of both sides, and the other slots hold
+//! invalid views. An aggregate passes tuples of a single slot holding its output rows.
+using Tuple = std::vector<RowView>;
+//! @brief receives tuples from an operator, false stops the operator
+using TupleConsumer = std::function<bool(const Tuple&)>;
+
+//! @brief a column resolved against the FROM tables
+struct ColumnRef
+{
+    size_t m_table { 0 };
+    size_t m_ordinal { 0 };
+    ColumnType m_type { ColumnType::kBytes };
+};
+
+//! @brief a Condition with its columns resolved and its literals checked against the column types
+struct BoundCondition
+{
+    Condition::Kind m_kind { Condition::Kind::kCompare };
+    ColumnRef m_column;
+    CompareOp m_op { CompareOp::kEqual };
+    Value m_value;
+    std::unique_ptr<BoundCondition> m_left;
+    std::unique_ptr<BoundCondition> m_right;
+    //! the condition as written, for Explain
+    std::string m_text;
+};
+
+//! @brief SQL three-valued logic: nullopt is unknown, which a comparison with NULL yields
+std::optional<bool> Evaluate(const BoundCondition& condition, const Tuple& tuple);
+//! @brief the value of a column in a tuple, nullopt for NULL
+std::optional<Value> ReadValue(const ColumnRef& column, const Tuple& tuple);
+
+//! @brief an aggregate function over a column, resolved against the FROM tables
+struct BoundAggregate
+{
+    AggregateFunction m_function { AggregateFunction::kCount };
+    //! nullopt for COUNT(*)
+    std::optional<ColumnRef> m_column;
+    //! the aggregate as written, for Explain and as its result column's name
+    std::string m_text;
+};
+
+//! @brief every row of one table, for a parent that reads them with Table::ParallelScan
+struct FullTableScan
+{
+    const Table* m_table { nullptr };
+    size_t m_slot { 0 };
+    //! a condition that reads only the table's slot and rows must meet, nullptr for every row
+    const BoundCondition* m_condition { nullptr };
+};
+
+//! @brief a node of a push-based operator tree
+class Operator
+{
+public:
+    virtual ~Operator() = default;
+    //! @brief push every tuple into consumer, false if the consumer stopped early or rows could
+    //! not be read
+    virtual bool Run(const TupleConsumer& consumer) const = 0;
+    //! @brief one line per operator, children indented below their parent
+    virtual void Explain(std::string& out, size_t depth) const = 0;
+    //! @brief the table this operator scans in full, if it does nothing else, possibly filtered
+    virtual std::optional<FullTableScan> AsFullScan() const;
+};
+
+//! @brief the row of one primary key, found with a single index lookup
+class KeyLookup : public Operator
+{
+public:
+    KeyLookup(const Table& table, size_t slot, size_t width, std::string key, std::string description);
+    bool Run(const TupleConsumer& consumer) const override;
+    void Explain(std::string& out, size_t depth) const override;
+
+private:
+    const Table& m_table;
+    size_t m_slot;
+    size_t m_width;
+    std::string m_key;
+    std::string m_description;
+};
+
+//! @brief rows with a primary key in [start, end) in key order; both bounds empty is a full scan
+class KeyRangeScan : public Operator
+{
+public:
+    KeyRangeScan(const Table& table, size_t slot, size_t width, std::string start, std::string end, std::string description);
+    bool Run(const TupleConsumer& consumer) const override;
+    void Explain(std::string& out, size_t depth) const override;
+    std::optional<FullTableScan> AsFullScan() const override;
+
+private:
+    const Table& m_table;
+    size_t m_slot;
+    size_t m_width;
+    std::string m_start;
+    std::string m_end;
+    std::string m_description;
+};
+
+//! @brief rows whose value of an indexed column is in [start, end), read through its secondary index
+//!
+//! Bounds are encoded like single-column keys of that column, an empty end is unbounded.
+class IndexScan : public Operator
+{
+public:
+    IndexScan(const Table& table, size_t slot, size_t width, size_t ordinal, std::string start, std::string end, std::string description);
+    bool Run(const TupleConsumer& consumer) const override;
+    void Explain(std::string& out, size_t depth) const override;
+
+private:
+    const Table& m_table;
+    size_t m_slot;
+    size_t m_width;
+    size_t m_ordinal;
+    std::string m_start;
+    std::string m_end;
+    std::string m_description;
+};
+
+//! @brief a scan that finds no rows, for key ranges that are empty
+class EmptyScan : public Operator
+{
+public:
+    explicit EmptyScan(std::string description);
+    bool Run(const TupleConsumer& consumer) const override;
+    void Explain(std::string& out, size_t depth) const override;
+
+private:
+    std::string m_description;
+};
+
+//! @brief passes on the tuples for which the condition is true
+//!
+//! A condition that reads one table is evaluated a ColumnBatch at a time over the rows of that
+//! table, which must be the only rows of the child's tuples; others are evaluated per tuple.
+class Filter : public Operator
+{
+public:
+    Filter(std::unique_ptr<Operator> child, std::unique_ptr<BoundCondition> condition);
+    bool Run(const TupleConsumer& consumer) const override;
+    void Explain(std::string& out, size_t depth) const override;
+    std::optional<FullTableScan> AsFullScan() const override;
+
+private:
+    bool RunBatches(const TupleConsumer& consumer) const;
+
+    std::unique_ptr<Operator> m_child;
+    std::unique_ptr<BoundCondition> m_condition;
+    //! the slot of the one table the condition reads
+    std::optional<size_t> m_slot;
+};
+
+//! @brief every pair of a left and a right tuple
+//!
+//! The right side fills one slot; its rows are read once and their encodings kept in memory.
+class CrossJoin : public Operator
+{
+public:
+    CrossJoin(std::unique_ptr<Operator> left, std::unique_ptr<Operator> right, size_t right_slot);
+    bool Run(const TupleConsumer& consumer) const override;
+    void Explain(std::string& out, size_t depth) const override;
+
+private:
+    std::unique_ptr<Operator> m_left;
+    std::unique_ptr<Operator> m_right;
+    size_t m_right_slot;
+};
+
+//! @brief one row per group of tuples with equal group-by values, holding those values and the
+//! aggregates over the group
+//!
+//! Output rows have the group-by columns followed by one int64 column per COUNT and SUM and a
+//! column of the aggregated column's type per MIN and MAX; all are nullable. SUM, MIN and MAX
+//! over no values are NULL, and NULL group-by values form a group of their own. Without
+//! group-by columns there is exactly one output row, even for no input. Groups come out in no
+//! particular order.
+//!
+//! Groups are kept in a GroupTable keyed by their group-by values. When the child is a full
+//! scan of one table, it is read with Table::ParallelScan instead of run: every worker
+//! aggregates into a GroupTable of its own, filtering its rows a ColumnBatch at a time, and
+//! the tables are merged once the scan ends. Any other child is aggregated on the calling
+//! thread.
+class HashAggregate : public Operator
+{
+public:
+    HashAggregate(std::unique_ptr<Operator> child, std::vector<ColumnRef> groups, std::vector<std::string> group_names, std::vector<BoundAggregate> aggregates,
+                  AggregateOptions options);
+    bool Run(const TupleConsumer& consumer) const override;
+    void Explain(std::string& out, size_t depth) const override;
+    const Schema& OutputSchema() const;
+
+private:
+    bool RunParallel(const FullTableScan& scan, GroupTable& groups) const;
+    //! @brief fold tuple into its group, false if groups had to spill and could not
+    bool Accumulate(const Tuple& tuple, GroupTable& groups, std::string& key) const;
+    std::vector<AggregateFunction> Functions() const;
+
+    std::unique_ptr<Operator> m_child;
+    std::vector<ColumnRef> m_groups;
+    std::vector<BoundAggregate> m_aggregates;
+    AggregateOptions m_options;
+    std::shared_ptr<const Schema> m_schema;
+};
+
+#endif
@@ -0,0 +1,495 @@
+#include "sql/parser.h"
+
+#include <cctype>
+#include <charconv>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace
+{
+struct Token
+{
+    enum class Kind : uint8_t
+    {
+        kIdentifier,
+        kInteger,
+        kString,
+        kSymbol,
+        kEnd,
+    };
+
+    Kind m_kind { Kind::kEnd };
+    //! identifier, symbol or unquoted string contents
+    std::string m_text;
+    int64_t m_integer { 0 };
+    size_t m_offset { 0 };
+};
+
+bool IsIdentifierStart(char c)
+{
+    return std::isalpha(static_cast<unsigned char>(c)) != 0;
+}
+
+bool IsIdentifierPart(char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) != 0 || c == '_';
+}
+
+bool IsDigit(char c)
+{
+    return std::isdigit(static_cast<unsigned char>(c)) != 0;
+}
+
+bool EqualsIgnoreCase(const std::string& text, std::string_view keyword)
+{
+    if (text.size() != keyword.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        if (std::toupper(static_cast<unsigned char>(text[i])) != keyword[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool IsKeyword(const std::string& text)
+{
+    return EqualsIgnoreCase(text, "SELECT") || EqualsIgnoreCase(text, "FROM") || EqualsIgnoreCase(text, "WHERE") || EqualsIgnoreCase(text, "AND") ||
+           EqualsIgnoreCase(text, "OR") || EqualsIgnoreCase(text, "NOT") || EqualsIgnoreCase(text, "GROUP") || EqualsIgnoreCase(text, "BY");
+}
+
+bool Tokenize(std::string_view sql, std::vector<Token>& tokens, std::string& error)
+{
+    size_t i = 0;
+    while (i < sql.size())
+    {
+        const char c = sql[i];
+        if (std::isspace(static_cast<unsigned char>(c)) != 0)
+        {
+            ++i;
+            continue;
+        }
+
+        Token token;
+        token.m_offset = i;
+        if (IsIdentifierStart(c))
+        {
+            const size_t start = i;
+            while (i < sql.size() && IsIdentifierPart(sql[i]))
+            {
+                ++i;
+            }
+            token.m_kind = Token::Kind::kIdentifier;
+            token.m_text = std::string(sql.substr(start, i - start));
+        }
+        else if (IsDigit(c) || (c == '-' && i + 1 < sql.size() && IsDigit(sql[i + 1])))
+        {
+            const size_t start = i;
+            ++i;
+            while (i < sql.size() && IsDigit(sql[i]))
+            {
+                ++i;
+            }
+            const auto [end, status] = std::from_chars(sql.data() + start, sql.data() + i, token.m_integer);
+            if (status != std::errc() || end != sql.data() + i)
+            {
+                error = fmt::format("integer out of range at offset {}", start);
+                return false;
+            }
+            token.m_kind = Token::Kind::kInteger;
+        }
+        else if (c == '\'')
+        {
+            ++i;
+            bool closed = false;
+            while (i < sql.size())
+            {
+                if (sql[i] != '\'')
+                {
+                    token.m_text.push_back(sql[i++]);
+                }
+                else if (i + 1 < sql.size() && sql[i + 1] == '\'')
+                {
+                    token.m_text.push_back('\'');
+                    i += 2;
+                }
+                else
+                {
+                    ++i;
+                    closed = true;
+                    break;
+                }
+            }
+            if (!closed)
+            {
+                error = fmt::format("unterminated string at offset {}", token.m_offset);
+                return false;
+            }
+            token.m_kind = Token::Kind::kString;
+        }
+        else if ((c == '!' || c == '<' || c == '>') && i + 1 < sql.size() && sql[i + 1] == '=')
+        {
+            token.m_kind = Token::Kind::kSymbol;
+            token.m_text = std::string(sql.substr(i, 2));
+            i += 2;
+        }
+        else if (c == '*' || c == ',' || c == '=' || c == '<' || c == '>' || c == ';' || c == '(' || c == ')')
+        {
+            token.m_kind = Token::Kind::kSymbol;
+            token.m_text = std::string(1, c);
+            ++i;
+        }
+        else
+        {
+            error = fmt::format("unexpected character '{}' at offset {}", c, i);
+            return false;
+        }
+        tokens.push_back(std::move(token));
+    }
+
+    Token end;
+    end.m_offset = sql.size();
+    tokens.push_back(end);
+    return true;
+}
+
+//! @brief one parse over a token list, a function per grammar rule
+class ParseState
+{
+public:
+    ParseState(std::vector<Token> tokens, std::string& error)
+        : m_tokens(std::move(tokens))
+        , m_error(error)
+    {
+    }
+
+    std::optional<SelectStatement> ParseStatement()
+    {
+        SelectStatement statement;
+        if (!ExpectKeyword("SELECT") || !ParseSelectList(statement) || !ExpectKeyword("FROM") || !ParseTables(statement))
+        {
+            return std::nullopt;
+        }
+        if (AcceptKeyword("WHERE"))
+        {
+            statement.m_where = ParseOr();
+            if (!statement.m_where)
+            {
+                return std::nullopt;
+            }
+        }
+        if (AcceptKeyword("GROUP") && (!ExpectKeyword("BY") || !ParseGroupBy(statement)))
+        {
+            return std::nullopt;
+        }
+        AcceptSymbol(";");
+        if (Peek().m_kind != Token::Kind::kEnd)
+        {
+            Fail("end of statement");
+            return std::nullopt;
+        }
+        return statement;
+    }
+
+private:
+    bool ParseSelectList(SelectStatement& statement)
+    {
+        if (AcceptSymbol("*"))
+        {
+            return true;
+        }
+        do
+        {
+            const AggregateFunction function = ParseAggregateFunction();
+            if (function != AggregateFunction::kNone && !ExpectSymbol("("))
+            {
+                return false;
+            }
+            std::optional<std::string> column;
+            if (function == AggregateFunction::kCount && AcceptSymbol("*"))
+            {
+                column = "*";
+            }
+            else
+            {
+                column = ExpectIdentifier("column name");
+            }
+            if (!column || (function != AggregateFunction::kNone && !ExpectSymbol(")")))
+            {
+                return false;
+            }
+            statement.m_columns.push_back(std::move(*column));
+            statement.m_aggregates.push_back(function);
+        } while (AcceptSymbol(","));
+        return true;
+    }
+
+    //! @brief the aggregate function named by the next tokens, consuming its name; function names
+    //! are not keywords, so a column may be called count as long as no parenthesis follows it
+    AggregateFunction ParseAggregateFunction()
+    {
+        const Token& token = Peek();
+        const Token& next = m_tokens[m_position + 1 < m_tokens.size() ? m_position + 1 : m_position];
+        if (token.m_kind != Token::Kind::kIdentifier || next.m_kind != Token::Kind::kSymbol || next.m_text != "(")
+        {
+            return AggregateFunction::kNone;
+        }
+        AggregateFunction function = AggregateFunction::kNone;
+        if (EqualsIgnoreCase(token.m_text, "COUNT"))
+        {
+            function = AggregateFunction::kCount;
+        }
+        else if (EqualsIgnoreCase(token.m_text, "SUM"))
+        {
+            function = AggregateFunction::kSum;
+        }
+        else if (EqualsIgnoreCase(token.m_text, "MIN"))
+        {
+            function = AggregateFunction::kMin;
+        }
+        else if (EqualsIgnoreCase(token.m_text, "MAX"))
+        {
+            function = AggregateFunction::kMax;
+        }
+        if (function != AggregateFunction::kNone)
+        {
+            ++m_position;
+        }
+        return function;
+    }
+
+    bool ParseGroupBy(SelectStatement& statement)
+    {
+        do
+        {
+            std::optional<std::string> column = ExpectIdentifier("column name");
+            if (!column)
+            {
+                return false;
+            }
+            statement.m_group_by.push_back(std::move(*column));
+        } while (AcceptSymbol(","));
+        return true;
+    }
+
+    bool ParseTables(SelectStatement& statement)
+    {
+        std::optional<std::string> table = ExpectIdentifier("table name");
+        if (!table)
+        {
+            return false;
+        }
+        statement.m_tables.push_back(std::move(*table));
+        // the grammar allows at most two table references
+        if (AcceptSymbol(","))
+        {
+            table = ExpectIdentifier("table name");
+            if (!table)
+            {
+                return false;
+            }
+            statement.m_tables.push_back(std::move(*table));
+        }
+        return true;
+    }
+
+    std::unique_ptr<Condition> ParseOr()
+    {
+        std::unique_ptr<Condition> left = ParseAnd();
+        while (left && AcceptKeyword("OR"))
+        {
+            left = Combine(Condition::Kind::kOr, std::move(left), ParseAnd());
+        }
+        return left;
+    }
+
+    std::unique_ptr<Condition> ParseAnd()
+    {
+        std::unique_ptr<Condition> left = ParseFactor();
+        while (left && AcceptKeyword("AND"))
+        {
+            left = Combine(Condition::Kind::kAnd, std::move(left), ParseFactor());
+        }
+        return left;
+    }
+
+    std::unique_ptr<Condition> ParseFactor()
+    {
+        if (AcceptKeyword("NOT"))
+        {
+            std::unique_ptr<Condition> test = ParseTest();
+            if (!test)
+            {
+                return nullptr;
+            }
+            auto condition = std::make_unique<Condition>();
+            condition->m_kind = Condition::Kind::kNot;
+            condition->m_left = std::move(test);
+            return condition;
+        }
+        return ParseTest();
+    }
+
+    std::unique_ptr<Condition> ParseTest()
+    {
+        std::optional<std::string> column = ExpectIdentifier("column name");
+        if (!column)
+        {
+            return nullptr;
+        }
+        auto condition = std::make_unique<Condition>();
+        condition->m_column = std::move(*column);
+
+        const Token& op = Peek();
+        if (op.m_kind != Token::Kind::kSymbol)
+        {
+            Fail("comparison operator");
+            return nullptr;
+        }
+        if (op.m_text == "=")
+        {
+            condition->m_op = CompareOp::kEqual;
+        }
+        else if (op.m_text == "!=")
+        {
+            condition->m_op = CompareOp::kNotEqual;
+        }
+        else if (op.m_text == "<")
+        {
+            condition->m_op = CompareOp::kLess;
+        }
+        else if (op.m_text == ">")
+        {
+            condition->m_op = CompareOp::kGreater;
+        }
+        else if (op.m_text == "<=")
+        {
+            condition->m_op = CompareOp::kLessEqual;
+        }
+        else if (op.m_text == ">=")
+        {
+            condition->m_op = CompareOp::kGreaterEqual;
+        }
+        else
+        {
+            Fail("comparison operator");
+            return nullptr;
+        }
+        ++m_position;
+
+        const Token& value = Peek();
+        if (value.m_kind == Token::Kind::kInteger)
+        {
+            condition->m_value = value.m_integer;
+        }
+        else if (value.m_kind == Token::Kind::kString)
+        {
+            condition->m_value = value.m_text;
+        }
+        else
+        {
+            Fail("integer or string value");
+            return nullptr;
+        }
+        ++m_position;
+        return condition;
+    }
+
+    std::unique_ptr<Condition> Combine(Condition::Kind kind, std::unique_ptr<Condition> left, std::unique_ptr<Condition> right)
+    {
+        if (!right)
+        {
+            return nullptr;
+        }
+        auto condition = std::make_unique<Condition>();
+        condition->m_kind = kind;
+        condition->m_left = std::move(left);
+        condition->m_right = std::move(right);
+        return condition;
+    }
+
+    const Token& Peek() const
+    {
+        return m_tokens[m_position];
+    }
+
+    bool AcceptKeyword(std::string_view keyword)
+    {
+        const Token& token = Peek();
+        if (token.m_kind == Token::Kind::kIdentifier && EqualsIgnoreCase(token.m_text, keyword))
+        {
+            ++m_position;
+            return true;
+        }
+        return false;
+    }
+
+    bool ExpectKeyword(std::string_view keyword)
+    {
+        if (!AcceptKeyword(keyword))
+        {
+            Fail(keyword);
+            return false;
+        }
+        return true;
+    }
+
+    bool AcceptSymbol(std::string_view symbol)
+    {
+        const Token& token = Peek();
+        if (token.m_kind == Token::Kind::kSymbol && token.m_text == symbol)
+        {
+            ++m_position;
+            return true;
+        }
+        return false;
+    }
+
+    bool ExpectSymbol(std::string_view symbol)
+    {
+        if (!AcceptSymbol(symbol))
+        {
+            Fail(fmt::format("'{}'", symbol));
+            return false;
+        }
+        return true;
+    }
+
+    std::optional<std::string> ExpectIdentifier(std::string_view what)
+    {
+        const Token& token = Peek();
+        if (token.m_kind != Token::Kind::kIdentifier || IsKeyword(token.m_text))
+        {
+            Fail(what);
+            return std::nullopt;
+        }
+        ++m_position;
+        return token.m_text;
+    }
+
+    void Fail(std::string_view expected)
+    {
+        m_error = fmt::format("expected {} at offset {}", expected, Peek().m_offset);
+    }
+
+    std::vector<Token> m_tokens;
+    size_t m_position { 0 };
+    std::string& m_error;
+};
+}  // namespace
+
+std::optional<SelectStatement> Parser::Parse(std::string_view sql, std::string& error)
+{
+    std::vector<Token> tokens;
+    if (!Tokenize(sql, tokens, error))
+    {
+        return std::nullopt;
+    }
+    return ParseState(std::move(tokens), error).ParseStatement();
+}
@@ -0,0 +1,22 @@
+#ifndef FOODB_SQL_PARSER_H_
+#define FOODB_SQL_PARSER_H_
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "sql/ast.h"
+
+//! @brief recursive-descent parser for the SELECT grammar in docs/sql.md
+//!
+//! Keywords are case-insensitive. A value is an integer, optionally negative, or a string in
+//! single quotes with '' for a quote inside it. A trailing semicolon is allowed. COUNT, SUM, MIN
+//! and MAX name aggregates only when a parenthesis follows them.
+class Parser
+{
+public:
+    //! @brief nullopt, with a message in error, unless sql is one well-formed SELECT statement
+    static std::optional<SelectStatement> Parse(std::string_view sql, std::string& error);
+};
+
+#endif
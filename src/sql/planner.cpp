@@ -0,0 +1,621 @@
+#include "sql/planner.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+#include <fmt/format.h>
+
+#include "catalog/key_encoder.h"
+
+namespace
+{
+struct KeyBound
+{
+    Value m_value;
+    bool m_inclusive { true };
+};
+
+//! @brief the interval of one indexed column the top-level comparisons of its table allow
+struct KeyRange
+{
+    std::optional<KeyBound> m_low;
+    std::optional<KeyBound> m_high;
+};
+
+std::string FormatValue(const Value& value)
+{
+    if (const int64_t* integer = std::get_if<int64_t>(&value))
+    {
+        return std::to_string(*integer);
+    }
+    std::string text = "'";
+    for (char c : std::get<std::string>(value))
+    {
+        text += c == '\'' ? std::string("''") : std::string(1, c);
+    }
+    return text + "'";
+}
+
+const char* FormatOp(CompareOp op)
+{
+    if (op == CompareOp::kEqual)
+    {
+        return "=";
+    }
+    else if (op == CompareOp::kNotEqual)
+    {
+        return "!=";
+    }
+    else if (op == CompareOp::kLess)
+    {
+        return "<";
+    }
+    else if (op == CompareOp::kGreater)
+    {
+        return ">";
+    }
+    else if (op == CompareOp::kLessEqual)
+    {
+        return "<=";
+    }
+    return ">=";
+}
+
+const char* FormatFunction(AggregateFunction function)
+{
+    if (function == AggregateFunction::kCount)
+    {
+        return "COUNT";
+    }
+    else if (function == AggregateFunction::kSum)
+    {
+        return "SUM";
+    }
+    else if (function == AggregateFunction::kMin)
+    {
+        return "MIN";
+    }
+    return "MAX";
+}
+
+//! @brief the operator that matches exactly the rows for which NOT (a op b) is true
+CompareOp Negate(CompareOp op)
+{
+    if (op == CompareOp::kEqual)
+    {
+        return CompareOp::kNotEqual;
+    }
+    else if (op == CompareOp::kNotEqual)
+    {
+        return CompareOp::kEqual;
+    }
+    else if (op == CompareOp::kLess)
+    {
+        return CompareOp::kGreaterEqual;
+    }
+    else if (op == CompareOp::kGreater)
+    {
+        return CompareOp::kLessEqual;
+    }
+    else if (op == CompareOp::kLessEqual)
+    {
+        return CompareOp::kGreater;
+    }
+    return CompareOp::kLess;
+}
+
+void AddKeyValue(KeyEncoder& encoder, const Value& value)
+{
+    if (const int64_t* integer = std::get_if<int64_t>(&value))
+    {
+        encoder.AddInt64(*integer);
+    }
+    else
+    {
+        encoder.AddString(std::get<std::string>(value));
+    }
+}
+
+//! @brief the index key of a single-column primary key value
+std::string EncodeKey(const Value& value)
+{
+    KeyEncoder encoder;
+    AddKeyValue(encoder, value);
+    return encoder.Finish();
+}
+
+//! @brief the smallest index key above every key that starts with prefix, empty if none is
+std::string PrefixEnd(std::string prefix)
+{
+    while (!prefix.empty() && static_cast<uint8_t>(prefix.back()) == 0xFF)
+    {
+        prefix.pop_back();
+    }
+    if (!prefix.empty())
+    {
+        prefix.back() = static_cast<char>(static_cast<uint8_t>(prefix.back()) + 1);
+    }
+    return prefix;
+}
+
+//! @brief the smallest index key above key; single-column keys have no other key in between
+std::string NextKey(std::string key)
+{
+    key.push_back('\0');
+    return key;
+}
+
+//! @brief narrow range by key op value, where op is not !=
+void Narrow(KeyRange& range, CompareOp op, const Value& value)
+{
+    if (op == CompareOp::kEqual || op == CompareOp::kGreater || op == CompareOp::kGreaterEqual)
+    {
+        const bool inclusive = op != CompareOp::kGreater;
+        if (!range.m_low || range.m_low->m_value < value || (range.m_low->m_value == value && !inclusive))
+        {
+            range.m_low = KeyBound { value, inclusive };
+        }
+    }
+    if (op == CompareOp::kEqual || op == CompareOp::kLess || op == CompareOp::kLessEqual)
+    {
+        const bool inclusive = op != CompareOp::kLess;
+        if (!range.m_high || value < range.m_high->m_value || (range.m_high->m_value == value && !inclusive))
+        {
+            range.m_high = KeyBound { value, inclusive };
+        }
+    }
+}
+
+//! @brief a range of a single value, both bounds inclusive
+bool IsPoint(const KeyRange& range)
+{
+    return range.m_low && range.m_high && range.m_low->m_value == range.m_high->m_value && range.m_low->m_inclusive && range.m_high->m_inclusive;
+}
+
+//! @brief binding of one statement against the FROM tables
+class Binder
+{
+public:
+    Binder(std::vector<std::string> names, std::vector<const Table*> tables, std::string& error)
+        : m_names(std::move(names))
+        , m_tables(std::move(tables))
+        , m_error(error)
+    {
+    }
+
+    std::optional<ColumnRef> Resolve(const std::string& column)
+    {
+        std::optional<ColumnRef> found;
+        for (size_t table = 0; table < m_tables.size(); ++table)
+        {
+            const Schema& schema = m_tables[table]->GetSchema();
+            const std::optional<size_t> ordinal = schema.Ordinal(column);
+            if (!ordinal)
+            {
+                continue;
+            }
+            if (found)
+            {
+                m_error = fmt::format("column {} is ambiguous between {} and {}", column, m_names[found->m_table], m_names[table]);
+                return std::nullopt;
+            }
+            found = ColumnRef { table, *ordinal, schema.Columns()[*ordinal].m_type };
+        }
+        if (!found)
+        {
+            m_error = fmt::format("unknown column {}", column);
+        }
+        return found;
+    }
+
+    //! @brief resolve and type check condition, adding the slots of the tables it reads to slots
+    std::unique_ptr<BoundCondition> Bind(const Condition& condition, std::vector<bool>& slots)
+    {
+        auto bound = std::make_unique<BoundCondition>();
+        bound->m_kind = condition.m_kind;
+        if (condition.m_kind == Condition::Kind::kCompare)
+        {
+            const std::optional<ColumnRef> column = Resolve(condition.m_column);
+            if (!column)
+            {
+                return nullptr;
+            }
+            const bool integer = std::holds_alternative<int64_t>(condition.m_value);
+            if (integer != (column->m_type == ColumnType::kInt64))
+            {
+                m_error = fmt::format("column {} is {} but is compared with {}", condition.m_column, integer ? "not an integer" : "an integer",
+                                      FormatValue(condition.m_value));
+                return nullptr;
+            }
+            bound->m_column = *column;
+            bound->m_op = condition.m_op;
+            bound->m_value = condition.m_value;
+            bound->m_text = fmt::format("{} {} {}", condition.m_column, FormatOp(condition.m_op), FormatValue(condition.m_value));
+            slots[column->m_table] = true;
+            return bound;
+        }
+
+        bound->m_left = Bind(*condition.m_left, slots);
+        if (!bound->m_left)
+        {
+            return nullptr;
+        }
+        if (condition.m_kind == Condition::Kind::kNot)
+        {
+            bound->m_text = "NOT " + bound->m_left->m_text;
+            return bound;
+        }
+        bound->m_right = Bind(*condition.m_right, slots);
+        if (!bound->m_right)
+        {
+            return nullptr;
+        }
+        const char* keyword = condition.m_kind == Condition::Kind::kAnd ? "AND" : "OR";
+        bound->m_text = fmt::format("{} {} {}", bound->m_left->m_text, keyword, bound->m_right->m_text);
+        return bound;
+    }
+
+    //! @brief the cheapest way to read a table under the conjuncts that read only that table
+    //!
+    //! Comparisons on a single-column primary key, or equalities on the leading columns of a
+    //! composite one, pick the primary index. Without them, those on an indexed column pick its
+    //! secondary index, preferring a column compared for equality.
+    std::unique_ptr<Operator> AccessPath(size_t slot, std::vector<std::unique_ptr<BoundCondition>> conjuncts)
+    {
+        const Table& table = *m_tables[slot];
+        const std::vector<size_t>& key_ordinals = table.GetSchema().PrimaryKeyOrdinals();
+        const std::optional<size_t> key_ordinal = key_ordinals.size() == 1 ? std::optional<size_t>(key_ordinals.front()) : std::nullopt;
+
+        // the range each indexed column is narrowed to, and the column each conjunct narrows
+        std::map<size_t, KeyRange> ranges;
+        std::vector<std::optional<size_t>> narrowed(conjuncts.size());
+        // the same for the columns of a composite key, by their position in the key
+        std::vector<KeyRange> key_ranges(key_ordinal ? 0 : key_ordinals.size());
+        std::vector<std::optional<size_t>> key_parts(conjuncts.size());
+        for (size_t i = 0; i < conjuncts.size(); ++i)
+        {
+            const BoundCondition* compare = conjuncts[i].get();
+            const bool negated = compare->m_kind == Condition::Kind::kNot;
+            if (negated)
+            {
+                compare = compare->m_left.get();
+            }
+            if (compare->m_kind != Condition::Kind::kCompare)
+            {
+                continue;
+            }
+            const size_t ordinal = compare->m_column.m_ordinal;
+            const CompareOp op = negated ? Negate(compare->m_op) : compare->m_op;
+            if ((ordinal == key_ordinal || table.HasIndex(ordinal)) && op != CompareOp::kNotEqual)
+            {
+                Narrow(ranges[ordinal], op, compare->m_value);
+                narrowed[i] = ordinal;
+            }
+            const auto part = std::find(key_ordinals.begin(), key_ordinals.end(), ordinal);
+            if (!key_ranges.empty() && part != key_ordinals.end() && op != CompareOp::kNotEqual)
+            {
+                key_parts[i] = static_cast<size_t>(part - key_ordinals.begin());
+                Narrow(key_ranges[*key_parts[i]], op, compare->m_value);
+            }
+        }
+
+        // a composite key narrows to the keys that start with its leading columns compared for equality
+        std::vector<Value> prefix;
+        while (prefix.size() < key_ranges.size() && IsPoint(key_ranges[prefix.size()]))
+        {
+            prefix.push_back(key_ranges[prefix.size()].m_low->m_value);
+        }
+        if (!prefix.empty())
+        {
+            std::vector<std::unique_ptr<BoundCondition>> residual;
+            for (size_t i = 0; i < conjuncts.size(); ++i)
+            {
+                if (!key_parts[i] || *key_parts[i] >= prefix.size())
+                {
+                    residual.push_back(std::move(conjuncts[i]));
+                }
+            }
+            return WithFilter(PrefixScan(slot, prefix, key_ranges.size()), std::move(residual));
+        }
+
+        std::optional<size_t> chosen;
+        if (key_ordinal && ranges.count(*key_ordinal) != 0)
+        {
+            chosen = key_ordinal;
+        }
+        for (const auto& [ordinal, range] : ranges)
+        {
+            if (!chosen || (*chosen != key_ordinal && IsPoint(range) && !IsPoint(ranges.at(*chosen))))
+            {
+                chosen = ordinal;
+            }
+        }
+
+        std::vector<std::unique_ptr<BoundCondition>> residual;
+        for (size_t i = 0; i < conjuncts.size(); ++i)
+        {
+            if (!chosen || narrowed[i] != chosen)
+            {
+                residual.push_back(std::move(conjuncts[i]));
+            }
+        }
+
+        std::unique_ptr<Operator> scan;
+        if (chosen)
+        {
+            scan = RangeScan(slot, *chosen, ranges.at(*chosen), chosen == key_ordinal);
+        }
+        else
+        {
+            scan = std::make_unique<KeyRangeScan>(table, slot, m_tables.size(), std::string(), std::string(), fmt::format("full scan {}", m_names[slot]));
+        }
+        return WithFilter(std::move(scan), std::move(residual));
+    }
+
+    //! @brief read the rows of slot whose value of ordinal is in range, through the primary index
+    //! if primary and else through the column's secondary index
+    std::unique_ptr<Operator> RangeScan(size_t slot, size_t ordinal, const KeyRange& range, bool primary)
+    {
+        const Table& table = *m_tables[slot];
+        const std::string& name = m_names[slot];
+        // a secondary index is named after its column too
+        const std::string index = primary ? name : fmt::format("{}.{}", name, table.GetSchema().Columns()[ordinal].m_name);
+        const char* kind = primary ? "key" : "index";
+        const std::optional<KeyBound>& low = range.m_low;
+        const std::optional<KeyBound>& high = range.m_high;
+        if (low && high && (high->m_value < low->m_value || (low->m_value == high->m_value && !(low->m_inclusive && high->m_inclusive))))
+        {
+            return std::make_unique<EmptyScan>(fmt::format("empty scan {}", name));
+        }
+        if (IsPoint(range))
+        {
+            const std::string description = fmt::format("{} lookup {} {}", kind, index, FormatValue(low->m_value));
+            if (primary)
+            {
+                return std::make_unique<KeyLookup>(table, slot, m_tables.size(), EncodeKey(low->m_value), description);
+            }
+            const std::string key = EncodeKey(low->m_value);
+            return std::make_unique<IndexScan>(table, slot, m_tables.size(), ordinal, key, NextKey(key), description);
+        }
+
+        std::string start = low ? EncodeKey(low->m_value) : std::string();
+        if (low && !low->m_inclusive)
+        {
+            start = NextKey(std::move(start));
+        }
+        std::string end = high ? EncodeKey(high->m_value) : std::string();
+        if (high && high->m_inclusive)
+        {
+            end = NextKey(std::move(end));
+        }
+        // an empty end would mean unbounded, but only keys below the empty key are wanted
+        if (high && end.empty())
+        {
+            return std::make_unique<EmptyScan>(fmt::format("empty scan {}", name));
+        }
+        const std::string description = fmt::format("{} range {} {}{}, {}{}", kind, index, low && low->m_inclusive ? "[" : "(", low ? FormatValue(low->m_value) : "-inf",
+                                                    high ? FormatValue(high->m_value) : "+inf", high && high->m_inclusive ? "]" : ")");
+        if (primary)
+        {
+            return std::make_unique<KeyRangeScan>(table, slot, m_tables.size(), std::move(start), std::move(end), description);
+        }
+        return std::make_unique<IndexScan>(table, slot, m_tables.size(), ordinal, std::move(start), std::move(end), description);
+    }
+
+    //! @brief read the rows of slot whose composite key starts with values, through a key lookup if
+    //! values cover all width columns of the key
+    std::unique_ptr<Operator> PrefixScan(size_t slot, const std::vector<Value>& values, size_t width)
+    {
+        const Table& table = *m_tables[slot];
+        KeyEncoder encoder;
+        std::string text;
+        for (const Value& value : values)
+        {
+            AddKeyValue(encoder, value);
+            text += (text.empty() ? "" : ", ") + FormatValue(value);
+        }
+        if (values.size() == width)
+        {
+            return std::make_unique<KeyLookup>(table, slot, m_tables.size(), encoder.Finish(), fmt::format("key lookup {} ({})", m_names[slot], text));
+        }
+        // more values follow in every key, so a trailing string is escaped and terminated; a
+        // trailing empty value is what closes it
+        std::string start = encoder.AddString(std::string_view()).Finish();
+        std::string end = PrefixEnd(start);
+        return std::make_unique<KeyRangeScan>(table, slot, m_tables.size(), std::move(start), std::move(end), fmt::format("key prefix {} ({})", m_names[slot], text));
+    }
+
+    //! @brief put a HashAggregate on top of plan's operators and select the columns of its rows
+    bool Aggregate(const SelectStatement& statement, const AggregateOptions& options, Plan& plan)
+    {
+        if (statement.m_columns.empty())
+        {
+            m_error = "SELECT * cannot be grouped or aggregated";
+            return false;
+        }
+        std::vector<ColumnRef> groups;
+        for (const std::string& name : statement.m_group_by)
+        {
+            const std::optional<ColumnRef> column = Resolve(name);
+            if (!column)
+            {
+                return false;
+            }
+            groups.push_back(*column);
+        }
+
+        // the output rows hold the group-by columns and then the aggregates
+        std::vector<BoundAggregate> aggregates;
+        for (size_t i = 0; i < statement.m_columns.size(); ++i)
+        {
+            const std::string& name = statement.m_columns[i];
+            const AggregateFunction function = statement.m_aggregates[i];
+            std::optional<ColumnRef> column;
+            if (name != "*")
+            {
+                column = Resolve(name);
+                if (!column)
+                {
+                    return false;
+                }
+            }
+            if (function == AggregateFunction::kNone)
+            {
+                const auto grouped = std::find_if(groups.begin(), groups.end(), [&](const ColumnRef& group) {
+                    return group.m_table == column->m_table && group.m_ordinal == column->m_ordinal;
+                });
+                if (grouped == groups.end())
+                {
+                    m_error = fmt::format("column {} is neither grouped by nor aggregated", name);
+                    return false;
+                }
+                plan.m_column_names.push_back(name);
+                plan.m_columns.push_back(ColumnRef { 0, static_cast<size_t>(grouped - groups.begin()), column->m_type });
+                continue;
+            }
+            if (function == AggregateFunction::kSum && column->m_type != ColumnType::kInt64)
+            {
+                m_error = fmt::format("column {} is not an integer and cannot be summed", name);
+                return false;
+            }
+            const bool integer = function == AggregateFunction::kCount || function == AggregateFunction::kSum;
+            BoundAggregate aggregate { function, column, fmt::format("{}({})", FormatFunction(function), name) };
+            plan.m_column_names.push_back(aggregate.m_text);
+            plan.m_columns.push_back(ColumnRef { 0, groups.size() + aggregates.size(), integer ? ColumnType::kInt64 : column->m_type });
+            aggregates.push_back(std::move(aggregate));
+        }
+        plan.m_root = std::make_unique<HashAggregate>(std::move(plan.m_root), std::move(groups), statement.m_group_by, std::move(aggregates), options);
+        return true;
+    }
+
+    //! @brief child filtered by the AND of conditions, child itself without conditions
+    static std::unique_ptr<Operator> WithFilter(std::unique_ptr<Operator> child, std::vector<std::unique_ptr<BoundCondition>> conditions)
+    {
+        if (conditions.empty())
+        {
+            return child;
+        }
+        std::unique_ptr<BoundCondition> combined = std::move(conditions.front());
+        for (size_t i = 1; i < conditions.size(); ++i)
+        {
+            auto both = std::make_unique<BoundCondition>();
+            both->m_kind = Condition::Kind::kAnd;
+            both->m_text = combined->m_text + " AND " + conditions[i]->m_text;
+            both->m_left = std::move(combined);
+            both->m_right = std::move(conditions[i]);
+            combined = std::move(both);
+        }
+        return std::make_unique<Filter>(std::move(child), std::move(combined));
+    }
+
+private:
+    std::vector<std::string> m_names;
+    std::vector<const Table*> m_tables;
+    std::string& m_error;
+};
+
+void SplitConjuncts(const Condition& condition, std::vector<const Condition*>& conjuncts)
+{
+    if (condition.m_kind == Condition::Kind::kAnd)
+    {
+        SplitConjuncts(*condition.m_left, conjuncts);
+        SplitConjuncts(*condition.m_right, conjuncts);
+        return;
+    }
+    conjuncts.push_back(&condition);
+}
+}  // namespace
+
+std::optional<Plan> Planner::Build(const SelectStatement& statement, const TableCatalog& tables, const AggregateOptions& options, std::string& error)
+{
+    std::vector<const Table*> from;
+    for (const std::string& name : statement.m_tables)
+    {
+        const auto it = tables.find(name);
+        if (it == tables.end())
+        {
+            error = fmt::format("unknown table {}", name);
+            return std::nullopt;
+        }
+        from.push_back(it->second);
+    }
+    Binder binder(statement.m_tables, from, error);
+
+    // an aggregate's output columns are selected once its operator is built
+    const bool aggregated = !statement.m_group_by.empty() ||
+                            std::any_of(statement.m_aggregates.begin(), statement.m_aggregates.end(),
+                                        [](AggregateFunction function) { return function != AggregateFunction::kNone; });
+    Plan plan;
+    if (statement.m_columns.empty() && !aggregated)
+    {
+        for (size_t table = 0; table < from.size(); ++table)
+        {
+            const std::vector<Column>& columns = from[table]->GetSchema().Columns();
+            for (size_t ordinal = 0; ordinal < columns.size(); ++ordinal)
+            {
+                plan.m_column_names.push_back(columns[ordinal].m_name);
+                plan.m_columns.push_back(ColumnRef { table, ordinal, columns[ordinal].m_type });
+            }
+        }
+    }
+    for (size_t i = 0; i < statement.m_columns.size() && !aggregated; ++i)
+    {
+        const std::string& name = statement.m_columns[i];
+        const std::optional<ColumnRef> column = binder.Resolve(name);
+        if (!column)
+        {
+            return std::nullopt;
+        }
+        plan.m_column_names.push_back(name);
+        plan.m_columns.push_back(*column);
+    }
+
+    std::vector<const Condition*> conjuncts;
+    if (statement.m_where)
+    {
+        SplitConjuncts(*statement.m_where, conjuncts);
+    }
+    // conjuncts reading one table go below the join, the rest above it
+    std::vector<std::vector<std::unique_ptr<BoundCondition>>> per_table(from.size());
+    std::vector<std::unique_ptr<BoundCondition>> joined;
+    for (const Condition* conjunct : conjuncts)
+    {
+        std::vector<bool> slots(from.size(), false);
+        std::unique_ptr<BoundCondition> bound = binder.Bind(*conjunct, slots);
+        if (!bound)
+        {
+            return std::nullopt;
+        }
+        size_t read = 0;
+        size_t last = 0;
+        for (size_t slot = 0; slot < slots.size(); ++slot)
+        {
+            if (slots[slot])
+            {
+                ++read;
+                last = slot;
+            }
+        }
+        if (read == 1)
+        {
+            per_table[last].push_back(std::move(bound));
+        }
+        else
+        {
+            joined.push_back(std::move(bound));
+        }
+    }
+
+    plan.m_root = binder.AccessPath(0, std::move(per_table[0]));
+    for (size_t slot = 1; slot < from.size(); ++slot)
+    {
+        plan.m_root = std::make_unique<CrossJoin>(std::move(plan.m_root), binder.AccessPath(slot, std::move(per_table[slot])), slot);
+    }
+    plan.m_root = Binder::WithFilter(std::move(plan.m_root), std::move(joined));
+    if (aggregated && !binder.Aggregate(statement, options, plan))
+    {
+        return std::nullopt;
+    }
+    return plan;
+}
@@ -0,0 +1,46 @@
+#ifndef FOODB_SQL_PLANNER_H_
+#define FOODB_SQL_PLANNER_H_
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "catalog/table.h"
+#include "sql/ast.h"
+#include "sql/operators.h"
+
+//! @brief the tables queries can name, by their SQL name
+using TableCatalog = std::unordered_map<std::string, const Table*>;
+
+//! @brief a bound SELECT: the operator tree and the columns to read from each of its tuples
+struct Plan
+{
+    std::unique_ptr<Operator> m_root;
+    std::vector<std::string> m_column_names;
+    std::vector<ColumnRef> m_columns;
+};
+
+//! @brief binds a SELECT to tables and chooses how to read each of them
+//!
+//! The WHERE condition is split at its top-level ANDs. Comparisons on a single-column primary
+//! key, other than !=, narrow that table to a key lookup or a key range scan of the primary
+//! index. Equalities on the leading columns of a composite primary key narrow it to a key
+//! lookup if they cover the whole key, else to a scan of the keys starting with those values;
+//! other comparisons on its columns are filtered. Without them, comparisons on a column with a
+//! secondary index narrow the table to a scan of that index; a table without either is scanned
+//! in full. Every other comparison is filtered per row, next to its table when it reads only
+//! one table, else above the join.
+//!
+//! With GROUP BY or an aggregate in the select list, a HashAggregate over the filtered rows
+//! computes the groups, and every selected column is either grouped by or aggregated.
+class Planner
+{
+public:
+    //! @brief nullopt, with a message in error, for unknown or ambiguous names, type mismatches
+    //! and columns selected next to aggregates that are not grouped by
+    static std::optional<Plan> Build(const SelectStatement& statement, const TableCatalog& tables, const AggregateOptions& options, std::string& error);
+};
+
+#endif
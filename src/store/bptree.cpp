@@ -4,76 +4,390 @@
 #include <array>
 #include <cassert>
 #include <cstring>
-#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <mutex>
+#include <shared_mutex>
 #include <stdexcept>
 #include <utility>
 
 #include <fmt/format.h>
 
-BPTree::BPTree(std::string filename, size_t node_size)
+BPTree::BPTree(std::string filename, size_t node_size, BPTreeOptions options)
     : m_file(std::move(filename))
+    , m_page_size(options.m_page_size)
+    , m_mmap_reads(options.m_mmap_reads)
     , m_record_max_size(node_size)
-    , m_root(nullptr)
+    , m_root_page_id(0)
     , m_next_page_id(1)
+    , m_free_page_id(0)
+    , m_pool(options.m_frame_budget, [this](uint64_t page_id) { return LoadNodePage(page_id); }, [this](const Node* node) { return WriteBackPage(node); })
     , m_meta_dirty(false)
+    , m_in_batch(false)
+    , m_wal(options.m_wal)
+    , m_wal_file_id(options.m_wal_file_id)
+    , m_meta_unlogged(false)
+    , m_meta_lsn(0)
+    , m_staged_lsn(0)
 {
+    if (!ValidPageSize(m_page_size))
+    {
+        throw std::invalid_argument("bptree page size must be a power of two from 4 KB to 64 KB");
+    }
+    // a node size of 0 is taken from an existing file, or derived for a new one
+    if (!LoadFromDisk() && m_record_max_size == 0)
+    {
+        m_record_max_size = FanOut(m_page_size, options.m_key_width, options.m_value_width);
+    }
     assert(m_record_max_size >= 2);
-    LoadFromDisk();
 }
 
 BPTree::~BPTree()
 {
     FlushDirtyPages();
-    DeleteAllNodes();
 }
 
 bool BPTree::Insert(const std::string& key, const void* value, size_t size)
 {
     assert(!key.empty() && "Insert: key is empty.");
     assert(value && "Insert: value is nullptr.");
+    if (key.size() > MaxKeySize())
+    {
+        return false;
+    }
+
+    if (std::optional<bool> inserted = InsertIntoSafeLeaf(key, value, size))
+    {
+        return *inserted;
+    }
+    std::unique_lock<std::shared_mutex> tree(m_tree_latch);
+    return InsertExclusive(key, value, size);
+}
+
+bool BPTree::Erase(const std::string& key)
+{
+    if (key.empty())
+    {
+        return false;
+    }
+    if (std::optional<bool> erased = EraseFromSafeLeaf(key))
+    {
+        return *erased;
+    }
+    std::unique_lock<std::shared_mutex> tree(m_tree_latch);
+    return EraseExclusive(key);
+}
+
+std::optional<bool> BPTree::InsertIntoSafeLeaf(const std::string& key, const void* value, size_t size)
+{
+    std::shared_lock<std::shared_mutex> tree(m_tree_latch);
+    Node* leaf = m_root_page_id == 0 ? nullptr : LatchLeaf(key, true);
+    if (!leaf)
+    {
+        return std::nullopt;
+    }
+
+    // an inline value that keeps the leaf within the node size and its page never splits;
+    // overflow pages are only allocated and freed under the exclusive tree latch
+    const size_t pos = leaf->FindPos(key);
+    const bool replaces = pos < leaf->GetSize() && leaf->m_keys[pos] == key;
+    bool safe = size <= MaxInlineValue();
+    if (safe && replaces)
+    {
+        safe = !IsOverflow(leaf->m_values[pos]) && NodeBytes(leaf) - leaf->m_values[pos].size() + size + 1 <= m_page_size;
+    }
+    else if (safe)
+    {
+        // a key added at either end can shorten the prefix the leaf's keys share
+        const KeyArray& keys = leaf->m_keys;
+        const std::string_view front = pos == 0 ? std::string_view(key) : keys.Front();
+        const std::string_view back = pos == keys.Size() ? std::string_view(key) : keys.Back();
+        const size_t bytes = kNodeHeaderSize + KeyBytes(keys.Size() + 1, keys.ByteSize() + key.size(), front, back) + PayloadBytes(leaf);
+        safe = leaf->GetSize() < m_record_max_size && bytes + sizeof(uint32_t) + size + 1 <= m_page_size;
+    }
+    if (safe)
+    {
+        AddRecord(leaf, key, value, size);
+    }
+    leaf->m_latch.unlock();
+    m_pool.Unpin(leaf);
+    if (!safe)
+    {
+        return std::nullopt;
+    }
+    return m_in_batch || FlushDirtyPages();
+}
+
+std::optional<bool> BPTree::EraseFromSafeLeaf(const std::string& key)
+{
+    std::shared_lock<std::shared_mutex> tree(m_tree_latch);
+    if (m_root_page_id == 0)
+    {
+        return false;
+    }
+    Node* leaf = LatchLeaf(key, true);
+    if (!leaf)
+    {
+        return std::nullopt;
+    }
+
+    const size_t pos = leaf->FindPos(key);
+    if (pos >= leaf->GetSize() || leaf->m_keys[pos] != key)
+    {
+        leaf->m_latch.unlock();
+        m_pool.Unpin(leaf);
+        return false;
+    }
+
+    // a leaf left full enough, or a root leaf left non-empty, needs no rebalancing
+    bool safe = !IsOverflow(leaf->m_values[pos]);
+    if (safe && leaf->m_page_id == m_root_page_id)
+    {
+        safe = leaf->GetSize() > 1;
+    }
+    else if (safe)
+    {
+        safe = leaf->GetSize() > MinKeys(leaf) || NodeBytesWithout(leaf, pos) >= m_page_size / 2;
+    }
+    if (safe)
+    {
+        leaf->m_keys.Erase(pos, pos + 1);
+        leaf->m_values.erase(leaf->m_values.begin() + static_cast<std::ptrdiff_t>(pos));
+        MarkDirty(leaf);
+    }
+    leaf->m_latch.unlock();
+    m_pool.Unpin(leaf);
+    if (!safe)
+    {
+        return std::nullopt;
+    }
+    return m_in_batch || FlushDirtyPages();
+}
 
-    if (!m_root)
+bool BPTree::InsertExclusive(const std::string& key, const void* value, size_t size)
+{
+    if (m_root_page_id == 0)
     {
-        m_root = CreateNode(true);
-        m_root->m_keys.emplace_back(key);
-        m_root->m_values.emplace_back(static_cast<const char*>(value), size);
-        MarkDirty(m_root);
-        return FlushDirtyPages();
+        Node* root = CreateNode(true);
+        root->m_keys.PushBack(key);
+        root->m_values.push_back(StoreValue(std::string(static_cast<const char*>(value), size)));
+        m_root_page_id = root->m_page_id;
+        m_pool.Unpin(root);
+        return m_in_batch || FlushDirtyPages();
     }
 
-    auto [cursor, parent] = FindLeaf(key);
+    std::vector<Node*> path;
+    Node* cursor = FindLeaf(key, &path);
     AddRecord(cursor, key, value, size);
-    if (cursor->GetSize() <= m_record_max_size)
+    if (Overfull(cursor))
     {
-        return FlushDirtyPages();
+        Node* new_leaf_node = SplitLeafNode(cursor);
+        InsertInternal(Separator(cursor->m_keys.Back(), new_leaf_node->m_keys.Front()), path, cursor->m_page_id, new_leaf_node->m_page_id);
+        m_pool.Unpin(new_leaf_node);
     }
 
-    Node* new_leaf_node = SplitLeafNode(cursor);
-    if (parent)
+    m_pool.Unpin(cursor);
+    UnpinAll(path);
+    return m_in_batch || FlushDirtyPages();
+}
+
+bool BPTree::EraseExclusive(const std::string& key)
+{
+    if (m_root_page_id == 0)
     {
-        InsertInternal(new_leaf_node->m_keys.front(), parent, new_leaf_node);
+        return false;
     }
-    else
+
+    std::vector<Node*> path;
+    Node* leaf = FindLeaf(key, &path);
+    const size_t pos = leaf->FindPos(key);
+    if (pos >= leaf->GetSize() || leaf->m_keys[pos] != key)
     {
-        Node* new_root = CreateNode(false);
-        new_root->m_keys.push_back(new_leaf_node->m_keys.front());
-        new_root->m_children.push_back(cursor);
-        new_root->m_children.push_back(new_leaf_node);
-        cursor->m_parent_page_id = new_root->m_page_id;
-        new_leaf_node->m_parent_page_id = new_root->m_page_id;
-        MarkDirty(cursor);
-        MarkDirty(new_leaf_node);
-        MarkDirty(new_root);
-        m_root = new_root;
-        m_meta_dirty = true;
+        m_pool.Unpin(leaf);
+        UnpinAll(path);
+        return false;
+    }
+
+    FreeValue(leaf->m_values[pos]);
+    leaf->m_keys.Erase(pos, pos + 1);
+    leaf->m_values.erase(leaf->m_values.begin() + static_cast<std::ptrdiff_t>(pos));
+    MarkDirty(leaf);
+
+    path.push_back(leaf);
+    Rebalance(path);
+    for (Node* node : path)
+    {
+        if (node)
+        {
+            m_pool.Unpin(node);
+        }
     }
+    return m_in_batch || FlushDirtyPages();
+}
+
+void BPTree::BeginBatch()
+{
+    std::unique_lock<std::shared_mutex> tree(m_tree_latch);
+    m_in_batch = true;
+}
 
+bool BPTree::Commit()
+{
+    std::unique_lock<std::shared_mutex> tree(m_tree_latch);
+    m_in_batch = false;
     return FlushDirtyPages();
 }
 
+bool BPTree::LogBatch()
+{
+    assert(m_wal && "LogBatch: the tree has no log.");
+    std::unique_lock<std::shared_mutex> tree(m_tree_latch);
+    m_in_batch = false;
+    return LogDirtyPages(false);
+}
+
+bool BPTree::BulkLoad(std::vector<Record> records, double fill_factor)
+{
+    assert(fill_factor > 0.0 && fill_factor <= 1.0 && "BulkLoad: invalid fill factor.");
+    std::unique_lock<std::shared_mutex> tree(m_tree_latch);
+    const auto key_less = [](const Record& lhs, const Record& rhs) { return lhs.first < rhs.first; };
+    if (!std::is_sorted(records.begin(), records.end(), key_less))
+    {
+        std::stable_sort(records.begin(), records.end(), key_less);
+    }
+    // keep the last record of every run of equal keys
+    auto last = std::unique(records.rbegin(), records.rend(), [](const Record& lhs, const Record& rhs) { return lhs.first == rhs.first; });
+    records.erase(records.begin(), last.base());
+    const auto long_key = [this](const Record& record) { return record.first.size() > MaxKeySize(); };
+    if (std::any_of(records.begin(), records.end(), long_key))
+    {
+        return false;
+    }
+
+    m_pool.Clear();
+    m_in_batch = false;
+    m_root_page_id = 0;
+    m_next_page_id = 1;
+    m_free_page_id = 0;
+    m_freed_pages.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_overflow_mutex);
+        m_pending_overflow.clear();
+    }
+    if (!OpenStorage() || !m_storage.Truncate(0))
+    {
+        return false;
+    }
+
+    // overflow chains take the first pages so that leaves, and then every internal level, stay contiguous;
+    // running sums of key and value bytes give the exact page size of any run of records
+    std::vector<size_t> key_sums(1, 0);
+    std::vector<size_t> payload_sums(1, 0);
+    for (Record& record : records)
+    {
+        record.second = StoreValue(std::move(record.second));
+        key_sums.push_back(key_sums.back() + record.first.size());
+        payload_sums.push_back(payload_sums.back() + sizeof(uint32_t) + record.second.size());
+    }
+    if (!WriteOverflowPages())
+    {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_unlogged_mutex);
+        m_unlogged_pages.clear();
+    }
+    m_staged_pages.clear();
+    m_meta_unlogged = false;
+
+    const size_t per_node = std::max<size_t>(1, static_cast<size_t>(static_cast<double>(m_record_max_size) * fill_factor));
+    const size_t byte_budget = static_cast<size_t>(static_cast<double>(m_page_size) * fill_factor);
+    // (separator from the node before, page id) of every node on the level being built
+    std::vector<std::pair<std::string, uint64_t>> level;
+
+    const auto leaf_fits = [&](size_t begin, size_t count) {
+        const size_t end = begin + count;
+        const size_t key_bytes = KeyBytes(count, key_sums[end] - key_sums[begin], records[begin].first, records[end - 1].first);
+        return kNodeHeaderSize + key_bytes + payload_sums[end] - payload_sums[begin] <= byte_budget;
+    };
+    size_t record_index = 0;
+    const std::vector<size_t> leaf_sizes = PlanLevel(records.size(), per_node, 1, leaf_fits);
+    for (size_t leaf_index = 0; leaf_index < leaf_sizes.size(); ++leaf_index)
+    {
+        Node leaf(true, m_record_max_size, m_next_page_id++);
+        leaf.m_next_leaf = leaf_index + 1 < leaf_sizes.size() ? m_next_page_id : 0;
+        leaf.m_prev_leaf = leaf_index > 0 ? leaf.m_page_id - 1 : 0;
+        leaf.m_keys.Reserve(leaf_sizes[leaf_index], 0);
+        leaf.m_values.reserve(leaf_sizes[leaf_index]);
+        std::string separator = record_index == 0 ? std::string() : Separator(records[record_index - 1].first, records[record_index].first);
+        for (size_t i = 0; i < leaf_sizes[leaf_index]; ++i, ++record_index)
+        {
+            leaf.m_keys.PushBack(records[record_index].first);
+            leaf.m_values.push_back(std::move(records[record_index].second));
+        }
+        if (!WriteNodePage(&leaf))
+        {
+            return false;
+        }
+        level.emplace_back(std::move(separator), leaf.m_page_id);
+    }
+
+    while (level.size() > 1)
+    {
+        std::vector<std::pair<std::string, uint64_t>> parents;
+        key_sums.assign(1, 0);
+        for (const auto& [separator, page_id] : level)
+        {
+            (void) page_id;
+            key_sums.push_back(key_sums.back() + separator.size());
+        }
+        // a node keeps the separators of all but its first child
+        const auto internal_fits = [&](size_t begin, size_t count) {
+            const size_t end = begin + count;
+            const size_t key_bytes = count == 1 ? KeyBytes(0, 0, {}, {}) : KeyBytes(count - 1, key_sums[end] - key_sums[begin + 1], level[begin + 1].first, level[end - 1].first);
+            return kNodeHeaderSize + key_bytes + sizeof(uint32_t) + sizeof(uint64_t) * count <= byte_budget;
+        };
+        size_t child_index = 0;
+        for (size_t child_count : PlanLevel(level.size(), per_node + 1, 2, internal_fits))
+        {
+            Node internal(false, m_record_max_size, m_next_page_id++);
+            internal.m_children.reserve(child_count);
+            for (size_t i = 0; i < child_count; ++i, ++child_index)
+            {
+                if (i > 0)
+                {
+                    internal.m_keys.PushBack(level[child_index].first);
+                }
+                internal.m_children.push_back(level[child_index].second);
+            }
+            if (!WriteNodePage(&internal))
+            {
+                return false;
+            }
+            parents.emplace_back(std::move(level[child_index - child_count].first), internal.m_page_id);
+        }
+        level = std::move(parents);
+    }
+
+    m_root_page_id = level.empty() ? 0 : level.front().second;
+    m_meta_dirty = false;
+    return WriteMetaPage() && (!m_wal || m_storage.Sync());
+}
+
+bool BPTree::Checkpoint()
+{
+    std::unique_lock<std::shared_mutex> tree(m_tree_latch);
+    assert(!m_in_batch && "Checkpoint: commit the batch first.");
+    if (!FlushDirtyPages() || (m_wal && !WriteDirtyPages()))
+    {
+        return false;
+    }
+    return !m_storage.IsOpen() || m_storage.Sync();
+}
+
 void BPTree::Traverse(Node* node)
 {
-    assert(m_root && "Tree is empty.");
+    assert(m_root_page_id != 0 && "Tree is empty.");
     assert(node && "Traverse: traverse from an empty node.");
     node->m_is_leaf ? TraverseLeaf(node) : TraverseIndex(node);
 }
@@ -82,9 +396,13 @@ void BPTree::TraverseLeaf(Node* leaf_node)
 {
     assert(leaf_node && leaf_node->m_is_leaf && "nullptr or isn't leaf");
     fmt::println("leaf node, size = {}", leaf_node->GetSize());
-    for (size_t i = 0; i < leaf_node->m_values.size(); ++i)
+    std::string value;
+    for (const std::string& stored : leaf_node->m_values)
     {
-        fmt::println("{}", leaf_node->m_values[i]);
+        if (ReadValue(stored, value))
+        {
+            fmt::println("{}", value);
+        }
     }
 }
 
@@ -92,347 +410,1553 @@ void BPTree::TraverseIndex(Node* index_node)
 {
     assert(index_node && !index_node->m_is_leaf && "nullptr or isn't index");
     fmt::println("traverse index, size={}", index_node->GetSize());
-    for (Node* child : index_node->m_children)
+    // copy the ids first: faulting children in may evict index_node itself
+    const std::vector<uint64_t> children = index_node->m_children;
+    for (uint64_t child_page_id : children)
     {
+        Node* child = m_pool.Fetch(child_page_id);
+        if (!child)
+        {
+            continue;
+        }
         Traverse(child);
+        m_pool.Unpin(child);
     }
 }
 
 std::optional<Data> BPTree::Search(const std::string& key) const
 {
+    // a writer may change the leaf as soon as its latch is released, so the value is copied out
+    thread_local std::string value;
     std::optional<Data> data;
-    if (key.empty() || !m_root)
+    if (key.empty())
     {
         return data;
     }
 
-    auto [leaf, _] = FindLeaf(key);
+    std::shared_lock<std::shared_mutex> tree(m_tree_latch);
+    Node* leaf = m_root_page_id == 0 ? nullptr : LatchLeaf(key, false);
     if (!leaf)
     {
         return data;
     }
 
-    for (size_t i = 0; i < leaf->m_keys.size(); ++i)
+    const size_t pos = leaf->FindPos(key);
+    if (pos < leaf->GetSize() && leaf->m_keys[pos] == key && ReadValue(leaf->m_values[pos], value))
+    {
+        Data record;
+        record.m_data_size = value.size();
+        record.m_data = value.data();
+        data = record;
+    }
+    leaf->m_latch.unlock_shared();
+    m_pool.Unpin(leaf);
+    return data;
+}
+
+BPTree::Handle BPTree::Get(const std::string& key) const
+{
+    return MultiGet(std::vector<std::string> { key });
+}
+
+BPTree::Handle BPTree::MultiGet(const std::vector<std::string>& keys) const
+{
+    Handle handle;
+    handle.m_tree = this;
+    handle.m_tree_latch = std::shared_lock<std::shared_mutex>(m_tree_latch);
+    handle.m_values.resize(keys.size());
+    if (m_root_page_id == 0)
+    {
+        return handle;
+    }
+
+    std::vector<size_t> order(keys.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) { return keys[lhs] < keys[rhs]; });
+
+    Node* leaf = nullptr;
+    for (size_t index : order)
+    {
+        const std::string& key = keys[index];
+        if (key.empty())
+        {
+            continue;
+        }
+
+        // keys up to the last one of the current leaf are resolved without descending again
+        if (!leaf || (leaf->m_next_leaf != 0 && (leaf->GetSize() == 0 || key > leaf->m_keys.Back())))
+        {
+            Node* reached = LatchLeaf(key, false, leaf);
+            if (!reached)
+            {
+                continue;
+            }
+            if (reached != leaf)
+            {
+                handle.m_leaves.push_back(reached);
+                leaf = reached;
+            }
+        }
+
+        const size_t pos = leaf->FindPos(key);
+        if (pos >= leaf->GetSize() || leaf->m_keys[pos] != key)
+        {
+            continue;
+        }
+        const std::string& stored = leaf->m_values[pos];
+        if (!IsOverflow(stored))
+        {
+            handle.m_values[index] = InlineValue(stored);
+        }
+        else if (ReadValue(stored, handle.m_overflow_values.emplace_back()))
+        {
+            handle.m_values[index] = handle.m_overflow_values.back();
+        }
+    }
+    return handle;
+}
+
+BPTree::Cursor BPTree::Begin() const
+{
+    return Cursor(this, FindEdgeLeaf(true), 0);
+}
+
+BPTree::Cursor BPTree::Last() const
+{
+    Node* leaf = FindEdgeLeaf(false);
+    if (leaf && leaf->GetSize() == 0)
+    {
+        m_pool.Unpin(leaf);
+        return Cursor();
+    }
+    return Cursor(this, leaf, leaf ? leaf->GetSize() - 1 : 0);
+}
+
+BPTree::Cursor BPTree::LowerBound(const std::string& key) const
+{
+    if (m_root_page_id == 0)
+    {
+        return Cursor();
+    }
+    Node* leaf = FindLeaf(key, nullptr);
+    return Cursor(this, leaf, leaf ? leaf->FindPos(key) : 0);
+}
+
+BPTree::Cursor BPTree::UpperBound(const std::string& key) const
+{
+    if (m_root_page_id == 0)
+    {
+        return Cursor();
+    }
+    Node* leaf = FindLeaf(key, nullptr);
+    if (!leaf)
+    {
+        return Cursor();
+    }
+    size_t slot = leaf->FindPos(key);
+    if (slot < leaf->GetSize() && leaf->m_keys[slot] == key)
+    {
+        ++slot;
+    }
+    return Cursor(this, leaf, slot);
+}
+
+void BPTree::Scan(const std::string& start, const std::string& end, const Visitor& visitor) const
+{
+    VisitFrom(start, [&](std::string_view key, std::string_view value) { return (end.empty() || key < end) && visitor(key, value); });
+}
+
+void BPTree::ScanPrefix(const std::string& prefix, const Visitor& visitor) const
+{
+    VisitFrom(prefix, [&](std::string_view key, std::string_view value) { return key.substr(0, prefix.size()) == prefix && visitor(key, value); });
+}
+
+std::vector<std::string> BPTree::SplitKeys(size_t parts) const
+{
+    // internal nodes only change under the exclusive tree latch, so they need no node latches
+    std::shared_lock<std::shared_mutex> tree(m_tree_latch);
+    std::vector<std::string> keys;
+    std::vector<uint64_t> level;
+    if (m_root_page_id != 0)
+    {
+        level.push_back(m_root_page_id);
+    }
+    while (!level.empty() && level.size() < parts)
+    {
+        // the next level's separators: each node's own keys, and between two nodes the key
+        // that separates them one level up
+        std::vector<std::string> next_keys;
+        std::vector<uint64_t> next_level;
+        for (size_t i = 0; i < level.size(); ++i)
+        {
+            Node* node = m_pool.Fetch(level[i]);
+            if (!node || node->m_is_leaf)
+            {
+                if (node)
+                {
+                    m_pool.Unpin(node);
+                }
+                return keys;
+            }
+            if (i > 0)
+            {
+                next_keys.push_back(keys[i - 1]);
+            }
+            for (size_t k = 0; k < node->m_keys.Size(); ++k)
+            {
+                next_keys.emplace_back(node->m_keys[k]);
+            }
+            next_level.insert(next_level.end(), node->m_children.begin(), node->m_children.end());
+            m_pool.Unpin(node);
+        }
+        keys = std::move(next_keys);
+        level = std::move(next_level);
+    }
+    return keys;
+}
+
+BPTree::Cursor::Cursor(const BPTree* tree, Node* leaf, size_t slot)
+    : m_tree(tree)
+    , m_leaf(leaf)
+    , m_slot(slot)
+{
+    if (m_leaf && m_slot >= m_leaf->GetSize())
+    {
+        Move(m_leaf->m_next_leaf, true);
+    }
+}
+
+BPTree::Cursor::Cursor(Cursor&& other) noexcept
+    : m_tree(other.m_tree)
+    , m_leaf(other.m_leaf)
+    , m_slot(other.m_slot)
+{
+    other.m_leaf = nullptr;
+}
+
+BPTree::Cursor& BPTree::Cursor::operator=(Cursor&& other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+        m_tree = other.m_tree;
+        m_leaf = other.m_leaf;
+        m_slot = other.m_slot;
+        other.m_leaf = nullptr;
+    }
+    return *this;
+}
+
+BPTree::Cursor::~Cursor()
+{
+    Release();
+}
+
+bool BPTree::Cursor::Valid() const
+{
+    return m_leaf != nullptr;
+}
+
+void BPTree::Cursor::Next()
+{
+    assert(Valid() && "Next: cursor is invalid.");
+    if (++m_slot >= m_leaf->GetSize())
+    {
+        Move(m_leaf->m_next_leaf, true);
+    }
+}
+
+void BPTree::Cursor::Prev()
+{
+    assert(Valid() && "Prev: cursor is invalid.");
+    if (m_slot > 0)
+    {
+        --m_slot;
+        return;
+    }
+    Move(m_leaf->m_prev_leaf, false);
+}
+
+std::string_view BPTree::Cursor::Key() const
+{
+    assert(Valid() && "Key: cursor is invalid.");
+    return m_leaf->m_keys[m_slot];
+}
+
+std::string_view BPTree::Cursor::Value() const
+{
+    assert(Valid() && "Value: cursor is invalid.");
+    const std::string& stored = m_leaf->m_values[m_slot];
+    if (!IsOverflow(stored))
+    {
+        return InlineValue(stored);
+    }
+    return m_tree->ReadValue(stored, m_value) ? std::string_view(m_value) : std::string_view();
+}
+
+void BPTree::Cursor::Move(uint64_t page_id, bool forward)
+{
+    // skip over empty leaves until an entry is found or the chain ends
+    while (true)
     {
-        if (leaf->m_keys[i] == key)
+        Release();
+        m_leaf = m_tree->m_pool.Fetch(page_id);
+        if (!m_leaf || m_leaf->GetSize() > 0)
+        {
+            break;
+        }
+        page_id = forward ? m_leaf->m_next_leaf : m_leaf->m_prev_leaf;
+    }
+    if (m_leaf)
+    {
+        m_slot = forward ? 0 : m_leaf->GetSize() - 1;
+    }
+}
+
+void BPTree::Cursor::Release()
+{
+    if (m_leaf)
+    {
+        m_tree->m_pool.Unpin(m_leaf);
+        m_leaf = nullptr;
+    }
+}
+
+BPTree::Handle::Handle(Handle&& other) noexcept
+    : m_tree(other.m_tree)
+    , m_tree_latch(std::move(other.m_tree_latch))
+    , m_leaves(std::move(other.m_leaves))
+    , m_values(std::move(other.m_values))
+    , m_overflow_values(std::move(other.m_overflow_values))
+{
+    other.m_leaves.clear();
+    other.m_values.clear();
+    other.m_overflow_values.clear();
+}
+
+BPTree::Handle& BPTree::Handle::operator=(Handle&& other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+        m_tree = other.m_tree;
+        m_tree_latch = std::move(other.m_tree_latch);
+        m_leaves = std::move(other.m_leaves);
+        m_values = std::move(other.m_values);
+        m_overflow_values = std::move(other.m_overflow_values);
+        other.m_leaves.clear();
+        other.m_values.clear();
+        other.m_overflow_values.clear();
+    }
+    return *this;
+}
+
+BPTree::Handle::~Handle()
+{
+    Release();
+}
+
+BPTree::Handle::operator bool() const
+{
+    return Has(0);
+}
+
+size_t BPTree::Handle::Size() const
+{
+    return m_values.size();
+}
+
+bool BPTree::Handle::Has(size_t index) const
+{
+    return index < m_values.size() && m_values[index].has_value();
+}
+
+std::string_view BPTree::Handle::Value(size_t index) const
+{
+    assert(Has(index) && "Value: key was not found.");
+    return *m_values[index];
+}
+
+void BPTree::Handle::Release()
+{
+    for (Node* leaf : m_leaves)
+    {
+        leaf->m_latch.unlock_shared();
+        m_tree->m_pool.Unpin(leaf);
+    }
+    m_leaves.clear();
+    m_values.clear();
+    m_overflow_values.clear();
+    if (m_tree_latch.owns_lock())
+    {
+        m_tree_latch.unlock();
+    }
+}
+
+void BPTree::DeleteIndexNode(Node* node)
+{
+    std::unique_lock<std::shared_mutex> tree(m_tree_latch);
+    if (!node)
+    {
+        return;
+    }
+    DeleteNode(m_pool.Fetch(node->m_page_id));
+}
+
+Node* BPTree::GetRoot()
+{
+    Node* root = m_pool.Fetch(m_root_page_id);
+    if (root)
+    {
+        m_pool.Unpin(root);
+    }
+    return root;
+}
+
+size_t BPTree::CachedPages() const
+{
+    return m_pool.Size();
+}
+
+uint32_t BPTree::PageSize() const
+{
+    return m_page_size;
+}
+
+size_t BPTree::NodeSize() const
+{
+    return m_record_max_size;
+}
+
+size_t BPTree::FanOut(uint32_t page_size, size_t key_width, size_t value_width)
+{
+    // a leaf entry is a length-prefixed key and value, the value tagged or replaced by an overflow reference;
+    // keys are counted in full, as if they shared no prefix
+    const size_t stored_value = value_width <= page_size / 16 ? value_width + 1 : kOverflowRefSize;
+    const size_t entry = sizeof(uint16_t) + key_width + sizeof(uint32_t) + stored_value;
+    return std::max<size_t>(2, (page_size - kNodeHeaderSize - sizeof(uint16_t)) / entry);
+}
+
+bool BPTree::ValidPageSize(uint32_t page_size)
+{
+    return page_size >= kMinPageSize && page_size <= kMaxPageSize && (page_size & (page_size - 1)) == 0;
+}
+
+size_t BPTree::MaxKeySize() const
+{
+    return m_page_size / 4;
+}
+
+size_t BPTree::MaxInlineValue() const
+{
+    return m_page_size / 16;
+}
+
+size_t BPTree::OverflowCapacity() const
+{
+    return m_page_size - kOverflowHeaderSize;
+}
+
+Node* BPTree::CreateNode(bool is_leaf)
+{
+    Node* node = new Node(is_leaf, m_record_max_size, AllocatePageId());
+    m_pool.Put(node);
+    MarkDirty(node);
+    MarkMetaDirty();
+    return node;
+}
+
+uint64_t BPTree::AllocatePageId()
+{
+    if (m_free_page_id == 0)
+    {
+        return m_next_page_id++;
+    }
+
+    const uint64_t page_id = m_free_page_id;
+    auto it = m_freed_pages.find(page_id);
+    if (it != m_freed_pages.end())
+    {
+        m_free_page_id = it->second;
+        m_freed_pages.erase(it);
+    }
+    else
+    {
+        m_free_page_id = ReadFreePage(page_id);
+    }
+    MarkMetaDirty();
+    return page_id;
+}
+
+void BPTree::FreeNode(Node* node)
+{
+    const uint64_t page_id = node->m_page_id;
+    m_pool.Erase(page_id);
+    FreePage(page_id);
+}
+
+void BPTree::FreePage(uint64_t page_id)
+{
+    if (m_wal)
+    {
+        std::lock_guard<std::mutex> lock(m_unlogged_mutex);
+        ++m_unlogged_pages[page_id];
+    }
+    m_freed_pages[page_id] = m_free_page_id;
+    m_free_page_id = page_id;
+    MarkMetaDirty();
+}
+
+void BPTree::Rebalance(std::vector<Node*>& path)
+{
+    // path holds the pinned nodes from the root down to the node that lost a key;
+    // nodes freed by a merge are replaced with nullptr so the caller skips them
+    for (size_t level = path.size() - 1;; --level)
+    {
+        Node* node = path[level];
+        if (level == 0)
+        {
+            if (node->GetSize() == 0 && (node->m_is_leaf || node->m_children.size() == 1))
+            {
+                m_root_page_id = node->m_is_leaf ? 0 : node->m_children.front();
+                MarkMetaDirty();
+                FreeNode(node);
+                path[level] = nullptr;
+            }
+            return;
+        }
+
+        if (!Underfull(node))
+        {
+            return;
+        }
+
+        Node* parent = path[level - 1];
+        const size_t index = static_cast<size_t>(std::find(parent->m_children.begin(), parent->m_children.end(), node->m_page_id) - parent->m_children.begin());
+        assert(index < parent->m_children.size() && "Rebalance: node is not a child of its parent.");
+        Node* left = index > 0 ? m_pool.Fetch(parent->m_children[index - 1]) : nullptr;
+        Node* right = index + 1 < parent->m_children.size() ? m_pool.Fetch(parent->m_children[index + 1]) : nullptr;
+
+        // a node whose neighbours can neither lend nor take it in without outgrowing a page stays underfull
+        bool merged = false;
+        if (left && CanBorrow(node, left, parent, index, true))
+        {
+            BorrowFromLeft(node, left, parent, index);
+        }
+        else if (right && CanBorrow(node, right, parent, index, false))
+        {
+            BorrowFromRight(node, right, parent, index);
+        }
+        else if (left && CanMerge(left, node, parent, index))
+        {
+            MergeIntoLeft(left, node, parent, index);
+            path[level] = nullptr;
+            merged = true;
+        }
+        else if (right && CanMerge(node, right, parent, index + 1))
+        {
+            MergeIntoLeft(node, right, parent, index + 1);
+            right = nullptr;
+            merged = true;
+        }
+
+        if (left)
+        {
+            m_pool.Unpin(left);
+        }
+        if (right)
+        {
+            m_pool.Unpin(right);
+        }
+        if (!merged)
+        {
+            return;
+        }
+    }
+}
+
+void BPTree::BorrowFromLeft(Node* node, Node* left, Node* parent, size_t index)
+{
+    if (node->m_is_leaf)
+    {
+        node->m_keys.Insert(0, left->m_keys.Back());
+        node->m_values.insert(node->m_values.begin(), std::move(left->m_values.back()));
+        left->m_keys.Erase(left->GetSize() - 1, left->GetSize());
+        left->m_values.pop_back();
+        parent->m_keys.Set(index - 1, Separator(left->m_keys.Back(), node->m_keys.Front()));
+    }
+    else
+    {
+        node->m_keys.Insert(0, parent->m_keys[index - 1]);
+        node->m_children.insert(node->m_children.begin(), left->m_children.back());
+        parent->m_keys.Set(index - 1, left->m_keys.Back());
+        left->m_keys.Erase(left->GetSize() - 1, left->GetSize());
+        left->m_children.pop_back();
+    }
+    MarkDirty(node);
+    MarkDirty(left);
+    MarkDirty(parent);
+}
+
+void BPTree::BorrowFromRight(Node* node, Node* right, Node* parent, size_t index)
+{
+    if (node->m_is_leaf)
+    {
+        node->m_keys.PushBack(right->m_keys.Front());
+        node->m_values.push_back(std::move(right->m_values.front()));
+        right->m_keys.Erase(0, 1);
+        right->m_values.erase(right->m_values.begin());
+        parent->m_keys.Set(index, Separator(node->m_keys.Back(), right->m_keys.Front()));
+    }
+    else
+    {
+        node->m_keys.PushBack(parent->m_keys[index]);
+        node->m_children.push_back(right->m_children.front());
+        parent->m_keys.Set(index, right->m_keys.Front());
+        right->m_keys.Erase(0, 1);
+        right->m_children.erase(right->m_children.begin());
+    }
+    MarkDirty(node);
+    MarkDirty(right);
+    MarkDirty(parent);
+}
+
+void BPTree::MergeIntoLeft(Node* left, Node* node, Node* parent, size_t index)
+{
+    // node is parent->m_children[index] and is freed after moving into left
+    if (node->m_is_leaf)
+    {
+        for (size_t i = 0; i < node->GetSize(); ++i)
+        {
+            left->m_keys.PushBack(node->m_keys[i]);
+        }
+        std::move(node->m_values.begin(), node->m_values.end(), std::back_inserter(left->m_values));
+        left->m_next_leaf = node->m_next_leaf;
+        if (Node* next_leaf = m_pool.Fetch(node->m_next_leaf))
+        {
+            next_leaf->m_prev_leaf = left->m_page_id;
+            MarkDirty(next_leaf);
+            m_pool.Unpin(next_leaf);
+        }
+    }
+    else
+    {
+        left->m_keys.PushBack(parent->m_keys[index - 1]);
+        for (size_t i = 0; i < node->GetSize(); ++i)
+        {
+            left->m_keys.PushBack(node->m_keys[i]);
+        }
+        left->m_children.insert(left->m_children.end(), node->m_children.begin(), node->m_children.end());
+    }
+
+    parent->m_keys.Erase(index - 1, index);
+    parent->m_children.erase(parent->m_children.begin() + static_cast<std::ptrdiff_t>(index));
+    MarkDirty(left);
+    MarkDirty(parent);
+    FreeNode(node);
+}
+
+size_t BPTree::MinKeys(const Node* node) const
+{
+    // matches what a split by count leaves behind
+    return node->m_is_leaf ? m_record_max_size / 2 : std::max<size_t>(1, (m_record_max_size - 1) / 2);
+}
+
+bool BPTree::Underfull(const Node* node) const
+{
+    return node->GetSize() < MinKeys(node) && NodeBytes(node) < m_page_size / 2;
+}
+
+bool BPTree::Overfull(const Node* node) const
+{
+    return node->GetSize() > m_record_max_size || NodeBytes(node) > m_page_size;
+}
+
+bool BPTree::CanBorrow(const Node* node, const Node* sibling, const Node* parent, size_t index, bool from_left) const
+{
+    // the sibling has to stay full enough, and node and parent, whose separator changes, within their pages
+    if (sibling->GetSize() < 2)
+    {
+        return false;
+    }
+    const size_t lent = from_left ? sibling->GetSize() - 1 : 0;
+    if (sibling->GetSize() <= MinKeys(sibling) && NodeBytesWithout(sibling, lent) < m_page_size / 2)
+    {
+        return false;
+    }
+
+    // a leaf gains the lent entry, an internal node the separator and the lent child
+    const size_t separator = from_left ? index - 1 : index;
+    const KeyArray& lender = sibling->m_keys;
+    const std::string_view gained = node->m_is_leaf ? lender[lent] : parent->m_keys[separator];
+    const size_t gained_payload = node->m_is_leaf ? sizeof(uint32_t) + sibling->m_values[lent].size() : sizeof(uint64_t);
+    const KeyArray& keys = node->m_keys;
+    const std::string_view front = from_left || keys.Empty() ? gained : keys.Front();
+    const std::string_view back = !from_left || keys.Empty() ? gained : keys.Back();
+    const size_t node_bytes = kNodeHeaderSize + KeyBytes(keys.Size() + 1, keys.ByteSize() + gained.size(), front, back) + PayloadBytes(node) + gained_payload;
+
+    // the new separator is the lent key, or for leaves the shortest key between the two that end up adjacent
+    std::string replacement;
+    if (!node->m_is_leaf)
+    {
+        replacement = lender[lent];
+    }
+    else
+    {
+        replacement = from_left ? Separator(lender[lent - 1], lender[lent]) : Separator(lender[0], lender[1]);
+    }
+    const KeyArray& separators = parent->m_keys;
+    const std::string_view parent_front = separator == 0 ? std::string_view(replacement) : separators.Front();
+    const std::string_view parent_back = separator + 1 == separators.Size() ? std::string_view(replacement) : separators.Back();
+    const size_t parent_key_bytes = separators.ByteSize() - separators[separator].size() + replacement.size();
+    const size_t parent_bytes = kNodeHeaderSize + KeyBytes(separators.Size(), parent_key_bytes, parent_front, parent_back) + PayloadBytes(parent);
+    return node_bytes <= m_page_size && parent_bytes <= m_page_size;
+}
+
+bool BPTree::CanMerge(const Node* left, const Node* node, const Node* parent, size_t index) const
+{
+    // an internal merge pulls the separator down between the two halves
+    std::vector<std::string_view> ends;
+    size_t keys = left->GetSize() + node->GetSize();
+    size_t key_bytes = left->m_keys.ByteSize() + node->m_keys.ByteSize();
+    size_t payload = PayloadBytes(left) + PayloadBytes(node);
+    if (!left->m_keys.Empty())
+    {
+        ends.push_back(left->m_keys.Front());
+        ends.push_back(left->m_keys.Back());
+    }
+    if (!node->m_is_leaf)
+    {
+        ++keys;
+        key_bytes += parent->m_keys[index - 1].size();
+        payload -= sizeof(uint32_t);
+        ends.push_back(parent->m_keys[index - 1]);
+    }
+    if (!node->m_keys.Empty())
+    {
+        ends.push_back(node->m_keys.Front());
+        ends.push_back(node->m_keys.Back());
+    }
+    const size_t bytes = kNodeHeaderSize + payload + (ends.empty() ? KeyBytes(0, 0, {}, {}) : KeyBytes(keys, key_bytes, ends.front(), ends.back()));
+    return keys <= m_record_max_size && bytes <= m_page_size;
+}
+
+size_t BPTree::NodeBytes(const Node* node)
+{
+    return kNodeHeaderSize + KeyBytes(node->m_keys) + PayloadBytes(node);
+}
+
+size_t BPTree::NodeBytesWithout(const Node* node, size_t i)
+{
+    // removing a key can only lengthen the common prefix of the rest
+    const KeyArray& keys = node->m_keys;
+    const size_t count = keys.Size();
+    assert(i < count && "NodeBytesWithout: index out of range.");
+    const size_t payload = node->m_is_leaf ? sizeof(uint32_t) + node->m_values[i].size() : sizeof(uint64_t);
+    if (count == 1)
+    {
+        return kNodeHeaderSize + KeyBytes(0, 0, {}, {}) + PayloadBytes(node) - payload;
+    }
+    const std::string_view front = keys[i == 0 ? 1 : 0];
+    const std::string_view back = keys[i + 1 == count ? count - 2 : count - 1];
+    return kNodeHeaderSize + KeyBytes(count - 1, keys.ByteSize() - keys[i].size(), front, back) + PayloadBytes(node) - payload;
+}
+
+size_t BPTree::KeyBytes(size_t count, size_t bytes, std::string_view front, std::string_view back)
+{
+    const size_t prefix = count == 0 ? 0 : CommonPrefix(front, back);
+    return sizeof(uint16_t) + prefix + sizeof(uint16_t) * count + bytes - prefix * count;
+}
+
+size_t BPTree::KeyBytes(const KeyArray& keys)
+{
+    return keys.Empty() ? KeyBytes(0, 0, {}, {}) : KeyBytes(keys.Size(), keys.ByteSize(), keys.Front(), keys.Back());
+}
+
+size_t BPTree::PayloadBytes(const Node* node)
+{
+    if (!node->m_is_leaf)
+    {
+        return sizeof(uint32_t) + sizeof(uint64_t) * node->m_children.size();
+    }
+    size_t bytes = 0;
+    for (const std::string& value : node->m_values)
+    {
+        bytes += sizeof(uint32_t) + value.size();
+    }
+    return bytes;
+}
+
+size_t BPTree::CommonPrefix(std::string_view lhs, std::string_view rhs)
+{
+    const size_t limit = std::min(lhs.size(), rhs.size());
+    return static_cast<size_t>(std::mismatch(lhs.begin(), lhs.begin() + static_cast<std::ptrdiff_t>(limit), rhs.begin()).first - lhs.begin());
+}
+
+std::string BPTree::Separator(std::string_view left, std::string_view right)
+{
+    assert(left < right && "Separator: keys are out of order.");
+    return std::string(right.substr(0, CommonPrefix(left, right) + 1));
+}
+
+size_t BPTree::SplitPosition(const Node* node) const
+{
+    const size_t size = node->GetSize();
+    if (NodeBytes(node) <= m_page_size)
+    {
+        return node->m_is_leaf ? (size + 1) / 2 : size / 2;
+    }
+
+    // both halves of a node that outgrew its page get about half of its bytes; an internal
+    // node promotes the key at the split position, so it keeps at least one on either side
+    const KeyArray& keys = node->m_keys;
+    const size_t prefix = CommonPrefix(keys.Front(), keys.Back());
+    std::vector<size_t> key_sums(size + 1, 0);
+    std::vector<size_t> payload_sums(size + 1, 0);
+    for (size_t i = 0; i < size; ++i)
+    {
+        key_sums[i + 1] = key_sums[i] + keys[i].size();
+        payload_sums[i + 1] = payload_sums[i] + (node->m_is_leaf ? sizeof(uint32_t) + node->m_values[i].size() : sizeof(uint64_t));
+    }
+    const auto entries_bytes = [&](size_t end) { return sizeof(uint16_t) * end + key_sums[end] - prefix * end + payload_sums[end]; };
+    const size_t first = 1;
+    const size_t last = node->m_is_leaf ? size - 1 : size - 2;
+    size_t middle = 0;
+    while (middle + 1 < size && entries_bytes(middle) + (entries_bytes(middle + 1) - entries_bytes(middle)) / 2 < entries_bytes(size) / 2)
+    {
+        ++middle;
+    }
+    middle = std::clamp(middle, first, last);
+
+    // halves share longer prefixes than the whole, so the middle fits unless a key added at
+    // either end broke the prefix; then only splitting near that key leaves both within a page
+    const auto range_bytes = [&](size_t begin, size_t end) {
+        return end == begin ? KeyBytes(0, 0, {}, {}) : KeyBytes(end - begin, key_sums[end] - key_sums[begin], keys[begin], keys[end - 1]);
+    };
+    const auto fits = [&](size_t pos) {
+        size_t left = kNodeHeaderSize + range_bytes(0, pos);
+        size_t right = kNodeHeaderSize;
+        if (node->m_is_leaf)
+        {
+            left += payload_sums[pos];
+            right += range_bytes(pos, size) + payload_sums[size] - payload_sums[pos];
+        }
+        else
+        {
+            // the promoted key leaves the node, and the children around it stay on either side
+            left += sizeof(uint32_t) + sizeof(uint64_t) * (pos + 1);
+            right += range_bytes(pos + 1, size) + sizeof(uint32_t) + sizeof(uint64_t) * (size - pos);
+        }
+        return left <= m_page_size && right <= m_page_size;
+    };
+    for (size_t distance = 0; distance <= last - first; ++distance)
+    {
+        if (middle >= first + distance && fits(middle - distance))
+        {
+            return middle - distance;
+        }
+        if (middle + distance <= last && fits(middle + distance))
+        {
+            return middle + distance;
+        }
+    }
+    assert(false && "SplitPosition: no split leaves both halves within a page.");
+    return middle;
+}
+
+void BPTree::MarkDirty(Node* node)
+{
+    assert(node && "MarkDirty: node is nullptr.");
+    m_pool.MarkDirty(node);
+    if (m_wal)
+    {
+        std::lock_guard<std::mutex> lock(m_unlogged_mutex);
+        ++m_unlogged_pages[node->m_page_id];
+    }
+}
+
+void BPTree::MarkMetaDirty()
+{
+    m_meta_dirty = true;
+    m_meta_unlogged = m_wal != nullptr;
+}
+
+void BPTree::UnpinAll(const std::vector<Node*>& nodes) const
+{
+    for (const Node* node : nodes)
+    {
+        m_pool.Unpin(node);
+    }
+}
+
+void BPTree::InsertIntoLeaf(Node* leaf, const std::string& key, std::string value)
+{
+    const size_t pos = leaf->FindPos(key);
+    if (pos < leaf->GetSize() && leaf->m_keys[pos] == key)
+    {
+        FreeValue(leaf->m_values[pos]);
+        leaf->m_values[pos] = std::move(value);
+        MarkDirty(leaf);
+        return;
+    }
+
+    leaf->m_keys.Insert(pos, key);
+    leaf->m_values.insert(leaf->m_values.begin() + static_cast<std::ptrdiff_t>(pos), std::move(value));
+    MarkDirty(leaf);
+}
+
+Node* BPTree::SplitLeafNode(Node* leaf)
+{
+    assert(leaf && leaf->m_is_leaf && "SplitLeafNode: invalid leaf.");
+    Node* new_leaf = CreateNode(true);
+    const size_t split_pos = SplitPosition(leaf);
+
+    new_leaf->m_keys = leaf->m_keys.Split(split_pos);
+    new_leaf->m_values.assign(leaf->m_values.begin() + static_cast<std::ptrdiff_t>(split_pos), leaf->m_values.end());
+    leaf->m_values.erase(leaf->m_values.begin() + static_cast<std::ptrdiff_t>(split_pos), leaf->m_values.end());
+
+    new_leaf->m_next_leaf = leaf->m_next_leaf;
+    new_leaf->m_prev_leaf = leaf->m_page_id;
+    leaf->m_next_leaf = new_leaf->m_page_id;
+    if (Node* next_leaf = m_pool.Fetch(new_leaf->m_next_leaf))
+    {
+        next_leaf->m_prev_leaf = new_leaf->m_page_id;
+        MarkDirty(next_leaf);
+        m_pool.Unpin(next_leaf);
+    }
+
+    MarkDirty(leaf);
+    MarkDirty(new_leaf);
+    return new_leaf;
+}
+
+void BPTree::InsertInternal(std::string key, const std::vector<Node*>& path, uint64_t left_page_id, uint64_t right_page_id)
+{
+    // walk the pinned descent path bottom-up until a parent absorbs the separator
+    for (auto it = path.rbegin(); it != path.rend(); ++it)
+    {
+        Node* cursor = *it;
+        assert(!cursor->m_is_leaf && "InsertInternal: parent is invalid.");
+
+        const size_t key_pos = cursor->FindChild(key);
+        const size_t child_pos = key_pos + 1;
+        cursor->m_keys.Insert(key_pos, key);
+        cursor->m_children.insert(cursor->m_children.begin() + static_cast<std::ptrdiff_t>(child_pos), right_page_id);
+        MarkDirty(cursor);
+
+        if (!Overfull(cursor))
+        {
+            return;
+        }
+
+        std::string promoted_key;
+        Node* new_internal_node = SplitInternalNode(cursor, promoted_key);
+        key = std::move(promoted_key);
+        left_page_id = cursor->m_page_id;
+        right_page_id = new_internal_node->m_page_id;
+        m_pool.Unpin(new_internal_node);
+    }
+
+    Node* new_root = CreateNode(false);
+    new_root->m_keys.PushBack(key);
+    new_root->m_children.push_back(left_page_id);
+    new_root->m_children.push_back(right_page_id);
+    m_root_page_id = new_root->m_page_id;
+    MarkMetaDirty();
+    m_pool.Unpin(new_root);
+}
+
+Node* BPTree::SplitInternalNode(Node* node, std::string& promoted_key)
+{
+    assert(node && !node->m_is_leaf && "SplitInternalNode: invalid node.");
+    Node* new_internal = CreateNode(false);
+    const size_t mid = SplitPosition(node);
+    promoted_key = node->m_keys[mid];
+
+    new_internal->m_keys = node->m_keys.Split(mid);
+    new_internal->m_keys.Erase(0, 1);
+    new_internal->m_children.assign(node->m_children.begin() + static_cast<std::ptrdiff_t>(mid + 1), node->m_children.end());
+    node->m_children.erase(node->m_children.begin() + static_cast<std::ptrdiff_t>(mid + 1), node->m_children.end());
+
+    MarkDirty(node);
+    MarkDirty(new_internal);
+    return new_internal;
+}
+
+Node* BPTree::LatchLeaf(const std::string& key, bool exclusive, const Node* held) const
+{
+    // the child is latched before the parent is released, so no writer slips in between
+    const auto latch = [exclusive](Node* node) {
+        if (exclusive && node->m_is_leaf)
+        {
+            node->m_latch.lock();
+        }
+        else
+        {
+            node->m_latch.lock_shared();
+        }
+    };
+
+    Node* cursor = m_pool.Fetch(m_root_page_id);
+    if (!cursor || cursor == held)
+    {
+        if (cursor)
+        {
+            m_pool.Unpin(cursor);
+        }
+        return cursor;
+    }
+    latch(cursor);
+    while (!cursor->m_is_leaf)
+    {
+        Node* child = m_pool.Fetch(cursor->m_children[cursor->FindChild(key)]);
+        if (child && child == held)
+        {
+            m_pool.Unpin(child);
+        }
+        else if (child)
+        {
+            latch(child);
+        }
+        cursor->m_latch.unlock_shared();
+        m_pool.Unpin(cursor);
+        if (!child)
+        {
+            return nullptr;
+        }
+        cursor = child;
+    }
+    return cursor;
+}
+
+void BPTree::VisitFrom(const std::string& start, const Visitor& visitor) const
+{
+    std::shared_lock<std::shared_mutex> tree(m_tree_latch);
+    Node* leaf = m_root_page_id == 0 ? nullptr : LatchLeaf(start, false);
+    size_t slot = leaf ? leaf->FindPos(start) : 0;
+    std::string overflow_value;
+    while (leaf)
+    {
+        for (; slot < leaf->GetSize(); ++slot)
+        {
+            const std::string& stored = leaf->m_values[slot];
+            std::string_view value;
+            if (!IsOverflow(stored))
+            {
+                value = InlineValue(stored);
+            }
+            else if (ReadValue(stored, overflow_value))
+            {
+                value = overflow_value;
+            }
+            if (!visitor(leaf->m_keys[slot], value))
+            {
+                leaf->m_latch.unlock_shared();
+                m_pool.Unpin(leaf);
+                return;
+            }
+        }
+
+        // leaves are latched left to right, like every other reader walking the chain
+        Node* next = m_pool.Fetch(leaf->m_next_leaf);
+        if (next)
         {
-            Data record;
-            record.m_data_size = leaf->m_values[i].size();
-            record.m_data = leaf->m_values[i].data();
-            data = record;
-            return data;
+            next->m_latch.lock_shared();
         }
+        leaf->m_latch.unlock_shared();
+        m_pool.Unpin(leaf);
+        leaf = next;
+        slot = 0;
     }
-    return data;
 }
 
-void BPTree::DeleteIndexNode(Node* node)
+Node* BPTree::FindLeaf(const std::string& key, std::vector<Node*>* path) const
 {
-    if (!node)
+    assert(m_root_page_id != 0 && "root is empty");
+    Node* cursor = m_pool.Fetch(m_root_page_id);
+    while (cursor && !cursor->m_is_leaf)
     {
-        return;
+        Node* child = m_pool.Fetch(cursor->m_children[cursor->FindChild(key)]);
+        if (path)
+        {
+            path->push_back(cursor);
+        }
+        else
+        {
+            m_pool.Unpin(cursor);
+        }
+        cursor = child;
     }
-    DeleteNode(node);
+    return cursor;
 }
 
-Node* BPTree::GetRoot()
+Node* BPTree::FindEdgeLeaf(bool leftmost) const
 {
-    return m_root;
+    Node* cursor = m_pool.Fetch(m_root_page_id);
+    while (cursor && !cursor->m_is_leaf)
+    {
+        Node* child = m_pool.Fetch(leftmost ? cursor->m_children.front() : cursor->m_children.back());
+        m_pool.Unpin(cursor);
+        cursor = child;
+    }
+    return cursor;
 }
 
-Node* BPTree::CreateNode(bool is_leaf)
+void BPTree::AddRecord(Node* cursor, const std::string& key, const void* value, size_t size)
 {
-    Node* node = new Node(is_leaf, m_record_max_size, m_next_page_id++);
-    m_nodes[node->m_page_id] = node;
-    MarkDirty(node);
-    m_meta_dirty = true;
-    return node;
+    assert(cursor && cursor->m_is_leaf && "cursor node is invalid");
+    InsertIntoLeaf(cursor, key, StoreValue(std::string(static_cast<const char*>(value), size)));
 }
 
-Node* BPTree::GetNode(uint64_t page_id) const
+void BPTree::DeleteNode(Node* node)
 {
-    if (page_id == 0)
+    assert(node && "Delete: try to delete empty node!");
+    if (node->m_is_leaf)
     {
-        return nullptr;
+        for (const std::string& stored : node->m_values)
+        {
+            FreeValue(stored);
+        }
+    }
+    else
+    {
+        for (uint64_t child_page_id : node->m_children)
+        {
+            if (Node* child = m_pool.Fetch(child_page_id))
+            {
+                DeleteNode(child);
+            }
+        }
     }
-    auto it = m_nodes.find(page_id);
-    return it == m_nodes.end() ? nullptr : it->second;
-}
 
-void BPTree::MarkDirty(Node* node)
-{
-    assert(node && "MarkDirty: node is nullptr.");
-    m_dirty_pages.insert(node->m_page_id);
+    if (node->m_page_id == m_root_page_id)
+    {
+        m_root_page_id = 0;
+        MarkMetaDirty();
+    }
+    FreeNode(node);
 }
 
-void BPTree::InsertIntoLeaf(Node* leaf, const std::string& key, const std::string& value)
+std::vector<size_t> BPTree::PlanLevel(size_t item_count, size_t per_node, size_t min_per_node, const std::function<bool(size_t, size_t)>& fits)
 {
-    const size_t pos = leaf->FindPos(key.c_str());
-    if (pos < leaf->m_keys.size() && leaf->m_keys[pos] == key)
+    // spread items evenly so the last node is not left underfull; a node that fills its
+    // byte budget first is closed early and the rest spread over the nodes after it
+    std::vector<size_t> sizes;
+    if (item_count == 0)
     {
-        leaf->m_values[pos] = value;
-        MarkDirty(leaf);
-        return;
+        return sizes;
     }
 
-    leaf->m_keys.insert(leaf->m_keys.begin() + static_cast<std::ptrdiff_t>(pos), key);
-    leaf->m_values.insert(leaf->m_values.begin() + static_cast<std::ptrdiff_t>(pos), value);
-    MarkDirty(leaf);
+    size_t node_count = (item_count + per_node - 1) / per_node;
+    if (item_count / node_count < min_per_node)
+    {
+        node_count = std::max<size_t>(1, item_count / min_per_node);
+    }
+    for (size_t begin = 0; begin < item_count;)
+    {
+        const size_t nodes_left = node_count > sizes.size() ? node_count - sizes.size() : 1;
+        const size_t target = std::min(per_node, (item_count - begin + nodes_left - 1) / nodes_left);
+        size_t size = 1;
+        while (size < target && fits(begin, size + 1))
+        {
+            ++size;
+        }
+        sizes.push_back(size);
+        begin += size;
+    }
+    if (sizes.size() > 1 && sizes.back() < min_per_node && fits(item_count - sizes.back() - 1, sizes.back() + 1))
+    {
+        --sizes[sizes.size() - 2];
+        ++sizes.back();
+    }
+    return sizes;
 }
 
-Node* BPTree::SplitLeafNode(Node* leaf)
+std::string BPTree::StoreValue(std::string value)
 {
-    assert(leaf && leaf->m_is_leaf && "SplitLeafNode: invalid leaf.");
-    Node* new_leaf = CreateNode(true);
-    const size_t split_pos = (leaf->m_keys.size() + 1) / 2;
-
-    new_leaf->m_keys.assign(leaf->m_keys.begin() + static_cast<std::ptrdiff_t>(split_pos), leaf->m_keys.end());
-    new_leaf->m_values.assign(leaf->m_values.begin() + static_cast<std::ptrdiff_t>(split_pos), leaf->m_values.end());
-
-    leaf->m_keys.erase(leaf->m_keys.begin() + static_cast<std::ptrdiff_t>(split_pos), leaf->m_keys.end());
-    leaf->m_values.erase(leaf->m_values.begin() + static_cast<std::ptrdiff_t>(split_pos), leaf->m_values.end());
+    if (value.size() <= MaxInlineValue())
+    {
+        value.push_back(static_cast<char>(ValueTag::kInline));
+        return value;
+    }
 
-    new_leaf->m_next_leaf = leaf->m_next_leaf;
-    leaf->m_next_leaf = new_leaf;
-    new_leaf->m_parent_page_id = leaf->m_parent_page_id;
+    // page ids come first so every page can name the next one
+    std::vector<uint64_t> page_ids((value.size() + OverflowCapacity() - 1) / OverflowCapacity());
+    for (uint64_t& page_id : page_ids)
+    {
+        page_id = AllocatePageId();
+    }
+    MarkMetaDirty();
+    for (size_t i = 0; i < page_ids.size(); ++i)
+    {
+        const size_t chunk = std::min(OverflowCapacity(), value.size() - i * OverflowCapacity());
+        std::vector<char> page(m_page_size, 0);
+        size_t offset = 0;
+        WriteUint32(page.data(), offset, static_cast<uint32_t>(PageType::kOverflow));
+        WriteUint64(page.data(), offset, page_ids[i]);
+        WriteUint64(page.data(), offset, 0);
+        WriteUint64(page.data(), offset, i + 1 < page_ids.size() ? page_ids[i + 1] : 0);
+        WriteUint32(page.data(), offset, static_cast<uint32_t>(chunk));
+        std::memcpy(page.data() + offset, value.data() + i * OverflowCapacity(), chunk);
+        {
+            std::lock_guard<std::mutex> lock(m_overflow_mutex);
+            m_pending_overflow[page_ids[i]] = std::move(page);
+        }
+        if (m_wal)
+        {
+            std::lock_guard<std::mutex> lock(m_unlogged_mutex);
+            ++m_unlogged_pages[page_ids[i]];
+        }
+    }
 
-    MarkDirty(leaf);
-    MarkDirty(new_leaf);
-    return new_leaf;
+    std::string stored(kOverflowRefSize, '\0');
+    size_t offset = 0;
+    WriteUint64(stored.data(), offset, page_ids.front());
+    WriteUint64(stored.data(), offset, value.size());
+    stored.back() = static_cast<char>(ValueTag::kOverflow);
+    return stored;
 }
 
-bool BPTree::InsertInternal(const std::string& key, Node* cursor, Node* child)
+bool BPTree::IsOverflow(const std::string& stored)
 {
-    assert(cursor && !cursor->m_is_leaf && "InsertInternal: parent is invalid.");
-    assert(child && "InsertInternal: child is nullptr.");
-
-    size_t key_pos = 0;
-    while (key_pos < cursor->m_keys.size() && key >= cursor->m_keys[key_pos])
-    {
-        ++key_pos;
-    }
+    assert(!stored.empty() && "IsOverflow: stored value has no tag.");
+    return stored.back() == static_cast<char>(ValueTag::kOverflow);
+}
 
-    const size_t child_pos = key_pos + 1;
-    cursor->m_keys.insert(cursor->m_keys.begin() + static_cast<std::ptrdiff_t>(key_pos), key);
-    cursor->m_children.insert(cursor->m_children.begin() + static_cast<std::ptrdiff_t>(child_pos), child);
-    child->m_parent_page_id = cursor->m_page_id;
-    MarkDirty(cursor);
-    MarkDirty(child);
+std::string_view BPTree::InlineValue(const std::string& stored)
+{
+    assert(!IsOverflow(stored) && "InlineValue: value is in overflow pages.");
+    return std::string_view(stored.data(), stored.size() - 1);
+}
 
-    if (cursor->GetSize() <= m_record_max_size)
+bool BPTree::ReadValue(const std::string& stored, std::string& value) const
+{
+    if (!IsOverflow(stored))
     {
+        value.assign(InlineValue(stored));
         return true;
     }
 
-    std::string promoted_key;
-    Node* new_internal_node = SplitInternalNode(cursor, promoted_key);
-    if (cursor == m_root)
+    size_t offset = 0;
+    uint64_t page_id = ReadUint64(stored.data(), offset);
+    const uint64_t size = ReadUint64(stored.data(), offset);
+    value.resize(size);
+    std::vector<char> buffer(m_page_size);
+    for (size_t copied = 0; copied < size;)
     {
-        Node* new_root = CreateNode(false);
-        new_root->m_keys.push_back(promoted_key);
-        new_root->m_children.push_back(cursor);
-        new_root->m_children.push_back(new_internal_node);
-        cursor->m_parent_page_id = new_root->m_page_id;
-        new_internal_node->m_parent_page_id = new_root->m_page_id;
-        MarkDirty(cursor);
-        MarkDirty(new_internal_node);
-        MarkDirty(new_root);
-        m_root = new_root;
-        m_meta_dirty = true;
-        return true;
+        if (page_id == 0 || !ReadOverflowPage(page_id, buffer.data()))
+        {
+            return false;
+        }
+        offset = kPageLsnOffset + sizeof(uint64_t);
+        page_id = ReadUint64(buffer.data(), offset);
+        const uint32_t chunk = ReadUint32(buffer.data(), offset);
+        if (chunk > OverflowCapacity() || chunk > size - copied)
+        {
+            return false;
+        }
+        std::memcpy(value.data() + copied, buffer.data() + offset, chunk);
+        copied += chunk;
     }
-
-    Node* parent = GetNode(cursor->m_parent_page_id);
-    return InsertInternal(promoted_key, parent, new_internal_node);
+    return true;
 }
 
-Node* BPTree::SplitInternalNode(Node* node, std::string& promoted_key)
+void BPTree::FreeValue(const std::string& stored)
 {
-    assert(node && !node->m_is_leaf && "SplitInternalNode: invalid node.");
-    Node* new_internal = CreateNode(false);
-    const size_t mid = node->m_keys.size() / 2;
-    promoted_key = node->m_keys[mid];
-
-    new_internal->m_keys.assign(node->m_keys.begin() + static_cast<std::ptrdiff_t>(mid + 1), node->m_keys.end());
-    new_internal->m_children.assign(node->m_children.begin() + static_cast<std::ptrdiff_t>(mid + 1), node->m_children.end());
-    for (Node* child : new_internal->m_children)
+    if (!IsOverflow(stored))
     {
-        child->m_parent_page_id = new_internal->m_page_id;
-        MarkDirty(child);
+        return;
     }
 
-    node->m_keys.erase(node->m_keys.begin() + static_cast<std::ptrdiff_t>(mid), node->m_keys.end());
-    node->m_children.erase(node->m_children.begin() + static_cast<std::ptrdiff_t>(mid + 1), node->m_children.end());
-    new_internal->m_parent_page_id = node->m_parent_page_id;
-
-    MarkDirty(node);
-    MarkDirty(new_internal);
-    return new_internal;
-}
-
-std::pair<Node*, Node*> BPTree::FindLeaf(const std::string& key) const
-{
-    assert(m_root && "root is nullptr");
-    Node* cursor = m_root;
-    Node* parent = nullptr;
-    while (cursor && !cursor->m_is_leaf)
+    size_t offset = 0;
+    uint64_t page_id = ReadUint64(stored.data(), offset);
+    std::vector<char> buffer(m_page_size);
+    while (page_id != 0 && ReadOverflowPage(page_id, buffer.data()))
     {
-        parent = cursor;
-        size_t child_index = 0;
-        while (child_index < cursor->m_keys.size() && key >= cursor->m_keys[child_index])
         {
-            ++child_index;
+            std::lock_guard<std::mutex> lock(m_overflow_mutex);
+            m_pending_overflow.erase(page_id);
         }
-        cursor = cursor->m_children[child_index];
+        FreePage(page_id);
+        offset = kPageLsnOffset + sizeof(uint64_t);
+        page_id = ReadUint64(buffer.data(), offset);
     }
-    return {cursor, parent};
-}
-
-void BPTree::AddRecord(Node* cursor, const std::string& key, const void* value, size_t size)
-{
-    assert(cursor && cursor->m_is_leaf && "cursor node is invalid");
-    InsertIntoLeaf(cursor, key, std::string(static_cast<const char*>(value), size));
 }
 
-Node* BPTree::DeleteNode(Node* node)
+bool BPTree::ReadOverflowPage(uint64_t page_id, char* buffer) const
 {
-    assert(node && "Delete: try to delete empty node!");
-    if (!node->m_is_leaf)
     {
-        auto children = node->m_children;
-        for (Node* child : children)
+        std::lock_guard<std::mutex> lock(m_overflow_mutex);
+        auto it = m_pending_overflow.find(page_id);
+        if (it != m_pending_overflow.end())
         {
-            DeleteNode(child);
+            std::memcpy(buffer, it->second.data(), m_page_size);
+            return true;
         }
-        node->m_children.clear();
     }
-
-    m_dirty_pages.erase(node->m_page_id);
-    m_nodes.erase(node->m_page_id);
-    if (node == m_root)
+    const char* page = m_mmap_reads ? m_storage.MappedAt(page_id * m_page_size, m_page_size) : nullptr;
+    if (page)
+    {
+        std::memcpy(buffer, page, m_page_size);
+    }
+    else if (!m_storage.ReadAt(page_id * m_page_size, buffer, m_page_size))
     {
-        m_root = nullptr;
-        m_meta_dirty = true;
+        return false;
     }
-    delete node;
-    return nullptr;
+
+    size_t offset = 0;
+    const PageType page_type = static_cast<PageType>(ReadUint32(buffer, offset));
+    return page_type == PageType::kOverflow && ReadUint64(buffer, offset) == page_id;
 }
 
-void BPTree::DeleteAllNodes()
+bool BPTree::WriteOverflowPages()
 {
-    for (auto& [page_id, node] : m_nodes)
+    std::lock_guard<std::mutex> lock(m_overflow_mutex);
+    for (const auto& [page_id, page] : m_pending_overflow)
     {
-        (void) page_id;
-        delete node;
+        if (!m_storage.WriteAt(page_id * m_page_size, page.data(), page.size()))
+        {
+            return false;
+        }
     }
-    m_nodes.clear();
-    m_dirty_pages.clear();
-    m_root = nullptr;
+    m_pending_overflow.clear();
+    return true;
 }
 
 bool BPTree::LoadFromDisk()
 {
-    std::ifstream in(m_file, std::ios::binary);
-    if (!in.good())
+    // with a log the tree file may not even exist yet while committed pages wait in the log
+    if (m_wal)
+    {
+        if (!OpenStorage() || !Recover())
+        {
+            return false;
+        }
+    }
+    else if (!m_storage.Open(m_file, false))
     {
         return false;
     }
 
     MetaPage meta {};
-    if (!LoadMetaPage(in, meta))
+    if (!LoadMetaPage(meta))
     {
         return false;
     }
-    if (meta.m_magic != kFileMagic || meta.m_version != kFileVersion || meta.m_page_size != kPageSize)
+    if (meta.m_magic != kFileMagic || meta.m_version != kFileVersion || !ValidPageSize(meta.m_page_size))
     {
         return false;
     }
-    if (meta.m_node_size != m_record_max_size)
+    if (m_record_max_size != 0 && meta.m_node_size != m_record_max_size)
     {
         throw std::runtime_error("bptree file node size mismatch");
     }
+    // the file's own page size wins over the one asked for
+    m_page_size = meta.m_page_size;
+    m_record_max_size = meta.m_node_size;
 
+    // pages are faulted in by the buffer pool on first access
     m_next_page_id = meta.m_next_page_id;
-    if (meta.m_root_page_id == 0)
-    {
-        return true;
-    }
+    m_root_page_id = meta.m_root_page_id;
+    m_free_page_id = meta.m_free_page_id;
+    m_meta_lsn = meta.m_lsn;
+    return true;
+}
+
+bool BPTree::Recover()
+{
+    // images are replayed unconditionally and in log order: a page torn by the crash may
+    // already carry the newer lsn in its header while the rest of it is stale
+    bool replayed = false;
+    std::vector<uint8_t> page;
+    const bool complete = m_wal->Replay([&](const Wal::Record& record) {
+        if (record.m_file_id != m_wal_file_id)
+        {
+            return true;
+        }
+
+        page = record.m_data;
+        uint32_t page_type = 0;
+        std::memcpy(&page_type, page.data(), sizeof(page_type));
+        const size_t lsn_offset = static_cast<PageType>(page_type) == PageType::kMeta ? kMetaLsnOffset : kPageLsnOffset;
+        std::memcpy(page.data() + lsn_offset, &record.m_lsn, sizeof(record.m_lsn));
+        replayed = true;
+        return m_storage.WriteAt(record.m_offset, page.data(), page.size());
+    });
+    return complete && (!replayed || m_storage.Sync());
+}
 
-    std::vector<PendingChildren> pending_children;
-    m_root = LoadNodePage(in, meta.m_root_page_id, pending_children);
-    if (!m_root)
+bool BPTree::FlushDirtyPages()
+{
+    if (m_wal)
     {
-        return false;
+        return LogDirtyPages(true);
     }
+    return WriteDirtyPages();
+}
 
-    for (const PendingChildren& pending : pending_children)
+bool BPTree::LogDirtyPages(bool commit)
+{
+    // a page only counts as logged once the commit is durable and nobody changed it after the
+    // snapshot; the commit itself runs outside the flush mutex so concurrent writers share it
+    std::vector<std::pair<uint64_t, uint64_t>> pages;
     {
-        pending.m_node->m_children.reserve(pending.m_child_page_ids.size());
-        for (uint64_t child_page_id : pending.m_child_page_ids)
+        std::lock_guard<std::mutex> flush(m_flush_mutex);
+        // staged pages another file's commit has covered since need no new image
+        if (!m_staged_pages.empty() && m_wal->CommittedLsn() >= m_staged_lsn)
         {
-            Node* child = GetNode(child_page_id);
-            if (!child)
+            ForgetLoggedPages(m_staged_pages);
+        }
+        m_staged_pages.clear();
+        {
+            std::lock_guard<std::mutex> lock(m_unlogged_mutex);
+            if (m_unlogged_pages.empty() && !m_meta_unlogged)
+            {
+                return true;
+            }
+            pages.assign(m_unlogged_pages.begin(), m_unlogged_pages.end());
+        }
+
+        std::sort(pages.begin(), pages.end());
+        std::vector<char> buffer(m_page_size);
+        uint64_t last_lsn = 0;
+        for (const auto& [page_id, changes] : pages)
+        {
+            (void) changes;
+            auto freed = m_freed_pages.find(page_id);
+            if (freed != m_freed_pages.end())
+            {
+                EncodeFreePage(page_id, freed->second, buffer.data());
+                last_lsn = m_wal->Append(m_wal_file_id, page_id * m_page_size, buffer.data(), buffer.size());
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_overflow_mutex);
+                auto overflow = m_pending_overflow.find(page_id);
+                if (overflow != m_pending_overflow.end())
+                {
+                    last_lsn = m_wal->Append(m_wal_file_id, page_id * m_page_size, overflow->second.data(), overflow->second.size());
+                    continue;
+                }
+            }
+
+            // unlogged pages cannot be evicted, so this never reads the tree file
+            Node* node = m_pool.Fetch(page_id);
+            assert(node && "LogDirtyPages: unlogged page is not cached.");
+            bool encoded = false;
+            {
+                std::shared_lock<std::shared_mutex> latch(node->m_latch);
+                encoded = EncodeNodePage(node, buffer.data());
+                if (encoded)
+                {
+                    node->m_lsn = m_wal->Append(m_wal_file_id, page_id * m_page_size, buffer.data(), buffer.size());
+                    last_lsn = node->m_lsn;
+                }
+            }
+            m_pool.Unpin(node);
+            if (!encoded)
             {
                 return false;
             }
-            pending.m_node->m_children.push_back(child);
         }
+
+        if (m_meta_unlogged)
+        {
+            // only the fields, which recovery writes over the start of the meta page
+            EncodeMetaPage(buffer.data());
+            m_meta_lsn = m_wal->Append(m_wal_file_id, 0, buffer.data(), kMetaLsnOffset + sizeof(uint64_t));
+            m_meta_unlogged = false;
+            last_lsn = m_meta_lsn;
+        }
+
+        if (!commit)
+        {
+            // the images sit in the log buffer until someone commits it; until then the pages stay
+            // unlogged, so they are neither written back nor evicted
+            m_staged_pages = std::move(pages);
+            m_staged_lsn = last_lsn;
+            return true;
+        }
+    }
+
+    if (!m_wal->Commit())
+    {
+        return false;
     }
+    ForgetLoggedPages(pages);
     return true;
 }
 
-bool BPTree::FlushDirtyPages()
+void BPTree::ForgetLoggedPages(const std::vector<std::pair<uint64_t, uint64_t>>& pages)
+{
+    std::lock_guard<std::mutex> lock(m_unlogged_mutex);
+    for (const auto& [page_id, changes] : pages)
+    {
+        auto it = m_unlogged_pages.find(page_id);
+        if (it != m_unlogged_pages.end() && it->second == changes)
+        {
+            m_unlogged_pages.erase(it);
+        }
+    }
+}
+
+bool BPTree::WriteDirtyPages()
 {
-    if (m_dirty_pages.empty() && !m_meta_dirty)
+    std::lock_guard<std::mutex> flush(m_flush_mutex);
+    bool pending_overflow = false;
+    {
+        std::lock_guard<std::mutex> lock(m_overflow_mutex);
+        pending_overflow = !m_pending_overflow.empty();
+    }
+    if (!m_pool.HasDirty() && !m_meta_dirty && !pending_overflow)
     {
         return true;
     }
 
-    std::fstream io;
-    if (!OpenStorage(io))
+    if (!OpenStorage())
     {
         return false;
     }
 
     if (m_meta_dirty)
     {
-        if (!WriteMetaPage(io))
+        if (!WriteMetaPage())
         {
             return false;
         }
         m_meta_dirty = false;
     }
 
-    std::vector<uint64_t> dirty_pages(m_dirty_pages.begin(), m_dirty_pages.end());
-    std::sort(dirty_pages.begin(), dirty_pages.end());
-    for (uint64_t page_id : dirty_pages)
+    for (const auto& [page_id, next_free_page_id] : m_freed_pages)
     {
-        Node* node = GetNode(page_id);
-        if (!node)
-        {
-            continue;
-        }
-        if (!WriteNodePage(io, node))
+        if (!WriteFreePage(page_id, next_free_page_id))
         {
             return false;
         }
     }
+    m_freed_pages.clear();
+    return WriteOverflowPages() && m_pool.FlushAll();
+}
 
-    io.flush();
-    if (!io.good())
+bool BPTree::WriteBackPage(const Node* node)
+{
+    // no-steal: a page changed since the last commit has no image in the log yet
+    if (m_wal)
     {
-        return false;
+        std::lock_guard<std::mutex> lock(m_unlogged_mutex);
+        if (m_unlogged_pages.count(node->m_page_id) != 0)
+        {
+            return false;
+        }
     }
-    m_dirty_pages.clear();
-    return true;
+    return WriteNodePage(node);
 }
 
-bool BPTree::LoadMetaPage(std::istream& in, MetaPage& meta)
+bool BPTree::LoadMetaPage(MetaPage& meta)
 {
-    std::array<char, kPageSize> buffer {};
-    in.seekg(0, std::ios::beg);
-    in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
-    if (!in.good())
+    // only the fields are read, the page size is one of them
+    std::array<char, kMetaLsnOffset + sizeof(uint64_t)> buffer {};
+    if (!m_storage.ReadAt(0, buffer.data(), buffer.size()))
     {
         return false;
     }
@@ -451,67 +1975,75 @@ bool BPTree::LoadMetaPage(std::istream& in, MetaPage& meta)
     meta.m_node_size = ReadUint64(buffer.data(), offset);
     meta.m_root_page_id = ReadUint64(buffer.data(), offset);
     meta.m_next_page_id = ReadUint64(buffer.data(), offset);
+    meta.m_free_page_id = ReadUint64(buffer.data(), offset);
+    meta.m_lsn = ReadUint64(buffer.data(), offset);
     return true;
 }
 
-bool BPTree::WriteMetaPage(std::ostream& out)
+bool BPTree::WriteMetaPage()
 {
-    std::array<char, kPageSize> buffer {};
-    size_t offset = 0;
-    WriteUint32(buffer.data(), offset, static_cast<uint32_t>(PageType::kMeta));
-    WriteUint32(buffer.data(), offset, kFileMagic);
-    WriteUint32(buffer.data(), offset, kFileVersion);
-    WriteUint32(buffer.data(), offset, kPageSize);
-    WriteUint32(buffer.data(), offset, 0);
-    WriteUint64(buffer.data(), offset, m_record_max_size);
-    WriteUint64(buffer.data(), offset, m_root ? m_root->m_page_id : 0);
-    WriteUint64(buffer.data(), offset, m_next_page_id);
-
-    auto* io = dynamic_cast<std::fstream*>(&out);
-    assert(io && "WriteMetaPage requires fstream.");
-    io->seekp(0, std::ios::beg);
-    io->write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
-    return io->good();
+    std::vector<char> buffer(m_page_size);
+    EncodeMetaPage(buffer.data());
+    return m_storage.WriteAt(0, buffer.data(), buffer.size());
 }
 
-Node* BPTree::LoadNodePage(std::istream& in, uint64_t page_id, std::vector<PendingChildren>& pending_children)
+void BPTree::EncodeMetaPage(char* buffer)
 {
-    if (Node* existing = GetNode(page_id))
-    {
-        return existing;
-    }
+    std::memset(buffer, 0, m_page_size);
+    size_t offset = 0;
+    WriteUint32(buffer, offset, static_cast<uint32_t>(PageType::kMeta));
+    WriteUint32(buffer, offset, kFileMagic);
+    WriteUint32(buffer, offset, kFileVersion);
+    WriteUint32(buffer, offset, m_page_size);
+    WriteUint32(buffer, offset, 0);
+    WriteUint64(buffer, offset, m_record_max_size);
+    WriteUint64(buffer, offset, m_root_page_id);
+    WriteUint64(buffer, offset, m_next_page_id);
+    WriteUint64(buffer, offset, m_free_page_id);
+    WriteUint64(buffer, offset, m_meta_lsn);
+}
 
-    std::array<char, kPageSize> buffer {};
-    in.seekg(static_cast<std::streamoff>(page_id * kPageSize), std::ios::beg);
-    in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
-    if (!in.good())
+Node* BPTree::LoadNodePage(uint64_t page_id)
+{
+    // a mapped page is decoded in place, without a read into an intermediate buffer
+    std::vector<char> buffer;
+    const char* page = m_mmap_reads ? m_storage.MappedAt(page_id * m_page_size, m_page_size) : nullptr;
+    if (!page)
     {
-        return nullptr;
+        buffer.resize(m_page_size);
+        if (!m_storage.ReadAt(page_id * m_page_size, buffer.data(), buffer.size()))
+        {
+            return nullptr;
+        }
+        page = buffer.data();
     }
 
     size_t offset = 0;
-    const PageType page_type = static_cast<PageType>(ReadUint32(buffer.data(), offset));
+    const PageType page_type = static_cast<PageType>(ReadUint32(page, offset));
     if (page_type != PageType::kLeaf && page_type != PageType::kInternal)
     {
         return nullptr;
     }
 
     const bool is_leaf = page_type == PageType::kLeaf;
-    const uint64_t stored_page_id = ReadUint64(buffer.data(), offset);
+    const uint64_t stored_page_id = ReadUint64(page, offset);
     if (stored_page_id != page_id)
     {
         return nullptr;
     }
 
     Node* node = new Node(is_leaf, m_record_max_size, page_id);
-    node->m_parent_page_id = ReadUint64(buffer.data(), offset);
-    const uint64_t next_leaf_page_id = ReadUint64(buffer.data(), offset);
-
-    const uint32_t key_count = ReadUint32(buffer.data(), offset);
-    node->m_keys.reserve(key_count);
+    node->m_lsn = ReadUint64(page, offset);
+    node->m_next_leaf = ReadUint64(page, offset);
+    node->m_prev_leaf = ReadUint64(page, offset);
+
+    const uint32_t key_count = ReadUint32(page, offset);
+    const std::string_view prefix = ReadKey(page, offset);
+    // the keys take at most their prefixes plus what is left of the page
+    node->m_keys.Reserve(key_count, prefix.size() * key_count + m_page_size);
     for (uint32_t key_index = 0; key_index < key_count; ++key_index)
     {
-        node->m_keys.push_back(ReadString(buffer.data(), offset));
+        node->m_keys.PushBack(prefix, ReadKey(page, offset));
     }
 
     if (is_leaf)
@@ -519,123 +2051,164 @@ Node* BPTree::LoadNodePage(std::istream& in, uint64_t page_id, std::vector<Pendi
         node->m_values.reserve(key_count);
         for (uint32_t value_index = 0; value_index < key_count; ++value_index)
         {
-            node->m_values.push_back(ReadString(buffer.data(), offset));
+            node->m_values.push_back(ReadString(page, offset));
         }
     }
     else
     {
-        PendingChildren pending {};
-        pending.m_node = node;
-        const uint32_t child_count = ReadUint32(buffer.data(), offset);
-        pending.m_child_page_ids.reserve(child_count);
+        const uint32_t child_count = ReadUint32(page, offset);
+        node->m_children.reserve(child_count);
         for (uint32_t child_index = 0; child_index < child_count; ++child_index)
         {
-            const uint64_t child_page_id = ReadUint64(buffer.data(), offset);
-            pending.m_child_page_ids.push_back(child_page_id);
-            if (!LoadNodePage(in, child_page_id, pending_children))
-            {
-                delete node;
-                return nullptr;
-            }
+            node->m_children.push_back(ReadUint64(page, offset));
         }
-        pending_children.push_back(std::move(pending));
     }
+    return node;
+}
 
-    m_nodes[page_id] = node;
-    if (next_leaf_page_id != 0)
+bool BPTree::WriteNodePage(const Node* node)
+{
+    assert(node && "WriteNodePage: node is nullptr.");
+    // evictions can reach here before the first flush created the file
+    if (!OpenStorage())
     {
-        Node* next_leaf = LoadNodePage(in, next_leaf_page_id, pending_children);
-        if (!next_leaf)
-        {
-            m_nodes.erase(page_id);
-            delete node;
-            return nullptr;
-        }
-        node->m_next_leaf = next_leaf;
+        return false;
     }
-    return node;
+
+    std::vector<char> buffer(m_page_size);
+    return EncodeNodePage(node, buffer.data()) && m_storage.WriteAt(node->m_page_id * m_page_size, buffer.data(), buffer.size());
 }
 
-bool BPTree::WriteNodePage(std::ostream& out, const Node* node)
+bool BPTree::EncodeNodePage(const Node* node, char* buffer)
 {
-    assert(node && "WriteNodePage: node is nullptr.");
-    std::array<char, kPageSize> buffer {};
+    if (NodeBytes(node) > m_page_size)
+    {
+        return false;
+    }
+
+    std::memset(buffer, 0, m_page_size);
     size_t offset = 0;
-    WriteUint32(buffer.data(), offset, static_cast<uint32_t>(node->m_is_leaf ? PageType::kLeaf : PageType::kInternal));
-    WriteUint64(buffer.data(), offset, node->m_page_id);
-    WriteUint64(buffer.data(), offset, node->m_parent_page_id);
-    WriteUint64(buffer.data(), offset, node->m_next_leaf ? node->m_next_leaf->m_page_id : 0);
-    WriteUint32(buffer.data(), offset, static_cast<uint32_t>(node->m_keys.size()));
-    for (const std::string& key : node->m_keys)
+    WriteUint32(buffer, offset, static_cast<uint32_t>(node->m_is_leaf ? PageType::kLeaf : PageType::kInternal));
+    WriteUint64(buffer, offset, node->m_page_id);
+    WriteUint64(buffer, offset, node->m_lsn);
+    WriteUint64(buffer, offset, node->m_next_leaf);
+    WriteUint64(buffer, offset, node->m_prev_leaf);
+    WriteUint32(buffer, offset, static_cast<uint32_t>(node->GetSize()));
+    // the prefix every key shares, then the rest of each key
+    const KeyArray& keys = node->m_keys;
+    const size_t prefix = keys.Empty() ? 0 : CommonPrefix(keys.Front(), keys.Back());
+    WriteKey(buffer, offset, keys.Empty() ? std::string_view() : keys.Front().substr(0, prefix));
+    for (size_t i = 0; i < keys.Size(); ++i)
     {
-        WriteString(buffer.data(), offset, key);
+        WriteKey(buffer, offset, keys[i].substr(prefix));
     }
 
     if (node->m_is_leaf)
     {
         for (const std::string& value : node->m_values)
         {
-            WriteString(buffer.data(), offset, value);
+            WriteString(buffer, offset, value);
         }
     }
     else
     {
-        WriteUint32(buffer.data(), offset, static_cast<uint32_t>(node->m_children.size()));
-        for (Node* child : node->m_children)
+        WriteUint32(buffer, offset, static_cast<uint32_t>(node->m_children.size()));
+        for (uint64_t child_page_id : node->m_children)
         {
-            WriteUint64(buffer.data(), offset, child->m_page_id);
+            WriteUint64(buffer, offset, child_page_id);
         }
     }
-
-    auto* io = dynamic_cast<std::fstream*>(&out);
-    assert(io && "WriteNodePage requires fstream.");
-    io->seekp(static_cast<std::streamoff>(node->m_page_id * kPageSize), std::ios::beg);
-    io->write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
-    return io->good();
+    return true;
 }
 
-bool BPTree::OpenStorage(std::fstream& io)
+uint64_t BPTree::ReadFreePage(uint64_t page_id)
 {
-    io.open(m_file, std::ios::in | std::ios::out | std::ios::binary);
-    if (io.good())
+    std::vector<char> buffer(m_page_size);
+    if (!m_storage.ReadAt(page_id * m_page_size, buffer.data(), buffer.size()))
     {
-        return true;
+        throw std::runtime_error("bptree free page is unreadable");
     }
 
-    std::ofstream create(m_file, std::ios::binary | std::ios::trunc);
-    if (!create.good())
+    size_t offset = 0;
+    const PageType page_type = static_cast<PageType>(ReadUint32(buffer.data(), offset));
+    const uint64_t stored_page_id = ReadUint64(buffer.data(), offset);
+    if (page_type != PageType::kFree || stored_page_id != page_id)
     {
-        return false;
+        throw std::runtime_error("bptree free page chain is corrupted");
     }
-    create.close();
+    offset += sizeof(uint64_t);  // page lsn
+    return ReadUint64(buffer.data(), offset);
+}
+
+bool BPTree::WriteFreePage(uint64_t page_id, uint64_t next_free_page_id)
+{
+    std::vector<char> buffer(m_page_size);
+    EncodeFreePage(page_id, next_free_page_id, buffer.data());
+    return m_storage.WriteAt(page_id * m_page_size, buffer.data(), buffer.size());
+}
+
+void BPTree::EncodeFreePage(uint64_t page_id, uint64_t next_free_page_id, char* buffer)
+{
+    std::memset(buffer, 0, m_page_size);
+    size_t offset = 0;
+    WriteUint32(buffer, offset, static_cast<uint32_t>(PageType::kFree));
+    WriteUint64(buffer, offset, page_id);
+    WriteUint64(buffer, offset, 0);
+    WriteUint64(buffer, offset, next_free_page_id);
+}
+
+bool BPTree::OpenStorage()
+{
+    std::lock_guard<std::mutex> lock(m_storage_mutex);
+    return m_storage.IsOpen() || m_storage.Open(m_file, true);
+}
 
-    io.clear();
-    io.open(m_file, std::ios::in | std::ios::out | std::ios::binary);
-    return io.good();
+void BPTree::WriteUint16(char* buffer, size_t& offset, uint16_t value)
+{
+    assert(offset + sizeof(value) <= m_page_size && "page buffer overflow");
+    std::memcpy(buffer + offset, &value, sizeof(value));
+    offset += sizeof(value);
 }
 
 void BPTree::WriteUint32(char* buffer, size_t& offset, uint32_t value)
 {
-    assert(offset + sizeof(value) <= kPageSize && "page buffer overflow");
+    assert(offset + sizeof(value) <= m_page_size && "page buffer overflow");
     std::memcpy(buffer + offset, &value, sizeof(value));
     offset += sizeof(value);
 }
 
 void BPTree::WriteUint64(char* buffer, size_t& offset, uint64_t value)
 {
-    assert(offset + sizeof(value) <= kPageSize && "page buffer overflow");
+    assert(offset + sizeof(value) <= m_page_size && "page buffer overflow");
     std::memcpy(buffer + offset, &value, sizeof(value));
     offset += sizeof(value);
 }
 
-void BPTree::WriteString(char* buffer, size_t& offset, const std::string& value)
+void BPTree::WriteString(char* buffer, size_t& offset, std::string_view value)
 {
     WriteUint32(buffer, offset, static_cast<uint32_t>(value.size()));
-    assert(offset + value.size() <= kPageSize && "page buffer overflow");
+    assert(offset + value.size() <= m_page_size && "page buffer overflow");
     std::memcpy(buffer + offset, value.data(), value.size());
     offset += value.size();
 }
 
+void BPTree::WriteKey(char* buffer, size_t& offset, std::string_view key)
+{
+    // keys are at most a quarter page, and pages at most 64 KB
+    WriteUint16(buffer, offset, static_cast<uint16_t>(key.size()));
+    assert(offset + key.size() <= m_page_size && "page buffer overflow");
+    std::memcpy(buffer + offset, key.data(), key.size());
+    offset += key.size();
+}
+
+uint16_t BPTree::ReadUint16(const char* buffer, size_t& offset) const
+{
+    uint16_t value = 0;
+    std::memcpy(&value, buffer + offset, sizeof(value));
+    offset += sizeof(value);
+    return value;
+}
+
 uint32_t BPTree::ReadUint32(const char* buffer, size_t& offset) const
 {
     uint32_t value = 0;
@@ -653,10 +2226,22 @@ uint64_t BPTree::ReadUint64(const char* buffer, size_t& offset) const
 }
 
 std::string BPTree::ReadString(const char* buffer, size_t& offset) const
+{
+    return std::string(ReadStringView(buffer, offset));
+}
+
+std::string_view BPTree::ReadStringView(const char* buffer, size_t& offset) const
 {
     const uint32_t size = ReadUint32(buffer, offset);
-    std::string value(size, '\0');
-    std::memcpy(value.data(), buffer + offset, size);
+    std::string_view value(buffer + offset, size);
     offset += size;
     return value;
 }
+
+std::string_view BPTree::ReadKey(const char* buffer, size_t& offset) const
+{
+    const uint16_t size = ReadUint16(buffer, offset);
+    std::string_view key(buffer + offset, size);
+    offset += size;
+    return key;
+}
@@ -2,14 +2,20 @@
 #define _BPTREE_H_
 
 #include <cstdint>
-#include <istream>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <optional>
-#include <ostream>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
-#include <unordered_set>
+#include <utility>
 #include <vector>
+#include "buffer_pool.h"
+#include "file.h"
 #include "node.h"
+#include "wal.h"
 
 struct Data
 {
@@ -23,21 +29,179 @@ struct Data
     const char* m_data;
 };
 
+struct BPTreeOptions
+{
+    //! number of decoded pages kept resident, 4 MB of 4 KB pages by default
+    size_t m_frame_budget { 1024 };
+    //! log page images here before they reach the tree file, not owned; nullptr writes pages in place
+    Wal* m_wal { nullptr };
+    //! tags this tree's records when several files share m_wal
+    uint32_t m_wal_file_id { 0 };
+    //! page size of a new file, a power of two from 4 KB to 64 KB; an existing file keeps its own
+    uint32_t m_page_size { 4096 };
+    //! typical key and value lengths, from which a node_size of 0 is derived for a new file
+    size_t m_key_width { 16 };
+    size_t m_value_width { 8 };
+    //! decode pages straight from a shared read-only mapping of the tree file instead of
+    //! reading them into a buffer; processes opening the same file share the cached pages
+    bool m_mmap_reads { false };
+};
+
+//! @brief B+Tree over fixed-size pages of one file
+//!
+//! Search, Scan, ScanPrefix, Insert and Erase may be called from many threads at once.
+//! They share the tree latch and crab down with per-node latches: shared on internal
+//! nodes, exclusive on the leaf for writers. An Insert that would split a leaf or an
+//! Erase that would leave it underfull lets go and retries with the tree latch held
+//! exclusively, as do every other mutating call. Cursors, Traverse and GetRoot are not
+//! latched and need the caller to keep writers out. A Handle shares the tree latch for
+//! as long as it lives.
+//!
+//! A node splits once it holds more than node_size keys or no longer fits in a page.
+//! Values longer than a sixteenth of a page are stored in a chain of overflow pages and
+//! the leaf keeps only a reference to it; keys longer than a quarter page are rejected.
+//! The page size is fixed when the file is created and recorded in its meta page.
 class BPTree
 {
 public:
-    explicit BPTree(std::string filename, size_t node_size);
+    using Record = std::pair<std::string, std::string>;
+    using Visitor = std::function<bool(std::string_view key, std::string_view value)>;
+
+    //! @brief position in the leaf chain, moving between leaves without re-descending
+    //!
+    //! The current leaf stays pinned while the cursor points into it. Modifying the
+    //! tree invalidates every open cursor.
+    class Cursor
+    {
+    public:
+        Cursor() = default;
+        Cursor(Cursor&& other) noexcept;
+        Cursor& operator=(Cursor&& other) noexcept;
+        ~Cursor();
+
+        bool Valid() const;
+        void Next();
+        void Prev();
+        std::string_view Key() const;
+        //! @brief an overflowed value is read into a buffer of the cursor, valid until the next call
+        std::string_view Value() const;
+
+    private:
+        friend class BPTree;
+        Cursor(const BPTree* tree, Node* leaf, size_t slot);
+        void Move(uint64_t page_id, bool forward);
+        void Release();
+
+        const BPTree* m_tree { nullptr };
+        Node* m_leaf { nullptr };
+        size_t m_slot { 0 };
+        mutable std::string m_value;
+    };
+
+    //! @brief values looked up by Get or MultiGet, kept in place by pinning and latching their leaves
+    //!
+    //! While a handle lives its values neither move nor change: writers to those leaves and
+    //! structure changes wait until it is released. The thread holding a handle must release
+    //! it before calling into the tree again.
+    class Handle
+    {
+    public:
+        Handle() = default;
+        Handle(Handle&& other) noexcept;
+        Handle& operator=(Handle&& other) noexcept;
+        ~Handle();
+
+        //! @brief whether the first key was found, the only one for Get
+        explicit operator bool() const;
+        //! @brief number of keys looked up
+        size_t Size() const;
+        bool Has(size_t index = 0) const;
+        std::string_view Value(size_t index = 0) const;
+
+    private:
+        friend class BPTree;
+        void Release();
+
+        const BPTree* m_tree { nullptr };
+        std::shared_lock<std::shared_mutex> m_tree_latch;
+        //! pinned and latched shared
+        std::vector<Node*> m_leaves;
+        std::vector<std::optional<std::string_view>> m_values;
+        //! overflowed values read out of their page chains, a deque so they never move
+        std::deque<std::string> m_overflow_values;
+    };
+
+    //! @brief open or create the tree in filename
+    //!
+    //! A node_size of 0 adopts the one an existing file was created with, and for a new file
+    //! derives it from the page size and the key and value widths in options.
+    explicit BPTree(std::string filename, size_t node_size, BPTreeOptions options = BPTreeOptions());
     ~BPTree();
 
+    //! @brief false if the key is longer than a quarter page or a page could not be written
     bool Insert(const std::string& key, const void* value, size_t size);
+    //! @brief remove key, rebalancing underfull nodes and returning freed pages to the free list
+    bool Erase(const std::string& key);
+
+    //! @brief defer page writes until Commit, repeated updates of a page are written once
+    void BeginBatch();
+    bool Commit();
+    //! @brief end the batch by appending its pages to the log without a commit record
+    //!
+    //! The next commit of the shared log, by whichever file makes it, commits them together
+    //! with its own records, so several trees can change in one atomic commit.
+    bool LogBatch();
+
+    //! @brief replace the tree with records, building it bottom-up with sequential page writes
+    //!
+    //! Records are sorted first unless already in key order; for duplicate keys the last one wins.
+    //! Nodes are packed to fill_factor of node_size so later inserts do not split immediately.
+    //! The pages bypass the write-ahead log, so its owner checkpoints and truncates it first.
+    bool BulkLoad(std::vector<Record> records, double fill_factor = 0.9);
+    //! @brief write every committed page to the tree file and sync it, after which the log may be truncated
+    bool Checkpoint();
 
     void Traverse(Node* node);
     void TraverseLeaf(Node* leaf_node);
     void TraverseIndex(Node* index_node);
 
+    //! @brief the value is copied into a per-thread buffer, valid until this thread's next Search;
+    //! Get avoids the copy
     std::optional<Data> Search(const std::string& key) const;
+    //! @brief zero-copy lookup, the value stays valid while the handle is held
+    Handle Get(const std::string& key) const;
+    //! @brief look up keys in one pass: they are resolved in sorted order and keys that land in
+    //! the leaf already reached share its descent; values are indexed in the order of keys
+    Handle MultiGet(const std::vector<std::string>& keys) const;
+    Cursor Begin() const;
+    Cursor Last() const;
+    //! @brief first entry with key >= key
+    Cursor LowerBound(const std::string& key) const;
+    //! @brief first entry with key > key
+    Cursor UpperBound(const std::string& key) const;
+    //! @brief visit [start, end) in key order, an empty end is unbounded; stop once visitor returns false
+    //!
+    //! The visited leaf stays latched shared, so the visitor must not modify the tree.
+    void Scan(const std::string& start, const std::string& end, const Visitor& visitor) const;
+    void ScanPrefix(const std::string& prefix, const Visitor& visitor) const;
+    //! @brief ascending keys that split the tree into subtrees of about equal size
+    //!
+    //! The separators of the first level from the root with at least parts nodes, or of the
+    //! level above the leaves if none has that many. Ranges between consecutive keys can be
+    //! scanned independently, for example by different threads.
+    std::vector<std::string> SplitKeys(size_t parts) const;
+
     void DeleteIndexNode(Node* node);
     Node* GetRoot();
+    size_t CachedPages() const;
+    uint32_t PageSize() const;
+    size_t NodeSize() const;
+    //! @brief the longest key Insert and BulkLoad accept: a quarter page, so a page always holds
+    //! at least three separators
+    size_t MaxKeySize() const;
+
+    //! @brief keys per node that fill a page with keys and values of about these lengths
+    static size_t FanOut(uint32_t page_size, size_t key_width, size_t value_width);
 
 private:
     enum class PageType : uint8_t
@@ -45,6 +209,17 @@ private:
         kMeta = 1,
         kLeaf = 2,
         kInternal = 3,
+        kFree = 4,
+        kOverflow = 5,
+    };
+
+    //! @brief last byte of every stored leaf value, saying what precedes it
+    enum class ValueTag : char
+    {
+        //! the value itself
+        kInline = 0,
+        //! u64 first overflow page id and u64 value size
+        kOverflow = 1,
     };
 
     struct MetaPage
@@ -56,51 +231,172 @@ private:
         uint64_t m_node_size;
         uint64_t m_root_page_id;
         uint64_t m_next_page_id;
-    };
-
-    struct PendingChildren
-    {
-        Node* m_node;
-        std::vector<uint64_t> m_child_page_ids;
+        uint64_t m_free_page_id;
+        uint64_t m_lsn;
     };
 
     Node* CreateNode(bool is_leaf);
-    Node* GetNode(uint64_t page_id) const;
+    uint64_t AllocatePageId();
+    void FreeNode(Node* node);
+    void FreePage(uint64_t page_id);
+    void Rebalance(std::vector<Node*>& path);
+    void BorrowFromLeft(Node* node, Node* left, Node* parent, size_t index);
+    void BorrowFromRight(Node* node, Node* right, Node* parent, size_t index);
+    void MergeIntoLeft(Node* left, Node* node, Node* parent, size_t index);
+    size_t MinKeys(const Node* node) const;
+    //! @brief fewer than the minimum keys and less than half a page of bytes
+    bool Underfull(const Node* node) const;
+    //! @brief more than node_size keys or more bytes than a page holds
+    bool Overfull(const Node* node) const;
+    bool CanBorrow(const Node* node, const Node* sibling, const Node* parent, size_t index, bool from_left) const;
+    bool CanMerge(const Node* left, const Node* node, const Node* parent, size_t index) const;
+    //! @brief encoded size of the node's page
+    static size_t NodeBytes(const Node* node);
+    //! @brief encoded size of the node's page without key i and its value or one child
+    static size_t NodeBytesWithout(const Node* node, size_t i);
+    //! @brief encoded size of count keys of bytes in total that sort from front to back
+    //!
+    //! The common prefix of a page's keys, which is the common prefix of its first and last
+    //! key, is stored once; every key keeps only the rest.
+    static size_t KeyBytes(size_t count, size_t bytes, std::string_view front, std::string_view back);
+    static size_t KeyBytes(const KeyArray& keys);
+    //! @brief encoded size of the values, or of the children, of a node
+    static size_t PayloadBytes(const Node* node);
+    static size_t CommonPrefix(std::string_view lhs, std::string_view rhs);
+    //! @brief the shortest key that sorts after left and not after right
+    static std::string Separator(std::string_view left, std::string_view right);
+    //! @brief first key of the upper half: by count, or by bytes when the node outgrew its page
+    //!
+    //! A node that outgrew its page is split where both halves fit, as close to the middle of
+    //! its bytes as possible.
+    size_t SplitPosition(const Node* node) const;
     void MarkDirty(Node* node);
-    void InsertIntoLeaf(Node* leaf, const std::string& key, const std::string& value);
+    void MarkMetaDirty();
+    void UnpinAll(const std::vector<Node*>& nodes) const;
+    //! @brief value is already in its stored form, see StoreValue
+    void InsertIntoLeaf(Node* leaf, const std::string& key, std::string value);
     Node* SplitLeafNode(Node* leaf);
-    bool InsertInternal(const std::string& key, Node* cursor, Node* child);
+    void InsertInternal(std::string key, const std::vector<Node*>& path, uint64_t left_page_id, uint64_t right_page_id);
     Node* SplitInternalNode(Node* node, std::string& promoted_key);
-    std::pair<Node*, Node*> FindLeaf(const std::string& key) const;
+    //! @brief Insert and Erase that only touch one leaf, nullopt when the structure has to change
+    std::optional<bool> InsertIntoSafeLeaf(const std::string& key, const void* value, size_t size);
+    std::optional<bool> EraseFromSafeLeaf(const std::string& key);
+    bool InsertExclusive(const std::string& key, const void* value, size_t size);
+    bool EraseExclusive(const std::string& key);
+    //! @brief crab down to the pinned leaf for key, latched exclusively if exclusive and shared otherwise
+    //!
+    //! If the leaf is held, which this thread already pinned and latched shared, it is
+    //! returned as is.
+    Node* LatchLeaf(const std::string& key, bool exclusive, const Node* held = nullptr) const;
+    void VisitFrom(const std::string& start, const Visitor& visitor) const;
+    Node* FindLeaf(const std::string& key, std::vector<Node*>* path) const;
+    Node* FindEdgeLeaf(bool leftmost) const;
     void AddRecord(Node* cur, const std::string& key, const void* value, size_t size);
-    Node* DeleteNode(Node* node);
-    void DeleteAllNodes();
+    void DeleteNode(Node* node);
+    //! @brief node sizes for item_count items, at most per_node each and no more than fits(begin, count) allows
+    static std::vector<size_t> PlanLevel(size_t item_count, size_t per_node, size_t min_per_node, const std::function<bool(size_t, size_t)>& fits);
 
+    //! @brief the leaf form of a value: inline with its tag, or written to new overflow pages
+    std::string StoreValue(std::string value);
+    static bool IsOverflow(const std::string& stored);
+    //! @brief the value of an inline stored value
+    static std::string_view InlineValue(const std::string& stored);
+    static bool ValidPageSize(uint32_t page_size);
+    //! @brief a sixteenth of a page, longer values go to overflow pages
+    size_t MaxInlineValue() const;
+    size_t OverflowCapacity() const;
+    //! @brief the value of any stored value, read from its overflow pages if needed
+    bool ReadValue(const std::string& stored, std::string& value) const;
+    //! @brief return the overflow pages of a stored value to the free list
+    void FreeValue(const std::string& stored);
+    //! @brief a pending overflow page or one read from the tree file, false if it is not an overflow page
+    bool ReadOverflowPage(uint64_t page_id, char* buffer) const;
+    bool WriteOverflowPages();
     bool LoadFromDisk();
+    bool Recover();
     bool FlushDirtyPages();
-    bool LoadMetaPage(std::istream& in, MetaPage& meta);
-    bool WriteMetaPage(std::ostream& out);
-    Node* LoadNodePage(std::istream& in, uint64_t page_id, std::vector<PendingChildren>& pending_children);
-    bool WriteNodePage(std::ostream& out, const Node* node);
-    bool OpenStorage(std::fstream& io);
+    //! @brief append the images of unlogged pages to the log and, if commit, commit it
+    bool LogDirtyPages(bool commit);
+    //! @brief stop tracking pages whose change counts are still those logged
+    void ForgetLoggedPages(const std::vector<std::pair<uint64_t, uint64_t>>& pages);
+    bool WriteDirtyPages();
+    bool WriteBackPage(const Node* node);
+    bool LoadMetaPage(MetaPage& meta);
+    bool WriteMetaPage();
+    void EncodeMetaPage(char* buffer);
+    Node* LoadNodePage(uint64_t page_id);
+    bool WriteNodePage(const Node* node);
+    //! @brief false, leaving buffer untouched, if the node does not fit in a page
+    bool EncodeNodePage(const Node* node, char* buffer);
+    uint64_t ReadFreePage(uint64_t page_id);
+    bool WriteFreePage(uint64_t page_id, uint64_t next_free_page_id);
+    void EncodeFreePage(uint64_t page_id, uint64_t next_free_page_id, char* buffer);
+    bool OpenStorage();
+    void WriteUint16(char* buffer, size_t& offset, uint16_t value);
     void WriteUint32(char* buffer, size_t& offset, uint32_t value);
     void WriteUint64(char* buffer, size_t& offset, uint64_t value);
-    void WriteString(char* buffer, size_t& offset, const std::string& value);
+    void WriteString(char* buffer, size_t& offset, std::string_view value);
+    //! @brief a key or key prefix, with a 2-byte length
+    void WriteKey(char* buffer, size_t& offset, std::string_view key);
+    uint16_t ReadUint16(const char* buffer, size_t& offset) const;
     uint32_t ReadUint32(const char* buffer, size_t& offset) const;
     uint64_t ReadUint64(const char* buffer, size_t& offset) const;
     std::string ReadString(const char* buffer, size_t& offset) const;
+    std::string_view ReadStringView(const char* buffer, size_t& offset) const;
+    std::string_view ReadKey(const char* buffer, size_t& offset) const;
 
     static constexpr uint32_t kFileMagic = 0x42505431;  // BPT1
-    static constexpr uint32_t kFileVersion = 1;
-    static constexpr uint32_t kPageSize = 4096;
+    static constexpr uint32_t kFileVersion = 7;
+    static constexpr uint32_t kMinPageSize = 4096;
+    static constexpr uint32_t kMaxPageSize = 65536;
+    //! type, page id, lsn, next and previous leaf, key count
+    static constexpr size_t kNodeHeaderSize = sizeof(uint32_t) * 2 + sizeof(uint64_t) * 4;
+    //! type, page id, lsn, next overflow page id, chunk length
+    static constexpr size_t kOverflowHeaderSize = sizeof(uint32_t) * 2 + sizeof(uint64_t) * 3;
+    //! page id and size in front of the tag
+    static constexpr size_t kOverflowRefSize = sizeof(uint64_t) * 2 + 1;
+    //! the page lsn follows the type and page id on node and free pages, and ends the meta page fields
+    static constexpr size_t kPageLsnOffset = sizeof(uint32_t) + sizeof(uint64_t);
+    static constexpr size_t kMetaLsnOffset = sizeof(uint32_t) * 5 + sizeof(uint64_t) * 4;
 
     std::string m_file;
+    //! taken from the meta page once the file exists
+    uint32_t m_page_size;
+    bool m_mmap_reads;
+    File m_storage;
+    std::mutex m_storage_mutex;
+    //! shared by operations confined to one leaf, exclusive for structure changes
+    mutable std::shared_mutex m_tree_latch;
+    //! one flush encodes and logs or writes dirty pages at a time
+    std::mutex m_flush_mutex;
     size_t m_record_max_size;
-    Node* m_root;
+    uint64_t m_root_page_id;
     uint64_t m_next_page_id;
-    std::unordered_map<uint64_t, Node*> m_nodes;
-    std::unordered_set<uint64_t> m_dirty_pages;
+    //! head of the on-disk free page chain
+    uint64_t m_free_page_id;
+    //! freed pages whose free-chain link has not been written yet
+    std::unordered_map<uint64_t, uint64_t> m_freed_pages;
+    mutable BufferPool m_pool;
+    //! meta page fields not yet written to the tree file
     bool m_meta_dirty;
+    bool m_in_batch;
+    Wal* m_wal;
+    uint32_t m_wal_file_id;
+    //! pages changed since the last commit, with a count of their changes; with a log they may
+    //! not be written back before it
+    std::unordered_map<uint64_t, uint64_t> m_unlogged_pages;
+    //! guards m_unlogged_pages, which writers, flushes and evictions all reach
+    mutable std::mutex m_unlogged_mutex;
+    bool m_meta_unlogged;
+    uint64_t m_meta_lsn;
+    //! pages LogBatch appended to the log, tracked as unlogged until a commit covers m_staged_lsn
+    std::vector<std::pair<uint64_t, uint64_t>> m_staged_pages;
+    uint64_t m_staged_lsn;
+    //! images of overflow pages not yet in the tree file; like other pages they reach it at
+    //! the next flush without a log and at the next checkpoint with one
+    std::unordered_map<uint64_t, std::vector<char>> m_pending_overflow;
+    //! guards m_pending_overflow, which readers reach while writers flush
+    mutable std::mutex m_overflow_mutex;
 };
 
 #endif
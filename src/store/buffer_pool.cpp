@@ -0,0 +1,232 @@
+#include "buffer_pool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+BufferPool::BufferPool(size_t capacity, PageReader reader, PageWriter writer)
+    : m_capacity(capacity)
+    , m_reader(std::move(reader))
+    , m_writer(std::move(writer))
+    , m_clock_hand(m_clock.end())
+{
+    assert(m_capacity > 0 && "BufferPool: capacity must be positive.");
+}
+
+BufferPool::~BufferPool()
+{
+    Clear();
+}
+
+Node* BufferPool::Fetch(uint64_t page_id)
+{
+    if (page_id == 0)
+    {
+        return nullptr;
+    }
+
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        if (Frame* frame = Find(page_id))
+        {
+            ++frame->m_pin_count;
+            frame->m_referenced.store(true, std::memory_order_relaxed);
+            return frame->m_node;
+        }
+    }
+
+    // another thread may have loaded the page between the two locks
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    if (Frame* frame = Find(page_id))
+    {
+        ++frame->m_pin_count;
+        frame->m_referenced.store(true, std::memory_order_relaxed);
+        return frame->m_node;
+    }
+
+    EvictIfNeeded();
+    Node* node = m_reader(page_id);
+    if (!node)
+    {
+        return nullptr;
+    }
+    return Insert(node).m_node;
+}
+
+void BufferPool::Put(Node* node)
+{
+    assert(node && "Put: node is nullptr.");
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    assert(!Find(node->m_page_id) && "Put: page already cached.");
+    EvictIfNeeded();
+    SetDirty(Insert(node), true);
+}
+
+void BufferPool::Unpin(const Node* node)
+{
+    assert(node && "Unpin: node is nullptr.");
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    Frame* frame = Find(node->m_page_id);
+    assert(frame && "Unpin: page is not cached.");
+    const size_t pin_count = frame->m_pin_count--;
+    assert(pin_count > 0 && "Unpin: page is not pinned.");
+    (void) pin_count;
+}
+
+void BufferPool::MarkDirty(const Node* node)
+{
+    assert(node && "MarkDirty: node is nullptr.");
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    Frame* frame = Find(node->m_page_id);
+    assert(frame && "MarkDirty: page is not cached.");
+    SetDirty(*frame, true);
+}
+
+void BufferPool::Erase(uint64_t page_id)
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    Frame* frame = Find(page_id);
+    if (!frame)
+    {
+        return;
+    }
+
+    if (m_clock_hand == frame->m_clock_pos)
+    {
+        ++m_clock_hand;
+    }
+    m_clock.erase(frame->m_clock_pos);
+    SetDirty(*frame, false);
+    delete frame->m_node;
+    m_frames.erase(page_id);
+}
+
+bool BufferPool::FlushAll()
+{
+    // pin the dirty frames so they stay put, then write them without holding the pool:
+    // a writer holding a frame's latch may need the pool before it lets go
+    std::vector<std::pair<uint64_t, Frame*>> dirty_frames;
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        for (auto& [page_id, frame] : m_frames)
+        {
+            if (frame.m_dirty)
+            {
+                ++frame.m_pin_count;
+                dirty_frames.emplace_back(page_id, &frame);
+            }
+        }
+    }
+    std::sort(dirty_frames.begin(), dirty_frames.end());
+
+    bool flushed = true;
+    for (const auto& [page_id, frame] : dirty_frames)
+    {
+        (void) page_id;
+        if (flushed)
+        {
+            // the latch keeps the frame from changing between the write and clearing its dirty bit
+            std::shared_lock<std::shared_mutex> latch(frame->m_node->m_latch);
+            flushed = m_writer(frame->m_node);
+            if (flushed)
+            {
+                SetDirty(*frame, false);
+            }
+        }
+        --frame->m_pin_count;
+    }
+    return flushed;
+}
+
+void BufferPool::Clear()
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    for (auto& [page_id, frame] : m_frames)
+    {
+        (void) page_id;
+        delete frame.m_node;
+    }
+    m_frames.clear();
+    m_clock.clear();
+    m_clock_hand = m_clock.end();
+    m_dirty_count = 0;
+}
+
+bool BufferPool::HasDirty() const
+{
+    return m_dirty_count > 0;
+}
+
+size_t BufferPool::Size() const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_frames.size();
+}
+
+size_t BufferPool::Capacity() const
+{
+    return m_capacity;
+}
+
+BufferPool::Frame* BufferPool::Find(uint64_t page_id)
+{
+    auto it = m_frames.find(page_id);
+    return it == m_frames.end() ? nullptr : &it->second;
+}
+
+BufferPool::Frame& BufferPool::Insert(Node* node)
+{
+    Frame& frame = m_frames[node->m_page_id];
+    frame.m_node = node;
+    frame.m_pin_count = 1;
+    frame.m_clock_pos = m_clock.insert(m_clock_hand, node->m_page_id);
+    return frame;
+}
+
+void BufferPool::EvictIfNeeded()
+{
+    // sweep at most twice around the clock: the first pass may only clear reference bits;
+    // pinned frames and frames the writer refuses are skipped
+    for (size_t steps = 2 * m_clock.size(); m_frames.size() >= m_capacity && steps > 0; --steps)
+    {
+        if (m_clock_hand == m_clock.end())
+        {
+            m_clock_hand = m_clock.begin();
+        }
+        const uint64_t page_id = *m_clock_hand++;
+        Frame& frame = m_frames.at(page_id);
+        if (frame.m_pin_count == 0 && !frame.m_referenced.exchange(false))
+        {
+            Evict(page_id);
+        }
+    }
+}
+
+bool BufferPool::Evict(uint64_t page_id)
+{
+    Frame& frame = m_frames.at(page_id);
+    assert(frame.m_pin_count == 0 && "Evict: invalid victim.");
+    if (frame.m_dirty)
+    {
+        if (!m_writer(frame.m_node))
+        {
+            return false;
+        }
+        SetDirty(frame, false);
+    }
+
+    m_clock.erase(frame.m_clock_pos);
+    delete frame.m_node;
+    m_frames.erase(page_id);
+    return true;
+}
+
+void BufferPool::SetDirty(Frame& frame, bool dirty)
+{
+    if (frame.m_dirty.exchange(dirty) != dirty)
+    {
+        dirty ? ++m_dirty_count : --m_dirty_count;
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef _BUFFER_POOL_H_
+#define _BUFFER_POOL_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <shared_mutex>
+#include <unordered_map>
+#include "node.h"
+
+//! @brief fixed-budget cache of decoded B+Tree pages
+//!
+//! Frames are faulted in through the reader callback and written back through
+//! the writer callback when a dirty frame is evicted. Only unpinned frames are
+//! candidates for eviction and they are replaced in clock (second chance) order;
+//! the writer may refuse a frame to keep it resident. The budget is soft: if no
+//! frame can be evicted the pool grows instead of failing.
+//!
+//! Every call is thread-safe. A hit only takes the frame table shared and bumps
+//! atomic counters, so concurrent readers do not serialize on the pool; misses,
+//! evictions and structural changes take it exclusively. Frames are handed out
+//! pinned but unlatched and callers latch the node themselves. An unpinned frame
+//! is never latched, so eviction writes it back without latching, while FlushAll
+//! shares the latch of each frame it writes.
+class BufferPool
+{
+public:
+    using PageReader = std::function<Node*(uint64_t page_id)>;
+    using PageWriter = std::function<bool(const Node* node)>;
+
+    BufferPool(size_t capacity, PageReader reader, PageWriter writer);
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    //! @brief return the pinned node for page_id, loading it on a miss
+    Node* Fetch(uint64_t page_id);
+    //! @brief take ownership of a freshly created node, pinned and dirty
+    void Put(Node* node);
+    void Unpin(const Node* node);
+    //! @brief called with the node latched exclusively or the tree held exclusively
+    void MarkDirty(const Node* node);
+    //! @brief drop a frame without writing it back, whether pinned or not
+    void Erase(uint64_t page_id);
+    //! @brief write every dirty frame in page id order, holding each frame's latch shared
+    bool FlushAll();
+    void Clear();
+
+    bool HasDirty() const;
+    size_t Size() const;
+    size_t Capacity() const;
+
+private:
+    struct Frame
+    {
+        Node* m_node { nullptr };
+        std::atomic<size_t> m_pin_count { 0 };
+        //! set on every fetch, cleared as the clock hand passes
+        std::atomic<bool> m_referenced { true };
+        std::atomic<bool> m_dirty { false };
+        std::list<uint64_t>::iterator m_clock_pos;
+    };
+
+    Frame* Find(uint64_t page_id);
+    Frame& Insert(Node* node);
+    void EvictIfNeeded();
+    bool Evict(uint64_t page_id);
+    void SetDirty(Frame& frame, bool dirty);
+
+    //! shared for lookups and pin changes, exclusive to add or drop frames
+    mutable std::shared_mutex m_mutex;
+    size_t m_capacity;
+    PageReader m_reader;
+    PageWriter m_writer;
+    std::unordered_map<uint64_t, Frame> m_frames;
+    //! every frame in insertion order, swept by m_clock_hand
+    std::list<uint64_t> m_clock;
+    std::list<uint64_t>::iterator m_clock_hand;
+    std::atomic<size_t> m_dirty_count { 0 };
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+File::~File()
+{
+    Close();
+}
+
+bool File::Open(const std::string& path, bool create)
+{
+    Close();
+    const int flags = O_RDWR | (create ? O_CREAT : 0);
+    m_fd = ::open(path.c_str(), flags, 0644);
+    m_size = Size();
+    return m_fd >= 0;
+}
+
+void File::Close()
+{
+    for (const std::unique_ptr<Mapping>& mapping : m_mappings)
+    {
+        ::munmap(const_cast<char*>(mapping->m_data), mapping->m_length);
+    }
+    m_mappings.clear();
+    m_mapping = nullptr;
+    if (m_fd >= 0)
+    {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool File::IsOpen() const
+{
+    return m_fd >= 0;
+}
+
+bool File::ReadAt(uint64_t offset, void* buffer, size_t size) const
+{
+    char* out = static_cast<char*>(buffer);
+    while (size > 0)
+    {
+        const ssize_t n = ::pread(m_fd, out, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        out += n;
+        offset += static_cast<uint64_t>(n);
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool File::WriteAt(uint64_t offset, const void* buffer, size_t size)
+{
+    const char* in = static_cast<const char*>(buffer);
+    while (size > 0)
+    {
+        const ssize_t n = ::pwrite(m_fd, in, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        in += n;
+        offset += static_cast<uint64_t>(n);
+        size -= static_cast<size_t>(n);
+    }
+    uint64_t known = m_size.load();
+    while (offset > known && !m_size.compare_exchange_weak(known, offset))
+        ;
+    return true;
+}
+
+bool File::Sync()
+{
+    return ::fdatasync(m_fd) == 0;
+}
+
+bool File::Truncate(uint64_t size)
+{
+    if (::ftruncate(m_fd, static_cast<off_t>(size)) != 0)
+    {
+        return false;
+    }
+    m_size = size;
+    return true;
+}
+
+uint64_t File::Size() const
+{
+    struct stat st {};
+    if (::fstat(m_fd, &st) != 0)
+    {
+        return 0;
+    }
+    return static_cast<uint64_t>(st.st_size);
+}
+
+const char* File::MappedAt(uint64_t offset, size_t size) const
+{
+    if (offset + size > m_size.load())
+    {
+        // another process may have grown the file
+        m_size = std::max(m_size.load(), Size());
+        if (offset + size > m_size.load())
+        {
+            return nullptr;
+        }
+    }
+
+    const Mapping* mapping = m_mapping.load();
+    if (!mapping || offset + size > mapping->m_length)
+    {
+        std::lock_guard<std::mutex> lock(m_map_mutex);
+        mapping = m_mapping.load();
+        if (!mapping || offset + size > mapping->m_length)
+        {
+            // mapping past the end of the file is allowed, only touching those pages is not
+            const size_t length = std::max<size_t>(offset + size, mapping ? mapping->m_length * 2 : m_size.load());
+            void* data = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, m_fd, 0);
+            if (data == MAP_FAILED)
+            {
+                return nullptr;
+            }
+            // index pages are visited in no particular order, so read-ahead only wastes the cache
+            ::madvise(data, length, MADV_RANDOM);
+            m_mappings.push_back(std::make_unique<Mapping>(Mapping { static_cast<const char*>(data), length }));
+            mapping = m_mappings.back().get();
+            m_mapping = mapping;
+        }
+    }
+    return mapping->m_data + offset;
+}
@@ -0,0 +1,57 @@
+#ifndef _FILE_H_
+#define _FILE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//! @brief positional I/O over a file descriptor that stays open for the owner's lifetime
+class File
+{
+public:
+    File() = default;
+    ~File();
+
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+
+    bool Open(const std::string& path, bool create);
+    void Close();
+    bool IsOpen() const;
+
+    //! @brief read exactly size bytes, false on a short read
+    bool ReadAt(uint64_t offset, void* buffer, size_t size) const;
+    bool WriteAt(uint64_t offset, const void* buffer, size_t size);
+    bool Sync();
+    bool Truncate(uint64_t size);
+    uint64_t Size() const;
+
+    //! @brief size bytes at offset in a shared read-only mapping of the file, nullptr past its end
+    //!
+    //! The file is mapped on first use and remapped, at twice the length, once it outgrows
+    //! the mapping. Writes through WriteAt show up in the mapping, and a returned pointer
+    //! stays valid until Close even if the file is remapped or truncated in the meantime;
+    //! only the bytes that were inside the file when it was returned may be read.
+    const char* MappedAt(uint64_t offset, size_t size) const;
+
+private:
+    struct Mapping
+    {
+        const char* m_data;
+        size_t m_length;
+    };
+
+    int m_fd { -1 };
+    //! bytes known to be in the file, refreshed from the file itself before giving up
+    mutable std::atomic<uint64_t> m_size { 0 };
+    //! the current mapping; the ones it replaced stay mapped in m_mappings until Close
+    mutable std::atomic<const Mapping*> m_mapping { nullptr };
+    mutable std::vector<std::unique_ptr<Mapping>> m_mappings;
+    mutable std::mutex m_map_mutex;
+};
+
+#endif
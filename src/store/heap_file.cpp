@@ -0,0 +1,244 @@
+#include "heap_file.h"
+
+#include <cstring>
+#include <utility>
+
+HeapFile::HeapFile(std::string filename, Wal* wal, uint32_t wal_file_id)
+    : m_file(std::move(filename))
+    , m_wal(wal)
+    , m_wal_file_id(wal_file_id)
+    , m_counters_dirty(false)
+    , m_data_offset(0)
+    , m_end(0)
+    , m_dead_bytes(0)
+    , m_live_records(0)
+{
+}
+
+bool HeapFile::Open(const std::vector<uint8_t>& header)
+{
+    if (!m_storage.Open(m_file, true) || (m_wal && !Recover()))
+    {
+        return false;
+    }
+
+    // [u32 magic][u32 version][u64 dead bytes][u64 live records][u64 end][u32 header size][header]
+    constexpr size_t kFixedSize = sizeof(uint32_t) * 3 + sizeof(uint64_t) * 3;
+    constexpr size_t kHeaderSizeOffset = kCountersOffset + sizeof(uint64_t) * 3;
+    uint8_t fixed[kFixedSize] = {};
+    m_dead_bytes = 0;
+    m_live_records = 0;
+    m_counters_dirty = false;
+    if (m_storage.Size() == 0)
+    {
+        const uint32_t header_size = static_cast<uint32_t>(header.size());
+        const uint64_t end = kFixedSize + header.size();
+        std::memcpy(fixed, &kHeapMagic, sizeof(uint32_t));
+        std::memcpy(fixed + sizeof(uint32_t), &kHeapVersion, sizeof(uint32_t));
+        std::memcpy(fixed + kCountersOffset + sizeof(uint64_t) * 2, &end, sizeof(uint64_t));
+        std::memcpy(fixed + kHeaderSizeOffset, &header_size, sizeof(uint32_t));
+        if (!Write(0, fixed, kFixedSize) || !Write(kFixedSize, header.data(), header.size()))
+        {
+            return false;
+        }
+        m_header = header;
+        m_data_offset = end;
+        m_end = end;
+        return true;
+    }
+
+    if (!m_storage.ReadAt(0, fixed, kFixedSize))
+    {
+        return false;
+    }
+
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint32_t header_size = 0;
+    std::memcpy(&magic, fixed, sizeof(uint32_t));
+    std::memcpy(&version, fixed + sizeof(uint32_t), sizeof(uint32_t));
+    std::memcpy(&m_dead_bytes, fixed + kCountersOffset, sizeof(uint64_t));
+    std::memcpy(&m_live_records, fixed + kCountersOffset + sizeof(uint64_t), sizeof(uint64_t));
+    std::memcpy(&m_end, fixed + kCountersOffset + sizeof(uint64_t) * 2, sizeof(uint64_t));
+    std::memcpy(&header_size, fixed + kHeaderSizeOffset, sizeof(uint32_t));
+    if (magic != kHeapMagic || version != kHeapVersion)
+    {
+        return false;
+    }
+
+    m_header.resize(header_size);
+    if (!m_storage.ReadAt(kFixedSize, m_header.data(), header_size))
+    {
+        return false;
+    }
+    // anything past the recorded end was never committed and is overwritten by the next append
+    m_data_offset = kFixedSize + header_size;
+    return m_end >= m_data_offset;
+}
+
+const std::vector<uint8_t>& HeapFile::Header() const
+{
+    return m_header;
+}
+
+std::optional<uint64_t> HeapFile::Append(RecordKind kind, const std::vector<uint8_t>& payload)
+{
+    std::vector<uint8_t> record(kRecordHeaderSize + payload.size());
+    const uint32_t size = static_cast<uint32_t>(payload.size());
+    std::memcpy(record.data(), &size, sizeof(size));
+    record[sizeof(size)] = static_cast<uint8_t>(kind);
+    std::memcpy(record.data() + kRecordHeaderSize, payload.data(), payload.size());
+    if (!Write(m_end, record.data(), record.size()))
+    {
+        return std::nullopt;
+    }
+
+    const uint64_t locator = m_end;
+    m_end += record.size();
+    if (kind == RecordKind::kRow)
+    {
+        ++m_live_records;
+    }
+    if (!WriteCounters())
+    {
+        return std::nullopt;
+    }
+    return locator;
+}
+
+bool HeapFile::Read(uint64_t locator, std::vector<uint8_t>& payload) const
+{
+    uint8_t header[kRecordHeaderSize] = {};
+    if (locator < m_data_offset || !m_storage.ReadAt(locator, header, sizeof(header)))
+    {
+        return false;
+    }
+
+    uint32_t size = 0;
+    std::memcpy(&size, header, sizeof(size));
+    if (locator + kRecordHeaderSize + size > m_end)
+    {
+        return false;
+    }
+    payload.resize(size);
+    return m_storage.ReadAt(locator + kRecordHeaderSize, payload.data(), size);
+}
+
+bool HeapFile::Scan(const Visitor& visitor) const
+{
+    std::vector<uint8_t> payload;
+    uint64_t locator = m_data_offset;
+    while (locator + kRecordHeaderSize <= m_end)
+    {
+        uint8_t header[kRecordHeaderSize] = {};
+        if (!m_storage.ReadAt(locator, header, sizeof(header)))
+        {
+            return false;
+        }
+
+        uint32_t size = 0;
+        std::memcpy(&size, header, sizeof(size));
+        if (locator + kRecordHeaderSize + size > m_end)
+        {
+            return false;
+        }
+        payload.resize(size);
+        if (!m_storage.ReadAt(locator + kRecordHeaderSize, payload.data(), size))
+        {
+            return false;
+        }
+        if (!visitor(locator, static_cast<RecordKind>(header[sizeof(size)]), payload))
+        {
+            return true;
+        }
+        locator += kRecordHeaderSize + size;
+    }
+    return true;
+}
+
+bool HeapFile::MarkDead(uint64_t locator)
+{
+    uint8_t header[kRecordHeaderSize] = {};
+    if (!m_storage.ReadAt(locator, header, sizeof(header)))
+    {
+        return false;
+    }
+
+    uint32_t size = 0;
+    std::memcpy(&size, header, sizeof(size));
+    m_dead_bytes += kRecordHeaderSize + size;
+    if (static_cast<RecordKind>(header[sizeof(size)]) == RecordKind::kRow)
+    {
+        --m_live_records;
+    }
+    return WriteCounters();
+}
+
+bool HeapFile::Sync()
+{
+    if (m_counters_dirty)
+    {
+        const uint64_t counters[] = { m_dead_bytes, m_live_records, m_end };
+        if (!m_storage.WriteAt(kCountersOffset, counters, sizeof(counters)))
+        {
+            return false;
+        }
+        m_counters_dirty = false;
+    }
+    return m_storage.Sync();
+}
+
+uint64_t HeapFile::DeadBytes() const
+{
+    return m_dead_bytes;
+}
+
+uint64_t HeapFile::LiveRecords() const
+{
+    return m_live_records;
+}
+
+uint64_t HeapFile::RecordBytes() const
+{
+    return m_end - m_data_offset;
+}
+
+const std::string& HeapFile::FileName() const
+{
+    return m_file;
+}
+
+bool HeapFile::Recover()
+{
+    bool replayed = false;
+    const bool complete = m_wal->Replay([&](const Wal::Record& record) {
+        if (record.m_file_id != m_wal_file_id)
+        {
+            return true;
+        }
+        replayed = true;
+        return m_storage.WriteAt(record.m_offset, record.m_data.data(), record.m_data.size());
+    });
+    return complete && (!replayed || m_storage.Sync());
+}
+
+bool HeapFile::Write(uint64_t offset, const void* data, size_t size)
+{
+    if (m_wal)
+    {
+        m_wal->Append(m_wal_file_id, offset, data, size);
+    }
+    return m_storage.WriteAt(offset, data, size);
+}
+
+bool HeapFile::WriteCounters()
+{
+    const uint64_t counters[] = { m_dead_bytes, m_live_records, m_end };
+    if (m_wal)
+    {
+        m_wal->Append(m_wal_file_id, kCountersOffset, counters, sizeof(counters));
+        m_counters_dirty = true;
+        return true;
+    }
+    return m_storage.WriteAt(kCountersOffset, counters, sizeof(counters));
+}
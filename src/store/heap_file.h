@@ -0,0 +1,80 @@
+#ifndef _HEAP_FILE_H_
+#define _HEAP_FILE_H_
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+#include "file.h"
+#include "wal.h"
+
+//! @brief append-only record file addressed by byte offset
+//!
+//! The file starts with a fixed header carrying an owner-defined blob, followed
+//! by records of the form [u32 payload size][u8 kind][payload]. Records are never
+//! rewritten in place: an update appends a new record and the owner reports the
+//! superseded one through MarkDead so it can decide when to compact. The header
+//! keeps dead bytes, live row records and the end of the last record so none of
+//! them needs a scan after open.
+//!
+//! With a write-ahead log every write is logged first. Records still go straight
+//! to the file, past the committed end, while the header counters reach the file
+//! only through log replay or Sync, so it never describes an uncommitted record.
+class HeapFile
+{
+public:
+    enum class RecordKind : uint8_t
+    {
+        kRow = 1,
+        kTombstone = 2,
+    };
+
+    using Visitor = std::function<bool(uint64_t locator, RecordKind kind, const std::vector<uint8_t>& payload)>;
+
+    explicit HeapFile(std::string filename, Wal* wal = nullptr, uint32_t wal_file_id = 0);
+
+    //! @brief open the file, creating it with header when it does not exist, after replaying the log
+    bool Open(const std::vector<uint8_t>& header);
+    const std::vector<uint8_t>& Header() const;
+
+    //! @brief append a record and return its locator
+    std::optional<uint64_t> Append(RecordKind kind, const std::vector<uint8_t>& payload);
+    bool Read(uint64_t locator, std::vector<uint8_t>& payload) const;
+    //! @brief visit records in file order until visitor returns false
+    bool Scan(const Visitor& visitor) const;
+    bool MarkDead(uint64_t locator);
+    //! @brief write the header counters and sync the file, after which the log may be truncated
+    bool Sync();
+
+    uint64_t DeadBytes() const;
+    uint64_t LiveRecords() const;
+    //! @brief bytes used by records, dead ones included
+    uint64_t RecordBytes() const;
+    const std::string& FileName() const;
+
+    static constexpr size_t kRecordHeaderSize = sizeof(uint32_t) + sizeof(uint8_t);
+
+private:
+    bool Recover();
+    bool Write(uint64_t offset, const void* data, size_t size);
+    bool WriteCounters();
+
+    static constexpr uint32_t kHeapMagic = 0x48454150;  // HEAP
+    static constexpr uint32_t kHeapVersion = 3;
+    static constexpr uint64_t kCountersOffset = sizeof(uint32_t) * 2;
+
+    std::string m_file;
+    File m_storage;
+    Wal* m_wal;
+    uint32_t m_wal_file_id;
+    //! counters logged but not yet written to the file
+    bool m_counters_dirty;
+    std::vector<uint8_t> m_header;
+    uint64_t m_data_offset;
+    uint64_t m_end;
+    uint64_t m_dead_bytes;
+    uint64_t m_live_records;
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include "key_array.h"
+
+#include <cassert>
+
+KeyArray::KeyArray()
+    : m_offsets(1, 0)
+{
+}
+
+size_t KeyArray::Size() const
+{
+    return m_prefixes.size();
+}
+
+bool KeyArray::Empty() const
+{
+    return m_prefixes.empty();
+}
+
+size_t KeyArray::ByteSize() const
+{
+    return m_bytes.size();
+}
+
+std::string_view KeyArray::At(size_t i) const
+{
+    assert(i < Size() && "KeyArray: index out of range");
+    return std::string_view(m_bytes.data() + m_offsets[i], m_offsets[i + 1] - m_offsets[i]);
+}
+
+std::string_view KeyArray::Front() const
+{
+    return At(0);
+}
+
+std::string_view KeyArray::Back() const
+{
+    return At(Size() - 1);
+}
+
+void KeyArray::Reserve(size_t count, size_t bytes)
+{
+    m_bytes.reserve(bytes);
+    m_offsets.reserve(count + 1);
+    m_prefixes.reserve(count);
+}
+
+void KeyArray::Insert(size_t pos, std::string_view key)
+{
+    assert(pos <= Size() && "KeyArray: insert position out of range");
+    const uint32_t start = m_offsets[pos];
+    const uint32_t length = static_cast<uint32_t>(key.size());
+    m_bytes.insert(start, key.data(), key.size());
+    m_offsets.insert(m_offsets.begin() + static_cast<std::ptrdiff_t>(pos), start);
+    for (size_t i = pos + 1; i < m_offsets.size(); ++i)
+    {
+        m_offsets[i] += length;
+    }
+    m_prefixes.insert(m_prefixes.begin() + static_cast<std::ptrdiff_t>(pos), Prefix(key));
+}
+
+void KeyArray::Set(size_t pos, std::string_view key)
+{
+    Erase(pos, pos + 1);
+    Insert(pos, key);
+}
+
+void KeyArray::PushBack(std::string_view key)
+{
+    m_bytes.append(key.data(), key.size());
+    m_offsets.push_back(static_cast<uint32_t>(m_bytes.size()));
+    m_prefixes.push_back(Prefix(key));
+}
+
+void KeyArray::PushBack(std::string_view prefix, std::string_view suffix)
+{
+    const size_t start = m_bytes.size();
+    m_bytes.append(prefix.data(), prefix.size());
+    m_bytes.append(suffix.data(), suffix.size());
+    m_offsets.push_back(static_cast<uint32_t>(m_bytes.size()));
+    m_prefixes.push_back(Prefix(std::string_view(m_bytes.data() + start, m_bytes.size() - start)));
+}
+
+void KeyArray::Erase(size_t first, size_t last)
+{
+    assert(first <= last && last <= Size() && "KeyArray: erase range out of range");
+    if (first == last)
+    {
+        return;
+    }
+
+    const uint32_t start = m_offsets[first];
+    const uint32_t length = m_offsets[last] - start;
+    m_bytes.erase(start, length);
+    m_offsets.erase(m_offsets.begin() + static_cast<std::ptrdiff_t>(first), m_offsets.begin() + static_cast<std::ptrdiff_t>(last));
+    for (size_t i = first; i < m_offsets.size(); ++i)
+    {
+        m_offsets[i] -= length;
+    }
+    m_prefixes.erase(m_prefixes.begin() + static_cast<std::ptrdiff_t>(first), m_prefixes.begin() + static_cast<std::ptrdiff_t>(last));
+}
+
+void KeyArray::Clear()
+{
+    m_bytes.clear();
+    m_offsets.assign(1, 0);
+    m_prefixes.clear();
+}
+
+KeyArray KeyArray::Split(size_t pos)
+{
+    assert(pos <= Size() && "KeyArray: split position out of range");
+    KeyArray tail;
+    const uint32_t start = m_offsets[pos];
+    tail.m_bytes.assign(m_bytes, start, std::string::npos);
+    tail.m_offsets.reserve(Size() - pos + 1);
+    for (size_t i = pos + 1; i < m_offsets.size(); ++i)
+    {
+        tail.m_offsets.push_back(m_offsets[i] - start);
+    }
+    tail.m_prefixes.assign(m_prefixes.begin() + static_cast<std::ptrdiff_t>(pos), m_prefixes.end());
+
+    m_bytes.resize(start);
+    m_offsets.resize(pos + 1);
+    m_prefixes.resize(pos);
+    return tail;
+}
+
+size_t KeyArray::LowerBound(std::string_view key) const
+{
+    const uint32_t prefix = Prefix(key);
+    size_t low = 0;
+    size_t high = Size();
+    while (low < high)
+    {
+        const size_t mid = low + (high - low) / 2;
+        const bool less = m_prefixes[mid] != prefix ? m_prefixes[mid] < prefix : At(mid) < key;
+        if (less)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+size_t KeyArray::UpperBound(std::string_view key) const
+{
+    const uint32_t prefix = Prefix(key);
+    size_t low = 0;
+    size_t high = Size();
+    while (low < high)
+    {
+        const size_t mid = low + (high - low) / 2;
+        const bool less_equal = m_prefixes[mid] != prefix ? m_prefixes[mid] < prefix : At(mid) <= key;
+        if (less_equal)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+uint32_t KeyArray::Prefix(std::string_view key)
+{
+    // zero padding keeps a short key ordered before any longer key it prefixes
+    uint32_t prefix = 0;
+    for (size_t i = 0; i < sizeof(prefix); ++i)
+    {
+        prefix <<= 8;
+        if (i < key.size())
+        {
+            prefix |= static_cast<uint8_t>(key[i]);
+        }
+    }
+    return prefix;
+}
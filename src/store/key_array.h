@@ -0,0 +1,51 @@
+#ifndef _KEY_ARRAY_H_
+#define _KEY_ARRAY_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//! @brief sorted node keys packed into one byte buffer
+//!
+//! Key i occupies m_bytes[m_offsets[i], m_offsets[i + 1]). Next to the offsets
+//! every key keeps its first four bytes as a big-endian integer, so binary
+//! search settles most comparisons without touching the packed bytes.
+class KeyArray
+{
+public:
+    KeyArray();
+
+    size_t Size() const;
+    bool Empty() const;
+    size_t ByteSize() const;
+    std::string_view At(size_t i) const;
+    std::string_view operator[](size_t i) const { return At(i); }
+    std::string_view Front() const;
+    std::string_view Back() const;
+
+    void Reserve(size_t count, size_t bytes);
+    void Insert(size_t pos, std::string_view key);
+    void Set(size_t pos, std::string_view key);
+    void PushBack(std::string_view key);
+    //! @brief append the key made of prefix followed by suffix
+    void PushBack(std::string_view prefix, std::string_view suffix);
+    void Erase(size_t first, size_t last);
+    void Clear();
+    //! @brief move keys [pos, Size()) into the returned array
+    KeyArray Split(size_t pos);
+
+    //! @brief index of the first key >= key
+    size_t LowerBound(std::string_view key) const;
+    //! @brief index of the first key > key
+    size_t UpperBound(std::string_view key) const;
+
+    static uint32_t Prefix(std::string_view key);
+
+private:
+    std::string m_bytes;
+    std::vector<uint32_t> m_offsets;
+    std::vector<uint32_t> m_prefixes;
+};
+
+#endif
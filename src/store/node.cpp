@@ -1,34 +1,35 @@
 #include "node.h"
 
 #include <cassert>
-#include <cstring>
 
 Node::Node(bool is_leaf, size_t record_max_size, uint64_t page_id)
     : m_is_leaf(is_leaf)
     , m_page_id(page_id)
-    , m_parent_page_id(0)
     , m_record_max_size(record_max_size)
-    , m_next_leaf(nullptr)
+    , m_next_leaf(0)
+    , m_prev_leaf(0)
+    , m_lsn(0)
 {
 }
 
 size_t Node::GetSize() const
 {
-    return m_keys.size();
+    return m_keys.Size();
 }
 
-int Node::Compare(size_t i, const char* key) const
+int Node::Compare(size_t i, std::string_view key) const
 {
-    assert(key && "key is nullptr");
-    assert(i < m_keys.size() && "compare index out of range");
-    return std::strcmp(key, m_keys[i].c_str());
+    assert(i < m_keys.Size() && "compare index out of range");
+    return key.compare(m_keys[i]);
 }
 
-size_t Node::FindPos(const char* key) const
+size_t Node::FindPos(std::string_view key) const
 {
-    assert(key && "key is nullptr");
-    size_t pos = 0;
-    for (; pos < m_keys.size() && std::strcmp(m_keys[pos].c_str(), key) < 0; ++pos)
-        ;
-    return pos;
+    return m_keys.LowerBound(key);
+}
+
+size_t Node::FindChild(std::string_view key) const
+{
+    assert(!m_is_leaf && "FindChild: node is a leaf");
+    return m_keys.UpperBound(key);
 }
@@ -2,25 +2,36 @@
 #define _NODE_H_
 
 #include <cstdint>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "key_array.h"
 
 struct Node
 {
     explicit Node(bool is_leaf, size_t record_max_size, uint64_t page_id = 0);
 
     size_t GetSize() const;
-    int Compare(size_t i, const char* key) const;
-    size_t FindPos(const char* key) const;
+    int Compare(size_t i, std::string_view key) const;
+    //! @brief index of the first key >= key
+    size_t FindPos(std::string_view key) const;
+    //! @brief index of the child subtree that covers key
+    size_t FindChild(std::string_view key) const;
 
     bool m_is_leaf;
     uint64_t m_page_id;
-    uint64_t m_parent_page_id;
     size_t m_record_max_size;
-    std::vector<std::string> m_keys;
+    KeyArray m_keys;
+    //! leaf values as stored: the value or an overflow page reference, followed by a tag byte
     std::vector<std::string> m_values;
-    std::vector<Node*> m_children;
-    Node* m_next_leaf;
+    std::vector<uint64_t> m_children;
+    uint64_t m_next_leaf;
+    uint64_t m_prev_leaf;
+    //! lsn of the last logged image of this page, 0 when the tree runs without a log
+    uint64_t m_lsn;
+    //! held while the node is read or changed outside a structure modification, only by a thread that pinned it
+    mutable std::shared_mutex m_latch;
 };
 
 #endif
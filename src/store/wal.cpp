@@ -0,0 +1,282 @@
+#include "wal.h"
+
+#include <array>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+std::array<uint32_t, 256> MakeCrcTable()
+{
+    std::array<uint32_t, 256> table {};
+    for (uint32_t i = 0; i < table.size(); ++i)
+    {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320U : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+uint32_t Crc32(const uint8_t* data, size_t size)
+{
+    static const std::array<uint32_t, 256> kTable = MakeCrcTable();
+    uint32_t crc = 0xFFFFFFFFU;
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc = kTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFU;
+}
+
+template <typename T>
+T ReadValue(const uint8_t* data)
+{
+    T value {};
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+template <typename T>
+void WriteValue(uint8_t* data, T value)
+{
+    std::memcpy(data, &value, sizeof(value));
+}
+}  // namespace
+
+Wal::Wal(std::string filename)
+    : m_file(std::move(filename))
+    , m_open(false)
+    , m_next_lsn(1)
+    , m_durable_lsn(0)
+    , m_commit_lsn(0)
+    , m_committed_lsn(0)
+    , m_end(kHeaderSize)
+    , m_flushing(false)
+    , m_failed(false)
+{
+    m_open = m_storage.Open(m_file, true) && Load();
+}
+
+bool Wal::IsOpen() const
+{
+    return m_open;
+}
+
+uint64_t Wal::Append(uint32_t file_id, uint64_t offset, const void* data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return AppendLocked(RecordType::kWrite, file_id, offset, data, size);
+}
+
+bool Wal::Commit()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_failed)
+    {
+        return false;
+    }
+    const uint64_t lsn = AppendLocked(RecordType::kCommit, 0, 0, nullptr, 0);
+    m_commit_lsn = lsn;
+
+    // group commit: the first waiter writes and syncs everything buffered so far,
+    // the rest sleep until a flush covers their commit record
+    while (m_durable_lsn < lsn)
+    {
+        // a lost batch leaves a hole that Load cuts the log at, so nothing after it can be durable
+        if (m_failed)
+        {
+            return false;
+        }
+        if (m_flushing)
+        {
+            m_flushed.wait(lock);
+            continue;
+        }
+
+        m_flushing = true;
+        std::vector<uint8_t> batch;
+        batch.swap(m_buffer);
+        const uint64_t batch_lsn = m_next_lsn - 1;
+        const uint64_t batch_commit_lsn = m_commit_lsn;
+        const uint64_t offset = m_end;
+        m_end += batch.size();
+        lock.unlock();
+
+        const bool written = m_storage.WriteAt(offset, batch.data(), batch.size()) && m_storage.Sync();
+
+        lock.lock();
+        m_flushing = false;
+        if (written)
+        {
+            m_durable_lsn = batch_lsn;
+            m_committed_lsn = batch_commit_lsn;
+        }
+        else
+        {
+            m_failed = true;
+        }
+        m_flushed.notify_all();
+        if (!written)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Wal::Replay(const Visitor& visitor) const
+{
+    uint64_t end = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        end = m_end;
+    }
+
+    std::vector<uint8_t> log(end - kHeaderSize);
+    if (!m_storage.ReadAt(kHeaderSize, log.data(), log.size()))
+    {
+        return false;
+    }
+
+    // Load already cut the log after its last commit record, so every group here is complete
+    std::vector<Record> group;
+    size_t pos = 0;
+    while (pos + kRecordHeaderSize <= log.size())
+    {
+        const uint8_t* header = log.data() + pos;
+        const uint32_t size = ReadValue<uint32_t>(header + sizeof(uint32_t));
+        const RecordType type = static_cast<RecordType>(header[sizeof(uint32_t) * 2 + sizeof(uint64_t)]);
+        if (type == RecordType::kCommit)
+        {
+            for (const Record& record : group)
+            {
+                if (!visitor(record))
+                {
+                    return false;
+                }
+            }
+            group.clear();
+        }
+        else
+        {
+            Record& record = group.emplace_back();
+            record.m_lsn = ReadValue<uint64_t>(header + sizeof(uint32_t) * 2);
+            record.m_file_id = ReadValue<uint32_t>(header + sizeof(uint32_t) * 2 + sizeof(uint64_t) + sizeof(uint8_t));
+            record.m_offset = ReadValue<uint64_t>(header + sizeof(uint32_t) * 3 + sizeof(uint64_t) + sizeof(uint8_t));
+            record.m_data.assign(header + kRecordHeaderSize, header + kRecordHeaderSize + size);
+        }
+        pos += kRecordHeaderSize + size;
+    }
+    return true;
+}
+
+bool Wal::Truncate()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_flushed.wait(lock, [this] { return !m_flushing; });
+    if (m_failed || !WriteHeader(m_next_lsn) || !m_storage.Truncate(kHeaderSize) || !m_storage.Sync())
+    {
+        return false;
+    }
+    m_end = kHeaderSize;
+    return true;
+}
+
+uint64_t Wal::CommittedLsn() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_committed_lsn;
+}
+
+uint64_t Wal::Size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_end + m_buffer.size();
+}
+
+bool Wal::Load()
+{
+    const uint64_t file_size = m_storage.Size();
+    if (file_size < kHeaderSize)
+    {
+        return WriteHeader(m_next_lsn) && m_storage.Truncate(kHeaderSize) && m_storage.Sync();
+    }
+
+    std::vector<uint8_t> log(file_size);
+    if (!m_storage.ReadAt(0, log.data(), log.size()))
+    {
+        return false;
+    }
+    if (ReadValue<uint32_t>(log.data()) != kWalMagic || ReadValue<uint32_t>(log.data() + sizeof(uint32_t)) != kWalVersion)
+    {
+        return false;
+    }
+    m_next_lsn = ReadValue<uint64_t>(log.data() + sizeof(uint32_t) * 2);
+
+    // stop at the first torn record; whatever follows the last commit never happened
+    size_t pos = kHeaderSize;
+    while (pos + kRecordHeaderSize <= log.size())
+    {
+        const uint8_t* header = log.data() + pos;
+        const uint32_t size = ReadValue<uint32_t>(header + sizeof(uint32_t));
+        if (pos + kRecordHeaderSize + size > log.size())
+        {
+            break;
+        }
+        const size_t checked = kRecordHeaderSize - sizeof(uint32_t) + size;
+        if (ReadValue<uint32_t>(header) != Crc32(header + sizeof(uint32_t), checked))
+        {
+            break;
+        }
+
+        pos += kRecordHeaderSize + size;
+        const uint64_t lsn = ReadValue<uint64_t>(header + sizeof(uint32_t) * 2);
+        if (static_cast<RecordType>(header[sizeof(uint32_t) * 2 + sizeof(uint64_t)]) == RecordType::kCommit)
+        {
+            m_end = pos;
+            m_next_lsn = lsn + 1;
+        }
+    }
+
+    m_durable_lsn = m_next_lsn - 1;
+    m_commit_lsn = m_durable_lsn;
+    m_committed_lsn = m_durable_lsn;
+    if (m_end < file_size)
+    {
+        return m_storage.Truncate(m_end) && m_storage.Sync();
+    }
+    return true;
+}
+
+uint64_t Wal::AppendLocked(RecordType type, uint32_t file_id, uint64_t offset, const void* data, size_t size)
+{
+    const uint64_t lsn = m_next_lsn++;
+    const size_t start = m_buffer.size();
+    m_buffer.resize(start + kRecordHeaderSize + size);
+
+    uint8_t* record = m_buffer.data() + start;
+    WriteValue<uint32_t>(record + sizeof(uint32_t), static_cast<uint32_t>(size));
+    WriteValue<uint64_t>(record + sizeof(uint32_t) * 2, lsn);
+    record[sizeof(uint32_t) * 2 + sizeof(uint64_t)] = static_cast<uint8_t>(type);
+    WriteValue<uint32_t>(record + sizeof(uint32_t) * 2 + sizeof(uint64_t) + sizeof(uint8_t), file_id);
+    WriteValue<uint64_t>(record + sizeof(uint32_t) * 3 + sizeof(uint64_t) + sizeof(uint8_t), offset);
+    if (size > 0)
+    {
+        std::memcpy(record + kRecordHeaderSize, data, size);
+    }
+    WriteValue<uint32_t>(record, Crc32(record + sizeof(uint32_t), kRecordHeaderSize - sizeof(uint32_t) + size));
+    return lsn;
+}
+
+bool Wal::WriteHeader(uint64_t base_lsn)
+{
+    uint8_t header[kHeaderSize] = {};
+    WriteValue<uint32_t>(header, kWalMagic);
+    WriteValue<uint32_t>(header + sizeof(uint32_t), kWalVersion);
+    WriteValue<uint64_t>(header + sizeof(uint32_t) * 2, base_lsn);
+    return m_storage.WriteAt(0, header, sizeof(header));
+}
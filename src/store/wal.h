@@ -0,0 +1,84 @@
+#ifndef _WAL_H_
+#define _WAL_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "file.h"
+
+//! @brief redo-only write-ahead log shared by the files of one owner
+//!
+//! Every record says "write these bytes at this offset of file N". Records are
+//! buffered in memory until Commit appends a commit record and makes the log
+//! durable with a single fsync; concurrent committers queue behind one leader and
+//! share its fsync. A failed write or fsync loses its batch, so every later Commit
+//! and Truncate fails until the log is reopened. On open only groups ending in a commit record are replayed and
+//! a torn or uncommitted tail is cut off.
+class Wal
+{
+public:
+    struct Record
+    {
+        uint64_t m_lsn { 0 };
+        uint32_t m_file_id { 0 };
+        uint64_t m_offset { 0 };
+        std::vector<uint8_t> m_data;
+    };
+
+    using Visitor = std::function<bool(const Record& record)>;
+
+    explicit Wal(std::string filename);
+
+    bool IsOpen() const;
+    //! @brief buffer a write of size bytes at offset of file_id and return its lsn
+    uint64_t Append(uint32_t file_id, uint64_t offset, const void* data, size_t size);
+    //! @brief close the current group and wait until it is durable; false once any flush failed
+    bool Commit();
+    //! @brief every record up to this lsn is committed and durable
+    uint64_t CommittedLsn() const;
+    //! @brief visit committed writes in log order
+    bool Replay(const Visitor& visitor) const;
+    //! @brief drop every record once all files are checkpointed, lsns keep increasing
+    bool Truncate();
+    uint64_t Size() const;
+
+private:
+    enum class RecordType : uint8_t
+    {
+        kWrite = 1,
+        kCommit = 2,
+    };
+
+    bool Load();
+    uint64_t AppendLocked(RecordType type, uint32_t file_id, uint64_t offset, const void* data, size_t size);
+    bool WriteHeader(uint64_t base_lsn);
+
+    static constexpr uint32_t kWalMagic = 0x57414C31;  // WAL1
+    static constexpr uint32_t kWalVersion = 1;
+    static constexpr size_t kHeaderSize = sizeof(uint32_t) * 2 + sizeof(uint64_t);
+    //! [u32 crc][u32 size][u64 lsn][u8 type][u32 file id][u64 offset]
+    static constexpr size_t kRecordHeaderSize = sizeof(uint32_t) * 3 + sizeof(uint64_t) * 2 + sizeof(uint8_t);
+
+    std::string m_file;
+    File m_storage;
+    bool m_open;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_flushed;
+    //! records appended but not written yet
+    std::vector<uint8_t> m_buffer;
+    uint64_t m_next_lsn;
+    uint64_t m_durable_lsn;
+    //! the last commit record appended, and the last one known to be durable
+    uint64_t m_commit_lsn;
+    uint64_t m_committed_lsn;
+    uint64_t m_end;
+    bool m_flushing;
+    //! a flush failed and its records are lost; sticky until reopen
+    bool m_failed;
+};
+
+#endif
@@ -1,9 +1,22 @@
+#include <atomic>
+#include <csignal>
+#include <chrono>
 #include <cstring>
 #include <filesystem>
+#include <functional>
 #include <fstream>
 #include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fmt/format.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include "store/bptree.h"
 #include "store/trace.h"
+#include "store/wal.h"
 
 void Test()
 {
@@ -52,12 +65,935 @@ void Test2()
     }
 }
 
+bool TestBufferPool()
+{
+    constexpr size_t kFrameBudget = 8;
+    constexpr int kKeyCount = 500;
+    BPTreeOptions options;
+    options.m_frame_budget = kFrameBudget;
+    {
+        BPTree tree("test-pool.db", 4, options);
+        for (int i = 0; i < kKeyCount; ++i)
+        {
+            const std::string key = fmt::format("{:05}", i);
+            tree.Insert(key, key.data(), key.size());
+        }
+        if (tree.CachedPages() > kFrameBudget)
+        {
+            return false;
+        }
+    }
+
+    BPTree tree("test-pool.db", 4, options);
+    if (tree.CachedPages() != 0)
+    {
+        return false;
+    }
+    for (int i = kKeyCount - 1; i >= 0; --i)
+    {
+        const std::string key = fmt::format("{:05}", i);
+        auto data = tree.Search(key);
+        if (!data.has_value() || std::string(data->m_data, data->m_data_size) != key)
+        {
+            return false;
+        }
+    }
+    return tree.CachedPages() <= kFrameBudget && !tree.Search("99999").has_value();
+}
+
+bool TestBatch()
+{
+    {
+        BPTree tree("test-batch.db", 4);
+        tree.BeginBatch();
+        for (int i = 0; i < 200; ++i)
+        {
+            const std::string key = fmt::format("{:04}", i);
+            tree.Insert(key, key.data(), key.size());
+        }
+        if (std::filesystem::exists("test-batch.db") || !tree.Commit())
+        {
+            return false;
+        }
+    }
+
+    BPTree tree("test-batch.db", 4);
+    auto data = tree.Search("0123");
+    return data.has_value() && std::string(data->m_data, data->m_data_size) == "0123";
+}
+
+bool TestBulkLoad()
+{
+    std::vector<BPTree::Record> records;
+    for (int i = 999; i >= 0; --i)
+    {
+        records.emplace_back(fmt::format("{:04}", i), fmt::format("v{}", i));
+    }
+    records.emplace_back("0500", "latest");
+    {
+        BPTree tree("test-bulk.db", 4);
+        tree.Insert("stale", "x", 1);
+        if (!tree.BulkLoad(std::move(records)))
+        {
+            return false;
+        }
+        tree.Insert("0500a", "inserted", 8);
+    }
+
+    // each Search reuses the same per-thread buffer, so values are read before the next one
+    BPTree tree("test-bulk.db", 4);
+    const auto value_of = [&](const std::string& key) {
+        auto data = tree.Search(key);
+        return data.has_value() ? std::optional<std::string>(std::in_place, data->m_data, data->m_data_size) : std::nullopt;
+    };
+    return !value_of("stale") && value_of("0500") == "latest" && value_of("0500a") && value_of("0999") == "v999";
+}
+
+bool TestCursor()
+{
+    BPTree tree("test-cursor.db", 3);
+    for (int i = 0; i < 100; i += 2)
+    {
+        const std::string key = fmt::format("{:03}", i);
+        tree.Insert(key, key.data(), key.size());
+    }
+
+    std::vector<std::string> keys;
+    tree.Scan("011", "021", [&](std::string_view key, std::string_view value) {
+        keys.emplace_back(value);
+        return key != "016";
+    });
+    if (keys != std::vector<std::string> { "012", "014", "016" })
+    {
+        return false;
+    }
+
+    auto cursor = tree.UpperBound("050");
+    if (!cursor.Valid() || cursor.Key() != "052")
+    {
+        return false;
+    }
+    cursor.Prev();
+    cursor.Prev();
+    if (!cursor.Valid() || cursor.Key() != "048")
+    {
+        return false;
+    }
+
+    size_t reverse_count = 0;
+    std::string_view previous;
+    for (auto it = tree.Last(); it.Valid(); it.Prev(), ++reverse_count)
+    {
+        if (!previous.empty() && it.Key() >= previous)
+        {
+            return false;
+        }
+        previous = it.Key();
+    }
+
+    size_t prefix_count = 0;
+    tree.ScanPrefix("09", [&](std::string_view, std::string_view) { return ++prefix_count > 0; });
+    return reverse_count == 50 && prefix_count == 5 && !tree.LowerBound("099").Valid();
+}
+
+bool TestErase()
+{
+    constexpr int kKeyCount = 300;
+    {
+        BPTree tree("test-erase.db", 4);
+        for (int i = 0; i < kKeyCount; ++i)
+        {
+            const std::string key = fmt::format("{:04}", i);
+            tree.Insert(key, key.data(), key.size());
+        }
+        for (int i = 0; i < kKeyCount; i += 3)
+        {
+            if (!tree.Erase(fmt::format("{:04}", i)))
+            {
+                return false;
+            }
+        }
+        if (tree.Erase("0000") || tree.Erase("missing"))
+        {
+            return false;
+        }
+    }
+
+    const uintmax_t file_size = std::filesystem::file_size("test-erase.db");
+    BPTree tree("test-erase.db", 4);
+    int count = 0;
+    for (auto cursor = tree.Begin(); cursor.Valid(); cursor.Next(), ++count)
+    {
+        if (std::stoi(std::string(cursor.Key())) % 3 == 0)
+        {
+            return false;
+        }
+    }
+    if (count != kKeyCount - kKeyCount / 3)
+    {
+        return false;
+    }
+
+    // erase everything, then refill: freed pages must be reused instead of growing the file
+    for (int i = 0; i < kKeyCount; ++i)
+    {
+        tree.Erase(fmt::format("{:04}", i));
+    }
+    if (tree.GetRoot())
+    {
+        return false;
+    }
+    for (int i = 0; i < kKeyCount; i += 3)
+    {
+        const std::string key = fmt::format("{:04}", i);
+        tree.Insert(key, key.data(), key.size());
+    }
+    return std::filesystem::file_size("test-erase.db") == file_size && tree.Search("0003").has_value();
+}
+
+//! @brief run work in a child process that must end in _exit, so no destructor flushes anything
+bool RunAndCrash(const std::function<void()>& work)
+{
+    const pid_t pid = fork();
+    if (pid == 0)
+    {
+        work();
+    }
+    int status = 0;
+    return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status);
+}
+
+bool TestWalRecovery()
+{
+    constexpr int kKeyCount = 300;
+    BPTreeOptions options;
+    options.m_wal_file_id = 1;
+
+    const auto verify = [&](BPTree& tree) {
+        int count = 0;
+        for (auto cursor = tree.Begin(); cursor.Valid(); cursor.Next(), ++count)
+        {
+            const int i = std::stoi(std::string(cursor.Key()));
+            if (cursor.Key().size() != 4 || (i < kKeyCount / 2 && i % 3 == 0))
+            {
+                return false;
+            }
+        }
+        return count == kKeyCount - kKeyCount / 6;
+    };
+
+    // committed erases that only reached the log are redone
+    const bool crashed = RunAndCrash([&] {
+        Wal wal("test-wal.log");
+        options.m_wal = &wal;
+        BPTree tree("test-wal.db", 4, options);
+        for (int i = 0; i < kKeyCount; ++i)
+        {
+            const std::string key = fmt::format("{:04}", i);
+            tree.Insert(key, key.data(), key.size());
+        }
+        tree.Checkpoint();
+        wal.Truncate();
+        for (int i = 0; i < kKeyCount / 2; i += 3)
+        {
+            tree.Erase(fmt::format("{:04}", i));
+        }
+        _exit(0);
+    });
+    if (!crashed)
+    {
+        return false;
+    }
+    {
+        Wal wal("test-wal.log");
+        options.m_wal = &wal;
+        BPTree tree("test-wal.db", 4, options);
+        if (!verify(tree) || !tree.Checkpoint() || !wal.Truncate())
+        {
+            return false;
+        }
+    }
+
+    // a batch that never commits leaves no trace, even when it outgrows the frame budget
+    options.m_frame_budget = 16;
+    const bool aborted = RunAndCrash([&] {
+        Wal wal("test-wal.log");
+        options.m_wal = &wal;
+        BPTree tree("test-wal.db", 4, options);
+        tree.BeginBatch();
+        for (int i = kKeyCount / 2; i < kKeyCount; ++i)
+        {
+            tree.Insert(fmt::format("{:04}x", i), "x", 1);
+        }
+        _exit(0);
+    });
+    if (!aborted)
+    {
+        return false;
+    }
+    {
+        Wal wal("test-wal.log");
+        options.m_wal = &wal;
+        BPTree tree("test-wal.db", 4, options);
+        if (!verify(tree) || !tree.Checkpoint() || !wal.Truncate())
+        {
+            return false;
+        }
+    }
+
+    // after a checkpoint the tree file stands on its own
+    options.m_wal = nullptr;
+    BPTree tree("test-wal.db", 4, options);
+    return verify(tree);
+}
+
+bool TestWalWriteFailure()
+{
+    const auto append = [](Wal& wal, uint64_t offset) {
+        const std::string data = fmt::format("{:08}", offset);
+        wal.Append(1, offset, data.data(), data.size());
+    };
+    {
+        Wal wal("test-wal-fail.log");
+        append(wal, 0);
+        if (!wal.Commit())
+        {
+            return false;
+        }
+
+        // the file may not grow, so the next flush fails whichever committer leads it
+        rlimit limit {};
+        getrlimit(RLIMIT_FSIZE, &limit);
+        const rlimit previous = limit;
+        limit.rlim_cur = wal.Size();
+        const auto handler = std::signal(SIGXFSZ, SIG_IGN);
+        setrlimit(RLIMIT_FSIZE, &limit);
+        std::atomic<int> committed { 0 };
+        std::vector<std::thread> threads;
+        for (uint64_t offset : { 8, 16 })
+        {
+            threads.emplace_back([&, offset] {
+                append(wal, offset);
+                committed += wal.Commit();
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        setrlimit(RLIMIT_FSIZE, &previous);
+        std::signal(SIGXFSZ, handler);
+
+        // once the storage recovers, commits after the lost batch still must not succeed
+        append(wal, 24);
+        if (committed != 0 || wal.Commit() || wal.Truncate())
+        {
+            return false;
+        }
+    }
+
+    Wal wal("test-wal-fail.log");
+    std::vector<uint64_t> offsets;
+    wal.Replay([&](const Wal::Record& record) {
+        offsets.push_back(record.m_offset);
+        return true;
+    });
+    return offsets == std::vector<uint64_t> { 0 };
+}
+
+bool TestHandles()
+{
+    BPTree tree("test-handle.db", 3);
+    for (int i = 0; i < 200; i += 2)
+    {
+        const std::string key = fmt::format("{:03}", i);
+        tree.Insert(key, key.data(), key.size());
+    }
+
+    // unsorted, duplicated, missing and empty keys; values come back in request order
+    const std::vector<std::string> keys = { "150", "", "002", "151", "150", "198", "000", "999" };
+    {
+        const BPTree::Handle values = tree.MultiGet(keys);
+        for (size_t i = 0; i < keys.size(); ++i)
+        {
+            const bool present = !keys[i].empty() && keys[i] < "200" && std::stoi(keys[i]) % 2 == 0;
+            if (values.Has(i) != present || (present && values.Value(i) != keys[i]))
+            {
+                return false;
+            }
+        }
+        if (values.Size() != keys.size())
+        {
+            return false;
+        }
+    }
+    if (tree.Get("151") || tree.MultiGet({}).Size() != 0)
+    {
+        return false;
+    }
+
+    // a writer to the pinned leaf waits until the handle is released
+    BPTree::Handle handle = tree.Get("100");
+    const std::string_view value = handle.Value();
+    std::atomic<bool> written { false };
+    std::thread writer([&] {
+        tree.Insert("100", "changed", 7);
+        written = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const bool stable = !written && value == "100";
+    handle = BPTree::Handle();
+    writer.join();
+    return stable && tree.Get("100").Value() == "changed";
+}
+
+bool TestConcurrency(Wal* wal, bool mmap_reads)
+{
+    constexpr int kKeyCount = 2000;
+    constexpr int kWriterCount = 4;
+    constexpr int kReaderCount = 4;
+    BPTreeOptions options;
+    options.m_frame_budget = 32;
+    options.m_wal = wal;
+    options.m_wal_file_id = 1;
+    options.m_mmap_reads = mmap_reads;
+    {
+        BPTree tree("test-concurrent.db", 8, options);
+        for (int i = 0; i < kKeyCount; i += 2)
+        {
+            const std::string key = fmt::format("{:05}", i);
+            tree.Insert(key, key.data(), key.size());
+        }
+
+        // writers fill in the odd keys and erase every even key from the upper half, splitting and
+        // merging pages, while readers check that the lower half never changes under them
+        std::atomic<bool> failed { false };
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kWriterCount; ++t)
+        {
+            threads.emplace_back([&, t] {
+                for (int i = 2 * t + 1; i < kKeyCount; i += 2 * kWriterCount)
+                {
+                    const std::string key = fmt::format("{:05}", i);
+                    const std::string erased = fmt::format("{:05}", kKeyCount / 2 + i - 1);
+                    if (!tree.Insert(key, key.data(), key.size()) || (i < kKeyCount / 2 && !tree.Erase(erased)))
+                    {
+                        failed = true;
+                    }
+                }
+            });
+        }
+        for (int t = 0; t < kReaderCount; ++t)
+        {
+            threads.emplace_back([&, t] {
+                for (int round = 0; round < 5; ++round)
+                {
+                    for (int i = 2 * t; i < kKeyCount / 2; i += 2)
+                    {
+                        const std::string key = fmt::format("{:05}", i);
+                        auto data = tree.Search(key);
+                        if (!data.has_value() || std::string_view(data->m_data, data->m_data_size) != key)
+                        {
+                            failed = true;
+                        }
+                    }
+                    std::string previous;
+                    tree.Scan("", "", [&](std::string_view key, std::string_view) {
+                        if (key <= previous)
+                        {
+                            failed = true;
+                        }
+                        previous = key;
+                        return true;
+                    });
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        if (failed)
+        {
+            return false;
+        }
+    }
+
+    BPTree tree("test-concurrent.db", 8, options);
+    int count = 0;
+    for (auto cursor = tree.Begin(); cursor.Valid(); cursor.Next(), ++count)
+    {
+        const int i = std::stoi(std::string(cursor.Key()));
+        if (i >= kKeyCount / 2 && i % 2 == 0)
+        {
+            return false;
+        }
+    }
+    return count == kKeyCount - kKeyCount / 4;
+}
+
+bool TestOverflow()
+{
+    // every fourth value spills into overflow pages, some spanning several; every tenth key is
+    // long enough that a few of them fill an internal node before node_size is reached
+    constexpr int kKeyCount = 400;
+    const auto key_of = [](int i) { return fmt::format("k{:04}", i) + std::string(i % 10 == 5 ? 900 : 0, 'p'); };
+    const auto value_of = [](int i, int round) {
+        const size_t size = i % 4 == 0 ? 300 + static_cast<size_t>(i) * 97 % 20000 : 100;
+        std::string value(size, static_cast<char>('a' + (i + round) % 26));
+        value.replace(0, 8, fmt::format("{:04}{:04}", i, round));
+        return value;
+    };
+    const auto verify = [&](BPTree& tree, int round) {
+        std::vector<std::string> keys;
+        for (int i = 0; i < kKeyCount; ++i)
+        {
+            const std::string value = value_of(i, round);
+            const auto data = tree.Search(key_of(i));
+            if (!data || std::string_view(data->m_data, data->m_data_size) != value)
+            {
+                return false;
+            }
+            keys.push_back(key_of(i));
+        }
+        {
+            BPTree::Handle handle = tree.MultiGet(keys);
+            for (int i = 0; i < kKeyCount; ++i)
+            {
+                if (!handle.Has(static_cast<size_t>(i)) || handle.Value(static_cast<size_t>(i)) != value_of(i, round))
+                {
+                    return false;
+                }
+            }
+        }
+        int count = 0;
+        for (auto cursor = tree.Begin(); cursor.Valid(); cursor.Next(), ++count)
+        {
+            if (cursor.Key() != key_of(count) || cursor.Value() != value_of(count, round))
+            {
+                return false;
+            }
+        }
+        size_t scanned = 0;
+        tree.Scan("", "", [&](std::string_view key, std::string_view value) {
+            const int i = static_cast<int>(scanned++);
+            return key == key_of(i) && value == value_of(i, round);
+        });
+        return count == kKeyCount && scanned == static_cast<size_t>(kKeyCount);
+    };
+
+    uintmax_t file_size = 0;
+    {
+        BPTree tree("test-overflow.db", 64);
+        if (tree.Insert(std::string(2000, 'x'), "x", 1))
+        {
+            return false;
+        }
+        for (int i = 0; i < kKeyCount; ++i)
+        {
+            const std::string value = value_of(i, 0);
+            if (!tree.Insert(key_of(i), value.data(), value.size()))
+            {
+                return false;
+            }
+        }
+        if (!verify(tree, 0))
+        {
+            return false;
+        }
+        file_size = std::filesystem::file_size("test-overflow.db");
+    }
+
+    {
+        // pages allocated for overflow values after reopening must not reuse existing ones
+        BPTree tree("test-overflow.db", 64);
+        const std::string value(5000, 'n');
+        if (!tree.Insert("k9999", value.data(), value.size()) || !tree.Erase("k9999") || !verify(tree, 0))
+        {
+            return false;
+        }
+    }
+    file_size = std::filesystem::file_size("test-overflow.db");
+
+    {
+        // overwriting and erasing hands overflow pages back, so the same values fit in the same file
+        BPTree tree("test-overflow.db", 64);
+        if (!verify(tree, 0))
+        {
+            return false;
+        }
+        for (int i = 0; i < kKeyCount; i += 2)
+        {
+            tree.Insert(key_of(i), "tiny", 4);
+        }
+        for (int i = 1; i < kKeyCount; i += 2)
+        {
+            if (!tree.Erase(key_of(i)))
+            {
+                return false;
+            }
+        }
+        for (int i = 0; i < kKeyCount; ++i)
+        {
+            const std::string value = value_of(i, 1);
+            tree.Insert(key_of(i), value.data(), value.size());
+        }
+        if (!verify(tree, 1) || std::filesystem::file_size("test-overflow.db") > file_size)
+        {
+            return false;
+        }
+    }
+
+    BPTree tree("test-overflow.db", 64);
+    if (!verify(tree, 1))
+    {
+        return false;
+    }
+    std::vector<BPTree::Record> records;
+    for (int i = 0; i < kKeyCount; ++i)
+    {
+        records.emplace_back(key_of(i), value_of(i, 2));
+    }
+    if (!tree.BulkLoad(records) || !verify(tree, 2))
+    {
+        return false;
+    }
+    records.emplace_back(std::string(2000, 'x'), "x");
+    return !tree.BulkLoad(records);
+}
+
+bool TestOverflowRecovery()
+{
+    // overflow pages that only reached the log are redone along with the leaves pointing at them
+    const std::string blob(10000, 'b');
+    BPTreeOptions options;
+    const bool crashed = RunAndCrash([&] {
+        Wal wal("test-overflow.log");
+        options.m_wal = &wal;
+        BPTree tree("test-overflow.db", 8, options);
+        for (int i = 0; i < 50; ++i)
+        {
+            const std::string value = fmt::format("{:04}", i) + blob;
+            tree.Insert(fmt::format("{:04}", i), value.data(), value.size());
+        }
+        tree.Erase("0007");
+        _exit(0);
+    });
+    if (!crashed)
+    {
+        return false;
+    }
+
+    Wal wal("test-overflow.log");
+    options.m_wal = &wal;
+    BPTree tree("test-overflow.db", 8, options);
+    for (int i = 0; i < 50; ++i)
+    {
+        const auto data = tree.Search(fmt::format("{:04}", i));
+        if (data.has_value() != (i != 7) || (data && std::string_view(data->m_data, data->m_data_size) != fmt::format("{:04}", i) + blob))
+        {
+            return false;
+        }
+    }
+    return tree.Checkpoint() && wal.Truncate();
+}
+
+bool TestPageSize(Wal* wal)
+{
+    // 900-byte values stay in 16 KB and 64 KB leaves but would overflow 4 KB pages
+    const std::string filler(900, 'v');
+    for (const uint32_t page_size : { 16384U, 65536U })
+    {
+        std::filesystem::remove("test-pages.db");
+        BPTreeOptions options;
+        options.m_wal = wal;
+        options.m_page_size = page_size;
+        options.m_key_width = 5;
+        options.m_value_width = filler.size() + 5;
+        {
+            BPTree tree("test-pages.db", 0, options);
+            if (tree.PageSize() != page_size || tree.NodeSize() != BPTree::FanOut(page_size, 5, filler.size() + 5))
+            {
+                return false;
+            }
+            for (int i = 0; i < 3000; ++i)
+            {
+                const std::string value = fmt::format("{:05}", i) + filler;
+                if (!tree.Insert(fmt::format("{:05}", i), value.data(), value.size()))
+                {
+                    return false;
+                }
+            }
+            if (!tree.Checkpoint() || (wal && !wal->Truncate()))
+            {
+                return false;
+            }
+        }
+        if (std::filesystem::file_size("test-pages.db") % page_size != 0)
+        {
+            return false;
+        }
+
+        // reopened with default options the file keeps its own page and node size
+        BPTreeOptions defaults;
+        defaults.m_wal = wal;
+        BPTree tree("test-pages.db", 0, defaults);
+        if (tree.PageSize() != page_size || tree.NodeSize() != BPTree::FanOut(page_size, 5, filler.size() + 5))
+        {
+            return false;
+        }
+        for (int i = 0; i < 3000; i += 7)
+        {
+            const auto data = tree.Search(fmt::format("{:05}", i));
+            if (!data || std::string_view(data->m_data, data->m_data_size) != fmt::format("{:05}", i) + filler)
+            {
+                return false;
+            }
+        }
+    }
+
+    BPTreeOptions invalid;
+    invalid.m_page_size = 5000;
+    try
+    {
+        BPTree tree("test-pages.db", 0, invalid);
+        return false;
+    }
+    catch (const std::invalid_argument&)
+    {
+        return true;
+    }
+}
+
+bool TestMappedReads()
+{
+    // values of every third key spill into overflow pages, which are read through the mapping too
+    const auto value_of = [](int i) { return fmt::format("{:05}", i) + std::string(i % 3 == 0 ? 600 : 10, 'm'); };
+    const auto verify = [&](BPTree& tree, int count, int step) {
+        for (int i = 0; i < count; i += step)
+        {
+            const auto data = tree.Search(fmt::format("{:05}", i));
+            if (!data || std::string_view(data->m_data, data->m_data_size) != value_of(i))
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    {
+        BPTree tree("test-mmap.db", 16);
+        for (int i = 0; i < 2000; ++i)
+        {
+            const std::string value = value_of(i);
+            tree.Insert(fmt::format("{:05}", i), value.data(), value.size());
+        }
+    }
+
+    // a small frame budget keeps faulting pages in from the mapping while the file grows under it
+    BPTreeOptions options;
+    options.m_frame_budget = 8;
+    options.m_mmap_reads = true;
+    BPTree tree("test-mmap.db", 16, options);
+    if (!verify(tree, 2000, 1))
+    {
+        return false;
+    }
+    for (int i = 2000; i < 6000; ++i)
+    {
+        const std::string value = value_of(i);
+        tree.Insert(fmt::format("{:05}", i), value.data(), value.size());
+        if (i % 500 == 0 && !verify(tree, i, 7))
+        {
+            return false;
+        }
+    }
+    for (int i = 0; i < 6000; i += 2)
+    {
+        tree.Erase(fmt::format("{:05}", i));
+    }
+    for (int i = 1; i < 6000; i += 2)
+    {
+        const auto data = tree.Search(fmt::format("{:05}", i));
+        if (!data || std::string_view(data->m_data, data->m_data_size) != value_of(i) || tree.Search(fmt::format("{:05}", i - 1)))
+        {
+            return false;
+        }
+    }
+
+    // a bulk load truncates the file behind the mapping before writing it again
+    std::vector<BPTree::Record> records;
+    for (int i = 0; i < 3000; ++i)
+    {
+        records.emplace_back(fmt::format("{:05}", i), value_of(i));
+    }
+    return tree.BulkLoad(std::move(records)) && verify(tree, 3000, 1);
+}
+
+bool TestKeyPrefixes()
+{
+    // three tenants whose keys share a long prefix, and leaves and separators that straddle tenants
+    constexpr int kKeyCount = 4500;
+    const std::string filler(150, 'p');
+    const auto key_of = [&](int i) { return fmt::format("tenant-{:03}/{}/{:05}", i % 3, filler, i / 3); };
+    const auto verify = [&](BPTree& tree, bool erased) {
+        for (int i = 0; i < kKeyCount; ++i)
+        {
+            const auto data = tree.Search(key_of(i));
+            if (data.has_value() != (!erased || i % 4 == 0) || (data && std::string_view(data->m_data, data->m_data_size) != std::to_string(i)))
+            {
+                return false;
+            }
+        }
+        std::string previous;
+        size_t scanned = 0;
+        tree.Scan("", "", [&](std::string_view key, std::string_view) {
+            const bool ordered = previous < key;
+            previous = key;
+            ++scanned;
+            return ordered;
+        });
+        return scanned == (erased ? (kKeyCount + 3) / 4 : kKeyCount);
+    };
+    // stored in full, these keys took over 300 pages
+    const auto compact = [] { return std::filesystem::file_size("test-prefix.db") / 4096 < 120; };
+
+    {
+        BPTree tree("test-prefix.db", 0);
+        for (int n = 0; n < kKeyCount; ++n)
+        {
+            const int i = static_cast<int>((static_cast<long>(n) * 7919) % kKeyCount);
+            const std::string value = std::to_string(i);
+            if (!tree.Insert(key_of(i), value.data(), value.size()))
+            {
+                return false;
+            }
+        }
+        // keys that share nothing with the rest break the prefix of the first and last leaf
+        if (!tree.Insert("a", "a", 1) || !tree.Insert("z", "z", 1) || !tree.Erase("a") || !tree.Erase("z"))
+        {
+            return false;
+        }
+        if (!verify(tree, false) || !tree.Checkpoint() || !compact())
+        {
+            return false;
+        }
+        for (int i = 0; i < kKeyCount; ++i)
+        {
+            if (i % 4 != 0 && !tree.Erase(key_of(i)))
+            {
+                return false;
+            }
+        }
+        if (!verify(tree, true))
+        {
+            return false;
+        }
+    }
+
+    BPTree tree("test-prefix.db", 0);
+    if (!verify(tree, true))
+    {
+        return false;
+    }
+    std::vector<BPTree::Record> records;
+    for (int i = 0; i < kKeyCount; ++i)
+    {
+        records.emplace_back(key_of(i), std::to_string(i));
+    }
+    return tree.BulkLoad(std::move(records), 1.0) && verify(tree, false) && compact();
+}
+
+bool TestSplitKeys()
+{
+    BPTree tree("test-split.db", 8);
+    if (!tree.SplitKeys(4).empty())
+    {
+        return false;
+    }
+    constexpr int kKeyCount = 20000;
+    for (int n = 0; n < kKeyCount; ++n)
+    {
+        const int i = static_cast<int>((static_cast<long>(n) * 7919) % kKeyCount);
+        if (!tree.Insert(fmt::format("{:06}", i), "v", 1))
+        {
+            return false;
+        }
+    }
+
+    // the ranges between consecutive split keys cover every key exactly once
+    for (size_t parts : { 1, 8, 64 })
+    {
+        std::vector<std::string> bounds = tree.SplitKeys(parts);
+        if (parts > 1 && bounds.size() + 1 < parts)
+        {
+            return false;
+        }
+        bounds.insert(bounds.begin(), "");
+        bounds.push_back("");
+        int next = 0;
+        for (size_t i = 0; i + 1 < bounds.size(); ++i)
+        {
+            if (i > 0 && i + 2 < bounds.size() && bounds[i] >= bounds[i + 1])
+            {
+                return false;
+            }
+            tree.Scan(bounds[i], bounds[i + 1], [&](std::string_view key, std::string_view) {
+                return key == fmt::format("{:06}", next++);
+            });
+        }
+        if (next != kKeyCount)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 int main()
 {
     constexpr uint32_t kMetaPageType = 1;
     constexpr uint32_t kFileMagic = 0x42505431;
     constexpr uintmax_t kPageSize = 4096;
 
+    std::filesystem::remove("test-wal.db");
+    std::filesystem::remove("test-wal.log");
+    std::filesystem::remove("test-concurrent.log");
+    if (!TestWalRecovery())
+    {
+        return 1;
+    }
+    std::filesystem::remove("test-wal-fail.log");
+    if (!TestWalWriteFailure())
+    {
+        return 1;
+    }
+
+    std::filesystem::remove("test-handle.db");
+    if (!TestHandles())
+    {
+        return 1;
+    }
+
+    std::filesystem::remove("test-concurrent.db");
+    if (!TestConcurrency(nullptr, false))
+    {
+        return 1;
+    }
+    std::filesystem::remove("test-concurrent.db");
+    if (!TestConcurrency(nullptr, true))
+    {
+        return 1;
+    }
+    std::filesystem::remove("test-concurrent.db");
+    {
+        Wal wal("test-concurrent.log");
+        if (!TestConcurrency(&wal, false))
+        {
+            return 1;
+        }
+    }
+
     std::filesystem::remove("test-update.db");
     std::filesystem::remove("test.db");
     Test();
@@ -94,7 +1030,98 @@ int main()
         }
     }
 
+    std::filesystem::remove("test-pool.db");
+    if (!TestBufferPool())
+    {
+        return 1;
+    }
+
+    std::filesystem::remove("test-batch.db");
+    if (!TestBatch())
+    {
+        return 1;
+    }
+
+    std::filesystem::remove("test-bulk.db");
+    if (!TestBulkLoad())
+    {
+        return 1;
+    }
+
+    std::filesystem::remove("test-cursor.db");
+    if (!TestCursor())
+    {
+        return 1;
+    }
+
+    std::filesystem::remove("test-erase.db");
+    if (!TestErase())
+    {
+        return 1;
+    }
+
+    std::filesystem::remove("test-overflow.db");
+    std::filesystem::remove("test-overflow.log");
+    if (!TestOverflowRecovery())
+    {
+        return 1;
+    }
+    std::filesystem::remove("test-overflow.db");
+    if (!TestOverflow())
+    {
+        return 1;
+    }
+
+    std::filesystem::remove("test-mmap.db");
+    if (!TestMappedReads())
+    {
+        return 1;
+    }
+
+    std::filesystem::remove("test-prefix.db");
+    if (!TestKeyPrefixes())
+    {
+        return 1;
+    }
+
+    std::filesystem::remove("test-split.db");
+    if (!TestSplitKeys())
+    {
+        return 1;
+    }
+
+    std::filesystem::remove("test-pages.log");
+    if (!TestPageSize(nullptr))
+    {
+        return 1;
+    }
+    {
+        Wal wal("test-pages.log");
+        if (!TestPageSize(&wal))
+        {
+            return 1;
+        }
+    }
+
     std::filesystem::remove("test-update.db");
     std::filesystem::remove("test.db");
+    std::filesystem::remove("test-pool.db");
+    std::filesystem::remove("test-batch.db");
+    std::filesystem::remove("test-bulk.db");
+    std::filesystem::remove("test-cursor.db");
+    std::filesystem::remove("test-erase.db");
+    std::filesystem::remove("test-wal.db");
+    std::filesystem::remove("test-wal.log");
+    std::filesystem::remove("test-wal-fail.log");
+    std::filesystem::remove("test-concurrent.db");
+    std::filesystem::remove("test-concurrent.log");
+    std::filesystem::remove("test-handle.db");
+    std::filesystem::remove("test-overflow.db");
+    std::filesystem::remove("test-overflow.log");
+    std::filesystem::remove("test-pages.db");
+    std::filesystem::remove("test-pages.log");
+    std::filesystem::remove("test-mmap.db");
+    std::filesystem::remove("test-prefix.db");
+    std::filesystem::remove("test-split.db");
     return 0;
 }
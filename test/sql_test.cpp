@@ -0,0 +1,842 @@
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fmt/format.h>
+#include "catalog/table.h"
+#include "sql/aggregate.h"
+#include "sql/batch.h"
+#include "sql/executor.h"
+#include "sql/operators.h"
+#include "sql/parser.h"
+
+namespace
+{
+void RemoveTable(const std::string& name, const std::vector<std::string>& indexed = {})
+{
+    std::filesystem::remove(name + ".tbl");
+    std::filesystem::remove(name + ".idx");
+    std::filesystem::remove(name + ".wal");
+    for (const std::string& column : indexed)
+    {
+        std::filesystem::remove(name + "." + column + ".idx");
+    }
+}
+
+//! @brief the first column of every result row as text, integers printed in decimal
+std::vector<std::string> FirstColumn(const Executor& executor, const std::string& sql)
+{
+    std::string error;
+    const std::optional<ResultSet> result = executor.Execute(sql, error);
+    std::vector<std::string> values;
+    if (!result)
+    {
+        values.push_back("error: " + error);
+        return values;
+    }
+    for (const std::vector<std::optional<Value>>& row : result->m_rows)
+    {
+        if (!row.front())
+        {
+            values.push_back("NULL");
+        }
+        else if (const int64_t* integer = std::get_if<int64_t>(&*row.front()))
+        {
+            values.push_back(std::to_string(*integer));
+        }
+        else
+        {
+            values.push_back(std::get<std::string>(*row.front()));
+        }
+    }
+    return values;
+}
+
+//! @brief rows held in memory, as a scan of slot 0 would produce them
+class RowsScan : public Operator
+{
+public:
+    explicit RowsScan(const std::vector<Row>& rows)
+        : m_rows(rows)
+    {
+    }
+
+    bool Run(const TupleConsumer& consumer) const override
+    {
+        Tuple tuple(1);
+        for (const Row& row : m_rows)
+        {
+            tuple[0] = row.View();
+            if (!consumer(tuple))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void Explain(std::string& out, size_t) const override
+    {
+        out += "rows\n";
+    }
+
+private:
+    const std::vector<Row>& m_rows;
+};
+
+std::unique_ptr<BoundCondition> MakeCompare(size_t ordinal, ColumnType type, CompareOp op, Value value)
+{
+    auto condition = std::make_unique<BoundCondition>();
+    condition->m_column = ColumnRef { 0, ordinal, type };
+    condition->m_op = op;
+    condition->m_value = std::move(value);
+    return condition;
+}
+
+std::unique_ptr<BoundCondition> MakeLogical(Condition::Kind kind, std::unique_ptr<BoundCondition> left, std::unique_ptr<BoundCondition> right = nullptr)
+{
+    auto condition = std::make_unique<BoundCondition>();
+    condition->m_kind = kind;
+    condition->m_left = std::move(left);
+    condition->m_right = std::move(right);
+    return condition;
+}
+
+//! @brief the first line of the plan, the operator that produces the result
+std::string RootOperator(const Executor& executor, const std::string& sql)
+{
+    std::string error;
+    const std::optional<std::string> plan = executor.Explain(sql, error);
+    return plan ? plan->substr(0, plan->find('\n')) : "error: " + error;
+}
+}  // namespace
+
+bool TestParser()
+{
+    std::string error;
+    const std::optional<SelectStatement> statement = Parser::Parse("select id, name FROM users, orders where NOT id < 5 AND name = 'it''s' OR id >= -2;", error);
+    if (!statement || statement->m_columns != std::vector<std::string> { "id", "name" } || statement->m_tables != std::vector<std::string> { "users", "orders" })
+    {
+        return false;
+    }
+    // OR binds loosest, then AND, and NOT applies to a single comparison
+    const Condition& where = *statement->m_where;
+    if (where.m_kind != Condition::Kind::kOr || where.m_left->m_kind != Condition::Kind::kAnd || where.m_right->m_op != CompareOp::kGreaterEqual ||
+        where.m_right->m_value != Value(int64_t { -2 }))
+    {
+        return false;
+    }
+    const Condition& negated = *where.m_left->m_left;
+    if (negated.m_kind != Condition::Kind::kNot || negated.m_left->m_column != "id" || negated.m_left->m_op != CompareOp::kLess ||
+        where.m_left->m_right->m_value != Value(std::string("it's")))
+    {
+        return false;
+    }
+
+    const std::optional<SelectStatement> grouped = Parser::Parse("SELECT region, count(*), Sum(amount), count FROM orders GROUP BY region, count", error);
+    const std::vector<AggregateFunction> aggregates = { AggregateFunction::kNone, AggregateFunction::kCount, AggregateFunction::kSum, AggregateFunction::kNone };
+    if (!grouped || grouped->m_columns != std::vector<std::string> { "region", "*", "amount", "count" } || grouped->m_aggregates != aggregates ||
+        grouped->m_group_by != std::vector<std::string> { "region", "count" })
+    {
+        return false;
+    }
+
+    const std::vector<std::string> invalid = {
+        "SELECT * users",
+        "SELECT SUM(*) FROM users",
+        "SELECT COUNT(id FROM users",
+        "SELECT MAX() FROM users",
+        "SELECT id FROM users GROUP id",
+        "SELECT id FROM users GROUP BY",
+        "SELECT id FROM users GROUP BY id WHERE id = 1",
+        "SELECT * FROM a, b, c",
+        "SELECT FROM users",
+        "SELECT * FROM users WHERE id == 1",
+        "SELECT * FROM users WHERE id = 'open",
+        "SELECT * FROM users WHERE id = name",
+        "SELECT * FROM users WHERE NOT NOT id = 1",
+        "SELECT * FROM select",
+        "SELECT * FROM users WHERE id = 99999999999999999999",
+        "SELECT * FROM users; SELECT * FROM users",
+    };
+    for (const std::string& sql : invalid)
+    {
+        error.clear();
+        if (Parser::Parse(sql, error) || error.empty())
+        {
+            fmt::println("parsed invalid statement: {}", sql);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TestKeyAccessPaths()
+{
+    const Schema schema({ { "id", ColumnType::kString, 0, false, true }, { "name", ColumnType::kString, 0, true, false } });
+    Table table("test-sql-users", schema);
+    for (int i = 0; i < 40; ++i)
+    {
+        Row row(schema);
+        row.SetString("id", fmt::format("u{:02}", i));
+        row.SetString("name", fmt::format("name{}", i % 10));
+        table.Insert(std::move(row));
+    }
+    Executor executor;
+    executor.AddTable("users", table);
+
+    using Names = std::vector<std::string>;
+    return RootOperator(executor, "SELECT * FROM users WHERE id = 'u05'") == "key lookup users 'u05'" &&
+           FirstColumn(executor, "SELECT name FROM users WHERE id = 'u05'") == Names { "name5" } &&
+           FirstColumn(executor, "SELECT id FROM users WHERE id = 'u99'").empty() &&
+           RootOperator(executor, "SELECT * FROM users WHERE id >= 'u10' AND id < 'u13'") == "key range users ['u10', 'u13')" &&
+           FirstColumn(executor, "SELECT id FROM users WHERE id >= 'u10' AND id < 'u13'") == Names { "u10", "u11", "u12" } &&
+           FirstColumn(executor, "SELECT id FROM users WHERE id > 'u10' AND id <= 'u12'") == Names { "u11", "u12" } &&
+           RootOperator(executor, "SELECT * FROM users WHERE NOT id < 'u38'") == "key range users ['u38', +inf)" &&
+           FirstColumn(executor, "SELECT id FROM users WHERE NOT id < 'u38'") == Names { "u38", "u39" } &&
+           // the key comparisons narrow the scan, the rest is filtered per row
+           RootOperator(executor, "SELECT * FROM users WHERE id < 'u20' AND name = 'name3'") == "filter name = 'name3'" &&
+           FirstColumn(executor, "SELECT id FROM users WHERE id < 'u20' AND name = 'name3'") == Names { "u03", "u13" } &&
+           // an OR or a != on the key needs every row
+           RootOperator(executor, "SELECT * FROM users WHERE id = 'u01' OR id = 'u02'") == "filter id = 'u01' OR id = 'u02'" &&
+           FirstColumn(executor, "SELECT id FROM users WHERE id = 'u01' OR id = 'u02'") == Names { "u01", "u02" } &&
+           FirstColumn(executor, "SELECT id FROM users WHERE id != 'u00' AND id < 'u02'") == Names { "u01" } &&
+           RootOperator(executor, "SELECT * FROM users WHERE id > 'u10' AND id < 'u05'") == "empty scan users" &&
+           FirstColumn(executor, "SELECT * FROM users").size() == 40 &&
+           FirstColumn(executor, "SELECT nickname FROM users") == Names { "error: unknown column nickname" } &&
+           FirstColumn(executor, "SELECT * FROM people") == Names { "error: unknown table people" };
+}
+
+bool TestCompositeKeyAccessPaths()
+{
+    // the same rows twice, once keyed by (tenant, n) and once by a single id column
+    const Schema composite({ { "tenant", ColumnType::kString, 0, false, true }, { "n", ColumnType::kInt64, 0, false, true }, { "id", ColumnType::kInt64, 0, false, false } });
+    const Schema single({ { "id", ColumnType::kInt64, 0, false, true }, { "tenant", ColumnType::kString, 0, false, false }, { "n", ColumnType::kInt64, 0, false, false } });
+    Table pairs("test-sql-pairs", composite);
+    Table unpaired("test-sql-unpaired", single);
+    const std::vector<std::string> tenants = { "", "a", "ab", "b" };
+    int64_t id = 0;
+    for (const std::string& tenant : tenants)
+    {
+        for (int64_t n = -5; n <= 5; ++n, ++id)
+        {
+            Row row(composite);
+            row.SetString("tenant", tenant);
+            row.SetInt64("n", n);
+            row.SetInt64("id", id);
+            pairs.Insert(std::move(row));
+            Row other(single);
+            other.SetInt64("id", id);
+            other.SetString("tenant", tenant);
+            other.SetInt64("n", n);
+            unpaired.Insert(std::move(other));
+        }
+    }
+    Executor with_key;
+    with_key.AddTable("pairs", pairs);
+    Executor without_key;
+    without_key.AddTable("pairs", unpaired);
+
+    const auto same_rows = [&](const std::string& condition) {
+        const std::string sql = "SELECT id FROM pairs WHERE " + condition;
+        std::vector<std::string> expected = FirstColumn(without_key, sql);
+        std::vector<std::string> found = FirstColumn(with_key, sql);
+        std::sort(expected.begin(), expected.end());
+        std::sort(found.begin(), found.end());
+        return found == expected;
+    };
+    const std::vector<std::string> ops = { "=", "!=", "<", ">=" };
+    const std::vector<int64_t> bounds = { -9, -5, 0, 3, std::numeric_limits<int64_t>::max() };
+    for (const char* tenant : { "", "a", "ab", "b", "c" })
+    {
+        for (const std::string& op : ops)
+        {
+            for (int64_t bound : bounds)
+            {
+                const std::string condition = fmt::format("tenant = '{}' AND n {} {}", tenant, op, bound);
+                if (!same_rows(condition) || !same_rows(fmt::format("NOT tenant != '{}' AND NOT n {} {}", tenant, op, bound)))
+                {
+                    fmt::println("wrong rows for {}", condition);
+                    return false;
+                }
+            }
+        }
+    }
+    for (const char* condition : { "tenant = 'a'", "tenant < 'b'", "n = 3", "tenant = 'a' AND tenant = 'b'", "tenant = 'a' AND n = 1 AND n = 2", "tenant >= 'a' AND n = 0" })
+    {
+        if (!same_rows(condition))
+        {
+            fmt::println("wrong rows for {}", condition);
+            return false;
+        }
+    }
+
+    // equalities on the leading key columns narrow the scan, the other key comparisons are filtered
+    std::string error;
+    return RootOperator(with_key, "SELECT * FROM pairs WHERE n = 2 AND tenant = 'ab'") == "key lookup pairs ('ab', 2)" &&
+           RootOperator(with_key, "SELECT * FROM pairs WHERE tenant = 'a'") == "key prefix pairs ('a')" &&
+           with_key.Explain("SELECT * FROM pairs WHERE tenant = 'a' AND n > 2", error) == "filter n > 2\n  key prefix pairs ('a')\n" &&
+           RootOperator(with_key, "SELECT * FROM pairs WHERE n = 2") == "filter n = 2" &&
+           RootOperator(with_key, "SELECT * FROM pairs WHERE tenant < 'b' AND n = 2") == "filter tenant < 'b' AND n = 2";
+}
+
+bool TestInt64KeyRanges()
+{
+    const Schema schema({ { "id", ColumnType::kInt64, 0, false, true }, { "score", ColumnType::kInt64, 0, true, false } });
+    Table table("test-sql-ints", schema);
+    for (int64_t id = -20; id < 20; ++id)
+    {
+        Row row(schema);
+        row.SetInt64("id", id * 5);
+        // every third row has a NULL score
+        if (id % 3 != 0)
+        {
+            row.SetInt64("score", id);
+        }
+        table.Insert(std::move(row));
+    }
+    Executor executor;
+    executor.AddTable("scores", table);
+
+    // every key comparison against every bound, on and between keys, beyond both ends, and at the limits of int64
+    const std::vector<std::string> ops = { "=", "!=", "<", ">", "<=", ">=" };
+    const std::vector<std::string> shapes = { "id {} {}", "NOT id {} {}", "id {} {} AND id > -50" };
+    const std::vector<int64_t> bounds = { -200, -100, -7, -5, 0, 3, 95, 200, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max() };
+    for (const std::string& op : ops)
+    {
+        for (int64_t bound : bounds)
+        {
+            for (const std::string& shape : shapes)
+            {
+                const std::string condition = fmt::format(fmt::runtime(shape), op, bound);
+                std::vector<std::string> expected;
+                for (int64_t id = -100; id < 100; id += 5)
+                {
+                    const bool match = op == "=" ? id == bound : op == "!=" ? id != bound : op == "<" ? id < bound : op == ">" ? id > bound : op == "<=" ? id <= bound : id >= bound;
+                    const bool negated = shape[0] == 'N';
+                    const bool extra = shape.back() == '0' ? id > -50 : true;
+                    if (match != negated && extra)
+                    {
+                        expected.push_back(std::to_string(id));
+                    }
+                }
+                if (FirstColumn(executor, "SELECT id FROM scores WHERE " + condition) != expected)
+                {
+                    fmt::println("wrong rows for {}", condition);
+                    return false;
+                }
+            }
+        }
+    }
+
+    // a comparison with NULL is unknown, and so is its negation
+    using Values = std::vector<std::string>;
+    return FirstColumn(executor, "SELECT score FROM scores WHERE id <= -85") == Values { "-20", "-19", "NULL", "-17" } &&
+           FirstColumn(executor, "SELECT id FROM scores WHERE id <= -85 AND NOT score = -19") == Values { "-100", "-85" } &&
+           FirstColumn(executor, "SELECT id FROM scores WHERE id <= -85 AND score = -19 OR id = -100") == Values { "-100", "-95" } &&
+           FirstColumn(executor, "SELECT id FROM scores WHERE id = 'x'") == Values { "error: column id is an integer but is compared with 'x'" };
+}
+
+bool TestIndexAccessPaths()
+{
+    // the same rows twice, once with secondary indexes on score and tag
+    const Schema schema({ { "id", ColumnType::kInt64, 0, false, true }, { "score", ColumnType::kInt64, 0, true, false }, { "tag", ColumnType::kString, 0, true, false } });
+    Table indexed("test-sql-indexed", schema);
+    Table plain("test-sql-plain", schema);
+    const std::vector<std::string> tags = { "", "a", "ab", "b" };
+    for (int64_t id = 0; id < 200; ++id)
+    {
+        Row row(schema);
+        row.SetInt64("id", id);
+        // every ninth row has a NULL score
+        if (id % 9 != 0)
+        {
+            row.SetInt64("score", (id * 7) % 23 - 5);
+        }
+        row.SetString("tag", tags[id % tags.size()]);
+        indexed.Insert(row);
+        plain.Insert(std::move(row));
+    }
+    if (!indexed.CreateIndex("score") || !indexed.CreateIndex("tag"))
+    {
+        return false;
+    }
+    Executor with_index;
+    with_index.AddTable("scores", indexed);
+    Executor without_index;
+    without_index.AddTable("scores", plain);
+
+    // an index scan returns rows by value, so results are compared as sets
+    const auto same_rows = [&](const std::string& sql) {
+        std::vector<std::string> expected = FirstColumn(without_index, sql);
+        std::vector<std::string> found = FirstColumn(with_index, sql);
+        std::sort(expected.begin(), expected.end());
+        std::sort(found.begin(), found.end());
+        return found == expected;
+    };
+    const std::vector<std::string> ops = { "=", "!=", "<", ">", "<=", ">=" };
+    const std::vector<std::string> shapes = { "score {} {}", "NOT score {} {}", "score {} {} AND score > -3", "score {} {} AND tag = 'a'", "id < 100 AND score {} {}" };
+    const std::vector<int64_t> bounds = { -100, -5, 0, 7, 17, 100, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max() };
+    for (const std::string& op : ops)
+    {
+        for (int64_t bound : bounds)
+        {
+            for (const std::string& shape : shapes)
+            {
+                const std::string condition = fmt::format(fmt::runtime(shape), op, bound);
+                if (!same_rows("SELECT id FROM scores WHERE " + condition))
+                {
+                    fmt::println("wrong rows for {}", condition);
+                    return false;
+                }
+            }
+        }
+    }
+    for (const char* condition : { "tag = ''", "tag < 'a'", "tag >= 'a' AND tag < 'b'", "tag > 'a'", "tag <= 'ab'", "tag < ''" })
+    {
+        if (!same_rows(std::string("SELECT id FROM scores WHERE ") + condition))
+        {
+            fmt::println("wrong rows for {}", condition);
+            return false;
+        }
+    }
+
+    // the primary key wins over a secondary index, and an equality over a range
+    std::string error;
+    return RootOperator(with_index, "SELECT * FROM scores WHERE score = 3") == "index lookup scores.score 3" &&
+           RootOperator(with_index, "SELECT * FROM scores WHERE NOT score < 2 AND score < 5") == "index range scores.score [2, 5)" &&
+           RootOperator(with_index, "SELECT * FROM scores WHERE score != 3") == "filter score != 3" &&
+           with_index.Explain("SELECT * FROM scores WHERE id < 50 AND score = 3", error) == "filter score = 3\n  key range scores (-inf, 50)\n" &&
+           with_index.Explain("SELECT * FROM scores WHERE score > 2 AND tag = 'b'", error) == "filter score > 2\n  index lookup scores.tag 'b'\n" &&
+           RootOperator(with_index, "SELECT * FROM scores WHERE score > 5 AND score < 5") == "empty scan scores" &&
+           RootOperator(without_index, "SELECT * FROM scores WHERE score = 3") == "filter score = 3";
+}
+
+bool TestBatchedFilter()
+{
+    const Schema schema({ { "n", ColumnType::kInt64, 0, false, true }, { "score", ColumnType::kInt64, 0, true, false }, { "tag", ColumnType::kBytes, 0, true, false } });
+    const auto shared = std::make_shared<const Schema>(schema);
+    std::vector<Row> rows;
+    for (int64_t n = 0; n < 2500; ++n)
+    {
+        Row row(shared);
+        row.SetInt64(size_t { 0 }, n);
+        // NULL scores and tags on different rows, so AND and OR meet every mix of unknowns
+        if (n % 7 != 0)
+        {
+            row.SetInt64(size_t { 1 }, n % 100 - 50);
+        }
+        if (n % 5 != 0)
+        {
+            row.SetBytes(size_t { 2 }, { static_cast<uint8_t>('a' + n % 3), 0 });
+        }
+        rows.push_back(std::move(row));
+    }
+
+    std::vector<std::unique_ptr<BoundCondition>> conditions;
+    for (CompareOp op : { CompareOp::kEqual, CompareOp::kNotEqual, CompareOp::kLess, CompareOp::kGreater, CompareOp::kLessEqual, CompareOp::kGreaterEqual })
+    {
+        conditions.push_back(MakeCompare(1, ColumnType::kInt64, op, int64_t { 0 }));
+        conditions.push_back(MakeCompare(2, ColumnType::kBytes, op, std::string("b\0", 2)));
+        conditions.push_back(MakeLogical(Condition::Kind::kNot, MakeCompare(1, ColumnType::kInt64, op, int64_t { -20 })));
+        conditions.push_back(MakeLogical(Condition::Kind::kAnd, MakeCompare(1, ColumnType::kInt64, op, int64_t { 10 }),
+                                         MakeLogical(Condition::Kind::kNot, MakeCompare(2, ColumnType::kBytes, CompareOp::kEqual, std::string("a\0", 2)))));
+        conditions.push_back(MakeLogical(Condition::Kind::kOr, MakeCompare(2, ColumnType::kBytes, op, std::string("c")),
+                                         MakeCompare(1, ColumnType::kInt64, CompareOp::kLess, int64_t { -40 })));
+        // the grammar never negates AND or OR, but a false result must still be exact under NOT
+        for (Condition::Kind kind : { Condition::Kind::kAnd, Condition::Kind::kOr })
+        {
+            conditions.push_back(MakeLogical(Condition::Kind::kNot, MakeLogical(kind, MakeCompare(1, ColumnType::kInt64, op, int64_t { 5 }),
+                                                                                MakeCompare(2, ColumnType::kBytes, CompareOp::kGreater, std::string("b")))));
+        }
+    }
+
+    for (std::unique_ptr<BoundCondition>& condition : conditions)
+    {
+        std::vector<int64_t> expected;
+        Tuple tuple(1);
+        for (const Row& row : rows)
+        {
+            tuple[0] = row.View();
+            if (Evaluate(*condition, tuple) == true)
+            {
+                expected.push_back(row.GetInt64(size_t { 0 }).value_or(-1));
+            }
+        }
+
+        // batches of 1024 rows, the last one partial
+        const Filter filter(std::make_unique<RowsScan>(rows), std::move(condition));
+        std::vector<int64_t> selected;
+        filter.Run([&](const Tuple& output) {
+            selected.push_back(output[0].GetInt64(size_t { 0 }).value_or(-1));
+            return true;
+        });
+        // a consumer that stops early stops the filter and its child
+        std::vector<int64_t> first;
+        const bool finished = filter.Run([&](const Tuple& output) {
+            first.push_back(output[0].GetInt64(size_t { 0 }).value_or(-1));
+            return first.size() < 1500;
+        });
+        const size_t stop = std::min<size_t>(expected.size(), 1500);
+        if (selected != expected || finished != (expected.size() < 1500) || first != std::vector<int64_t>(expected.begin(), expected.begin() + stop))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TestCrossJoin()
+{
+    // the users table left behind by TestKeyAccessPaths
+    const Schema users({ { "id", ColumnType::kString, 0, false, true }, { "name", ColumnType::kString, 0, true, false } });
+    const Schema orders({ { "order", ColumnType::kInt64, 0, false, true }, { "item", ColumnType::kBytes, 0, true, false }, { "name", ColumnType::kString, 0, true, false } });
+    Table user_table("test-sql-users", users);
+    Table order_table("test-sql-orders", orders);
+    for (int64_t i = 0; i < 6; ++i)
+    {
+        Row row(orders);
+        row.SetInt64("order", i);
+        row.SetBytes("item", { static_cast<uint8_t>('a' + i % 3) });
+        order_table.Insert(std::move(row));
+    }
+    Executor executor;
+    executor.AddTable("users", user_table);
+    executor.AddTable("orders", order_table);
+
+    std::string error;
+    const std::optional<ResultSet> result = executor.Execute("SELECT id, order FROM users, orders WHERE id <= 'u01' AND order >= 4 AND item = 'b' OR id = 'u39'", error);
+    if (!result || result->m_columns != std::vector<std::string> { "id", "order" })
+    {
+        return false;
+    }
+    std::vector<std::string> pairs;
+    for (const std::vector<std::optional<Value>>& row : result->m_rows)
+    {
+        pairs.push_back(fmt::format("{}:{}", std::get<std::string>(*row[0]), std::get<int64_t>(*row[1])));
+    }
+    // the OR reads both tables, so it filters the cross join of two full scans
+    std::vector<std::string> expected = { "u00:4", "u01:4" };
+    for (int64_t order = 0; order < 6; ++order)
+    {
+        expected.push_back(fmt::format("u39:{}", order));
+    }
+    if (pairs != expected)
+    {
+        return false;
+    }
+
+    // single-table conjuncts go below the join and use the key of their own table
+    const std::optional<std::string> plan = executor.Explain("SELECT * FROM users, orders WHERE id = 'u07' AND order > 2 AND item = 'a'", error);
+    const std::string expected_plan = "cross join\n  key lookup users 'u07'\n  filter item = 'a'\n    key range orders (2, +inf)\n";
+    return plan == expected_plan && FirstColumn(executor, "SELECT * FROM users, orders WHERE id = 'u07' AND order > 2 AND item = 'a'") == std::vector<std::string> { "u07" } &&
+           FirstColumn(executor, "SELECT name FROM users, orders") == std::vector<std::string> { "error: column name is ambiguous between users and orders" };
+}
+
+//! @brief every result row with its values joined by |, sorted, or the error
+std::vector<std::string> SortedRows(const Executor& executor, const std::string& sql)
+{
+    std::string error;
+    const std::optional<ResultSet> result = executor.Execute(sql, error);
+    if (!result)
+    {
+        return { "error: " + error };
+    }
+    std::vector<std::string> rows;
+    for (const std::vector<std::optional<Value>>& row : result->m_rows)
+    {
+        std::string text;
+        for (size_t i = 0; i < row.size(); ++i)
+        {
+            text += i == 0 ? "" : "|";
+            if (!row[i])
+            {
+                text += "NULL";
+            }
+            else if (const int64_t* integer = std::get_if<int64_t>(&*row[i]))
+            {
+                text += std::to_string(*integer);
+            }
+            else
+            {
+                text += std::get<std::string>(*row[i]);
+            }
+        }
+        rows.push_back(std::move(text));
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+bool TestGroupTable()
+{
+    // a budget of a few groups spills many times, and partitions spill again when read back
+    const std::vector<AggregateFunction> functions = { AggregateFunction::kCount, AggregateFunction::kSum, AggregateFunction::kMax };
+    GroupTable table(functions, 4096, "test-sql-spill");
+    GroupTable other(functions, 4096, "test-sql-spill");
+    for (int64_t round = 0; round < 2; ++round)
+    {
+        for (int64_t i = 0; i < 3000; ++i)
+        {
+            GroupTable& into = i % 3 == 0 ? other : table;
+            AggregateState* states = into.Group(fmt::format("group-{}", (i * 7919) % 3000));
+            if (!states)
+            {
+                return false;
+            }
+            ++states[0].m_count;
+            AccumulateInt64(AggregateFunction::kSum, states[1], i);
+            AccumulateInt64(AggregateFunction::kMax, states[2], round);
+        }
+    }
+    if (!table.Spilled() || !other.Spilled() || !table.Merge(other) || other.Size() != 0 || other.Spilled())
+    {
+        return false;
+    }
+
+    std::map<std::string, int64_t> sums;
+    bool valid = true;
+    const bool finished = table.Finish([&](std::string_view key, const AggregateState* states) {
+        valid = valid && states[0].m_count == 2 && states[1].m_count == 2 && states[2].m_integer == 1 && sums.count(std::string(key)) == 0;
+        sums[std::string(key)] = states[1].m_integer;
+        return true;
+    });
+    for (int64_t i = 0; i < 3000 && valid; ++i)
+    {
+        valid = sums[fmt::format("group-{}", (i * 7919) % 3000)] == 2 * i;
+    }
+    if (!finished || !valid || sums.size() != 3000 || table.Spilled() || !std::filesystem::is_empty("test-sql-spill"))
+    {
+        return false;
+    }
+
+    // a few groups whose keys fit the budget many times over still spill once their MAX text does not
+    GroupTable text({ AggregateFunction::kMax }, 16384, "test-sql-spill");
+    for (int64_t i = 0; i < 32 * 4; ++i)
+    {
+        AggregateState* states = text.Group(fmt::format("group-{}", i % 32));
+        if (!states || !text.Account(AccumulateString(AggregateFunction::kMax, states[0], std::string(4096, static_cast<char>('a' + i / 32)))))
+        {
+            return false;
+        }
+    }
+    if (!text.Spilled())
+    {
+        return false;
+    }
+    size_t groups = 0;
+    valid = text.Finish([&](std::string_view, const AggregateState* states) {
+        ++groups;
+        return states[0].m_count == 4 && states[0].m_text == std::string(4096, 'd');
+    });
+    return valid && groups == 32 && std::filesystem::is_empty("test-sql-spill");
+}
+
+bool TestAggregates()
+{
+    const Schema schema({ { "id", ColumnType::kInt64, 0, false, true },
+                          { "region", ColumnType::kString, 0, true, false },
+                          { "amount", ColumnType::kInt64, 0, true, false },
+                          { "tag", ColumnType::kBytes, 0, true, false } });
+    Table table("test-sql-sales", schema);
+    std::vector<Row> rows;
+    for (int64_t id = 0; id < 3000; ++id)
+    {
+        Row row(schema);
+        row.SetInt64("id", id);
+        if (id % 11 != 0)
+        {
+            row.SetString("region", fmt::format("r{:02}", id * 7 % 13));
+        }
+        if (id % 9 != 0)
+        {
+            row.SetInt64("amount", id * 37 % 1001 - 500);
+        }
+        if (id % 4 != 0)
+        {
+            row.SetBytes("tag", { static_cast<uint8_t>('a' + id % 5), 0 });
+        }
+        rows.push_back(row);
+        table.Insert(std::move(row));
+    }
+
+    struct Expected
+    {
+        int64_t m_count { 0 };
+        int64_t m_amounts { 0 };
+        int64_t m_sum { 0 };
+        std::optional<int64_t> m_min;
+        std::optional<int64_t> m_max;
+        std::optional<std::string> m_min_tag;
+        std::optional<std::string> m_max_region;
+    };
+    const auto text = [](const auto& value) { return value ? fmt::format("{}", *value) : std::string("NULL"); };
+    // the groups of the rows with id below limit, grouped by region and, if by_amount, amount
+    const auto expect = [&](int64_t limit, bool by_region, bool by_amount) {
+        std::map<std::string, Expected> groups;
+        for (const Row& row : rows)
+        {
+            if (row.GetInt64("id").value_or(0) >= limit)
+            {
+                continue;
+            }
+            const std::optional<int64_t> amount = row.GetInt64("amount");
+            const std::optional<std::string> region = row.GetString("region");
+            const std::optional<std::vector<uint8_t>> tag = row.GetBytes("tag");
+            std::string key = by_region ? text(region) + "|" : std::string();
+            key += by_amount ? text(amount) + "|" : std::string();
+            Expected& group = groups[key];
+            ++group.m_count;
+            if (amount)
+            {
+                ++group.m_amounts;
+                group.m_sum += *amount;
+                group.m_min = std::min(group.m_min.value_or(*amount), *amount);
+                group.m_max = std::max(group.m_max.value_or(*amount), *amount);
+            }
+            if (tag)
+            {
+                const std::string bytes(tag->begin(), tag->end());
+                group.m_min_tag = std::min(group.m_min_tag.value_or(bytes), bytes);
+            }
+            if (region)
+            {
+                group.m_max_region = std::max(group.m_max_region.value_or(*region), *region);
+            }
+        }
+        if (groups.empty() && !by_region && !by_amount)
+        {
+            groups[""];
+        }
+        std::vector<std::string> expected;
+        for (const auto& [key, group] : groups)
+        {
+            expected.push_back(fmt::format("{}{}|{}|{}|{}|{}|{}|{}", key, group.m_count, group.m_amounts, group.m_amounts > 0 ? std::to_string(group.m_sum) : "NULL",
+                                           text(group.m_min), text(group.m_max), text(group.m_min_tag), text(group.m_max_region)));
+        }
+        std::sort(expected.begin(), expected.end());
+        return expected;
+    };
+    const std::string aggregates = "COUNT(*), COUNT(amount), SUM(amount), MIN(amount), MAX(amount), MIN(tag), MAX(region)";
+
+    // one thread, several threads, and several threads with groups spilling to disk
+    AggregateOptions spilling;
+    spilling.m_threads = 3;
+    spilling.m_memory_budget = 64 * 1024;
+    spilling.m_spill_directory = "test-sql-spill";
+    std::vector<AggregateOptions> all_options(3, AggregateOptions());
+    all_options[0].m_threads = 1;
+    all_options[1].m_threads = 4;
+    all_options[2] = spilling;
+    for (const AggregateOptions& options : all_options)
+    {
+        Executor executor(options);
+        executor.AddTable("sales", table);
+        // != leaves a full scan, filtered in parallel; < narrows to a key range, aggregated serially
+        if (SortedRows(executor, fmt::format("SELECT region, {} FROM sales WHERE id != 3000 GROUP BY region", aggregates)) != expect(3000, true, false) ||
+            SortedRows(executor, fmt::format("SELECT region, {} FROM sales WHERE id < 1234 GROUP BY region", aggregates)) != expect(1234, true, false) ||
+            SortedRows(executor, fmt::format("SELECT region, amount, {} FROM sales GROUP BY amount, region", aggregates)) != expect(3000, true, true) ||
+            SortedRows(executor, fmt::format("SELECT {} FROM sales", aggregates)) != expect(3000, false, false) ||
+            SortedRows(executor, fmt::format("SELECT {} FROM sales WHERE id < 0", aggregates)) != expect(0, false, false))
+        {
+            fmt::println("aggregates differ with {} threads", options.m_threads);
+            return false;
+        }
+    }
+    if (!std::filesystem::is_empty("test-sql-spill"))
+    {
+        return false;
+    }
+
+    Executor executor;
+    executor.AddTable("sales", table);
+    // selected group columns come in any order and GROUP BY without aggregates finds distinct values
+    std::string error;
+    const std::optional<ResultSet> result = executor.Execute("SELECT COUNT(*), region FROM sales WHERE id < 40 GROUP BY region", error);
+    if (!result || result->m_columns != std::vector<std::string> { "COUNT(*)", "region" } ||
+        SortedRows(executor, "SELECT region FROM sales WHERE region >= 'r10' GROUP BY region") != std::vector<std::string> { "r10", "r11", "r12" })
+    {
+        return false;
+    }
+
+    const std::optional<std::string> parallel = executor.Explain("SELECT region, COUNT(*) FROM sales WHERE amount > 0 GROUP BY region", error);
+    const std::optional<std::string> serial = executor.Explain("SELECT SUM(amount), MAX(tag) FROM sales WHERE id < 10", error);
+    return parallel == "parallel hash aggregate by region: COUNT(*)\n  filter amount > 0\n    full scan sales\n" &&
+           serial == "hash aggregate: SUM(amount), MAX(tag)\n  key range sales (-inf, 10)\n" &&
+           FirstColumn(executor, "SELECT region, amount FROM sales GROUP BY region") == std::vector<std::string> { "error: column amount is neither grouped by nor aggregated" } &&
+           FirstColumn(executor, "SELECT SUM(region) FROM sales") == std::vector<std::string> { "error: column region is not an integer and cannot be summed" } &&
+           FirstColumn(executor, "SELECT * FROM sales GROUP BY region") == std::vector<std::string> { "error: SELECT * cannot be grouped or aggregated" };
+}
+
+int main()
+{
+    if (!TestParser())
+    {
+        return 1;
+    }
+
+    RemoveTable("test-sql-users");
+    if (!TestKeyAccessPaths())
+    {
+        return 1;
+    }
+
+    RemoveTable("test-sql-ints");
+    if (!TestInt64KeyRanges())
+    {
+        return 1;
+    }
+
+    RemoveTable("test-sql-pairs");
+    RemoveTable("test-sql-unpaired");
+    if (!TestCompositeKeyAccessPaths())
+    {
+        return 1;
+    }
+
+    RemoveTable("test-sql-indexed", { "score", "tag" });
+    RemoveTable("test-sql-plain");
+    if (!TestIndexAccessPaths())
+    {
+        return 1;
+    }
+
+    if (!TestBatchedFilter())
+    {
+        return 1;
+    }
+
+    RemoveTable("test-sql-orders");
+    if (!TestCrossJoin())
+    {
+        return 1;
+    }
+
+    std::filesystem::remove_all("test-sql-spill");
+    std::filesystem::create_directory("test-sql-spill");
+    if (!TestGroupTable())
+    {
+        return 1;
+    }
+
+    RemoveTable("test-sql-sales");
+    if (!TestAggregates())
+    {
+        return 1;
+    }
+
+    RemoveTable("test-sql-users");
+    RemoveTable("test-sql-ints");
+    RemoveTable("test-sql-pairs");
+    RemoveTable("test-sql-unpaired");
+    RemoveTable("test-sql-orders");
+    RemoveTable("test-sql-indexed", { "score", "tag" });
+    RemoveTable("test-sql-plain");
+    RemoveTable("test-sql-sales");
+    std::filesystem::remove_all("test-sql-spill");
+    return 0;
+}